@@ -0,0 +1,528 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+#include "ColumnStore.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <map>
+
+static const store_column_t storeColumns[STORE_COLUMNS] = {
+  {"temperature",        2, true},
+  {"requested",          2, true},
+  {"hysteresis",         2, true},
+  {"flags",              1, false},
+  {"last_heat_start",    4, false},
+  {"last_heat",          4, false},
+  {"last_status_change", 4, false},
+  {"duty_cycle",         2, false}
+};
+
+/*
+ * Helper functions for the values of a record, in column order
+ */
+static void recordValues(const ingest_record_t & _record, int64_t * _values) {
+  _values[0] = _record.temperature;
+  _values[1] = _record.requestedTemperature;
+  _values[2] = _record.hysteresis;
+  _values[3] = _record.flags;
+  _values[4] = _record.lastHeatStart;
+  _values[5] = _record.lastHeat;
+  _values[6] = _record.lastStatusChange;
+  _values[7] = _record.dutyCycle;
+}
+
+static int64_t readValue(const uint8_t * _data, const store_column_t & _column) {
+  uint64_t value = 0;
+  for(int i=0; i<_column.width; ++i) {
+    value |= (uint64_t)_data[i] << (8 * i);
+  }
+  if(_column.isSigned && (value >> (8 * _column.width - 1)) & 1) {
+    value |= ~0ULL << (8 * _column.width);
+  }
+  return (int64_t)value;
+}
+
+/*
+ * Helper functions for zigzag varints
+ */
+static void putVarint(std::vector<uint8_t> & _output, int64_t _value) {
+  uint64_t zigzag = ((uint64_t)_value << 1) ^ (uint64_t)(_value >> 63);
+  while(zigzag >= 0x80) {
+    _output.push_back((uint8_t)zigzag | 0x80);
+    zigzag >>= 7;
+  }
+  _output.push_back((uint8_t)zigzag);
+}
+
+static bool getVarint(const uint8_t * & _data, const uint8_t * _end, int64_t & _value) {
+  uint64_t zigzag = 0;
+  for(int shift=0; shift<64; shift+=7) {
+    if(_data >= _end) {
+      return false;
+    }
+    uint8_t byte = *_data++;
+    zigzag |= (uint64_t)(byte & 0x7F) << shift;
+    if(!(byte & 0x80)) {
+      _value = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+ * Decode the timestamps of a block.
+ */
+static bool decodeTimes(const uint8_t * _data, const uint8_t * _end, uint32_t _count, std::vector<int64_t> & _times) {
+  _times.resize(_count);
+  int64_t time = 0;
+  for(uint32_t i=0; i<_count; ++i) {
+    int64_t delta;
+    if(!getVarint(_data, _end, delta)) {
+      return false;
+    }
+    time += delta;
+    _times[i] = time;
+  }
+  return true;
+}
+
+/*
+ * Read only memory map of a file (empty files are not mapped).
+ */
+class MappedFile {
+  public:
+    const uint8_t * data;
+    size_t size;
+
+    MappedFile() {
+      data = NULL;
+      size = 0;
+    }
+
+    ~MappedFile() {
+      if(data != NULL) {
+        munmap((void *)data, size);
+      }
+    }
+
+    bool open(const std::string & _path) {
+      int descriptor = ::open(_path.c_str(), O_RDONLY);
+      if(descriptor < 0) {
+        return false;
+      }
+      struct stat status;
+      if(fstat(descriptor, &status) != 0) {
+        ::close(descriptor);
+        return false;
+      }
+      size = status.st_size;
+      if(size > 0) {
+        void * map = mmap(NULL, size, PROT_READ, MAP_SHARED, descriptor, 0);
+        if(map == MAP_FAILED) {
+          ::close(descriptor);
+          return false;
+        }
+        data = (const uint8_t *)map;
+        madvise(map, size, MADV_SEQUENTIAL);
+      }
+      ::close(descriptor);
+      return true;
+    }
+};
+
+/*
+ * Helper function for opening a file for writing at arbitrary positions,
+ * creating it if needed.
+ */
+static FILE * openColumn(const std::string & _path) {
+  FILE * file = fopen(_path.c_str(), "r+b");
+  if(file == NULL && errno == ENOENT) {
+    file = fopen(_path.c_str(), "w+b");
+  }
+  if(file != NULL) {
+    setvbuf(file, NULL, _IOFBF, 1 << 16);
+  }
+  return file;
+}
+
+/*
+ * Write a buffer at a position, dropping anything after it.
+ */
+static bool writeAt(FILE * _file, uint64_t _offset, const void * _data, size_t _length) {
+  fflush(_file);
+  if(ftruncate(fileno(_file), _offset) != 0 || fseeko(_file, _offset, SEEK_SET) != 0) {
+    return false;
+  }
+  return fwrite(_data, 1, _length, _file) == _length;
+}
+
+/*
+ * Constructor
+ */
+ColumnStore::ColumnStore() {
+  timeFile = NULL;
+  indexFile = NULL;
+  for(int i=0; i<STORE_COLUMNS; ++i) {
+    columnFiles[i] = NULL;
+  }
+  records = 0;
+  timeBytes = 0;
+  blocks = 0;
+  failed = false;
+}
+
+/*
+ * Destructor, writes what is left.
+ */
+ColumnStore::~ColumnStore() {
+  close();
+}
+
+/*
+ * Open (or create) the store of a unit for appending. A partial last
+ * block is loaded back, so it can be completed.
+ */
+bool ColumnStore::open(const std::string & _directory) {
+  directory = _directory;
+  failed = false;
+  if(mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+    return false;
+  }
+
+  timeFile = openColumn(directory + "/time.col");
+  indexFile = openColumn(directory + "/index");
+  bool opened = timeFile != NULL && indexFile != NULL;
+  for(int i=0; i<STORE_COLUMNS; ++i) {
+    columnFiles[i] = openColumn(directory + "/" + storeColumns[i].name + ".col");
+    opened = opened && columnFiles[i] != NULL;
+  }
+  if(!opened) {
+    close();
+    return false;
+  }
+
+  // Continue after the last complete block
+  fseeko(indexFile, 0, SEEK_END);
+  blocks = ftello(indexFile) / sizeof(block_index_t);
+  records = 0;
+  timeBytes = 0;
+  if(blocks > 0) {
+    block_index_t last;
+    fseeko(indexFile, (blocks - 1) * sizeof(block_index_t), SEEK_SET);
+    if(fread(&last, sizeof(last), 1, indexFile) != 1) {
+      close();
+      return false;
+    }
+    records = last.firstRecord + last.count;
+    timeBytes = last.timeOffset + last.timeLength;
+    if(last.count < STORE_BLOCK_RECORDS && !loadTail(last)) {
+      close();
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * Load a partial block into memory and make it the block being filled.
+ */
+bool ColumnStore::loadTail(const block_index_t & _block) {
+  MappedFile time;
+  if(!time.open(directory + "/time.col") || time.size < _block.timeOffset + _block.timeLength) {
+    return false;
+  }
+  const uint8_t * data = time.data + _block.timeOffset;
+  if(!decodeTimes(data, data + _block.timeLength, _block.count, times)) {
+    return false;
+  }
+
+  for(int i=0; i<STORE_COLUMNS; ++i) {
+    MappedFile column;
+    int width = storeColumns[i].width;
+    if(!column.open(directory + "/" + storeColumns[i].name + ".col")
+       || column.size < (_block.firstRecord + _block.count) * width) {
+      return false;
+    }
+    values[i].resize(_block.count);
+    for(uint32_t j=0; j<_block.count; ++j) {
+      values[i][j] = readValue(column.data + (_block.firstRecord + j) * width, storeColumns[i]);
+    }
+  }
+
+  records = _block.firstRecord;
+  timeBytes = _block.timeOffset;
+  blocks -= 1;
+  return true;
+}
+
+/*
+ * Add a record. Returns false when a full block couldn't be written.
+ */
+bool ColumnStore::append(const ingest_record_t & _record) {
+  int64_t row[STORE_COLUMNS];
+  recordValues(_record, row);
+  times.push_back(_record.time);
+  for(int i=0; i<STORE_COLUMNS; ++i) {
+    values[i].push_back(row[i]);
+  }
+  if(times.size() == STORE_BLOCK_RECORDS) {
+    return writeBlock();
+  }
+  return true;
+}
+
+/*
+ * Write the block being filled. A full block is final, a partial one is
+ * kept in memory and overwritten by the next write. The index entry goes
+ * last, so it never points past the column data. Returns false when a
+ * write failed (and every time after that).
+ */
+bool ColumnStore::writeBlock() {
+  if(failed) {
+    return false;
+  }
+  if(times.empty()) {
+    return true;
+  }
+
+  block_index_t block;
+  memset(&block, 0, sizeof(block));
+  block.firstRecord = records;
+  block.timeOffset = timeBytes;
+  block.count = times.size();
+  block.timeMinimum = times.front();
+  block.timeMaximum = times.front();
+
+  std::vector<uint8_t> encoded;
+  encoded.reserve(times.size() * 2);
+  int64_t previous = 0;
+  for(size_t i=0; i<times.size(); ++i) {
+    putVarint(encoded, times[i] - previous);
+    previous = times[i];
+    block.timeMinimum = std::min(block.timeMinimum, times[i]);
+    block.timeMaximum = std::max(block.timeMaximum, times[i]);
+  }
+  block.timeLength = encoded.size();
+  bool written = writeAt(timeFile, timeBytes, encoded.data(), encoded.size());
+
+  for(int i=0; i<STORE_COLUMNS; ++i) {
+    int width = storeColumns[i].width;
+    std::vector<uint8_t> column(values[i].size() * width);
+    block.minimum[i] = values[i][0];
+    block.maximum[i] = values[i][0];
+    for(size_t j=0; j<values[i].size(); ++j) {
+      int64_t value = values[i][j];
+      for(int k=0; k<width; ++k) {
+        column[j * width + k] = (uint8_t)(value >> (8 * k));
+      }
+      block.minimum[i] = std::min(block.minimum[i], value);
+      block.maximum[i] = std::max(block.maximum[i], value);
+      block.sum[i] += value;
+    }
+    written = written && writeAt(columnFiles[i], records * width, column.data(), column.size());
+  }
+  written = written && writeAt(indexFile, blocks * sizeof(block_index_t), &block, sizeof(block));
+  if(!written) {
+    failed = true;
+    return false;
+  }
+
+  if(times.size() == STORE_BLOCK_RECORDS) {
+    records += times.size();
+    timeBytes += encoded.size();
+    blocks += 1;
+    times.clear();
+    for(int i=0; i<STORE_COLUMNS; ++i) {
+      values[i].clear();
+    }
+  }
+  return true;
+}
+
+/*
+ * Make everything appended so far durable (also the partial block).
+ * Returns false when a write failed, now or before.
+ */
+bool ColumnStore::flush() {
+  bool written = writeBlock();
+  if(timeFile != NULL) {
+    written = fflush(timeFile) == 0 && written;
+    written = fflush(indexFile) == 0 && written;
+    for(int i=0; i<STORE_COLUMNS; ++i) {
+      written = fflush(columnFiles[i]) == 0 && written;
+    }
+  }
+  failed = failed || !written;
+  return written;
+}
+
+/*
+ * Write what is left and close the files. Returns false when a write
+ * failed, now or before.
+ */
+bool ColumnStore::close() {
+  bool written = !failed;
+  if(timeFile != NULL && indexFile != NULL) {
+    written = flush();
+  }
+  FILE ** files[] = {&timeFile, &indexFile};
+  for(FILE ** file : files) {
+    if(*file != NULL) {
+      written = fclose(*file) == 0 && written;
+      *file = NULL;
+    }
+  }
+  for(int i=0; i<STORE_COLUMNS; ++i) {
+    if(columnFiles[i] != NULL) {
+      written = fclose(columnFiles[i]) == 0 && written;
+      columnFiles[i] = NULL;
+    }
+  }
+  times.clear();
+  for(int i=0; i<STORE_COLUMNS; ++i) {
+    values[i].clear();
+  }
+  return written;
+}
+
+/*
+ * Look up a column by name, returns -1 if unknown.
+ */
+int ColumnStore::findColumn(const std::string & _name) {
+  for(int i=0; i<STORE_COLUMNS; ++i) {
+    if(_name == storeColumns[i].name) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+const store_column_t * ColumnStore::getColumn(int _column) {
+  return _column >= 0 && _column < STORE_COLUMNS ? &storeColumns[_column] : NULL;
+}
+
+/*
+ * Minimum, maximum, sum and count of a column per bucket of time in
+ * [_from, _to). Only blocks that don't fit in a single bucket are decoded.
+ */
+bool ColumnStore::query(const std::string & _directory, int _column, int64_t _from, int64_t _to,
+                        int64_t _bucket, std::vector<store_bucket_t> & _buckets) {
+  const store_column_t * column = getColumn(_column);
+  MappedFile index, time, data;
+  if(column == NULL || _bucket <= 0
+     || !index.open(_directory + "/index") || !time.open(_directory + "/time.col")
+     || !data.open(_directory + "/" + column->name + ".col")) {
+    return false;
+  }
+
+  std::map<int64_t, store_bucket_t> buckets;
+  auto bucketOf = [&](int64_t _time) {
+    int64_t offset = _time - _from;
+    return _from + (offset / _bucket) * _bucket;
+  };
+  auto merge = [&](int64_t _start, int64_t _minimum, int64_t _maximum, int64_t _sum, uint64_t _count) {
+    std::map<int64_t, store_bucket_t>::iterator found = buckets.find(_start);
+    if(found == buckets.end()) {
+      store_bucket_t bucket = {_start, _minimum, _maximum, _sum, _count};
+      buckets[_start] = bucket;
+    } else {
+      found->second.minimum = std::min(found->second.minimum, _minimum);
+      found->second.maximum = std::max(found->second.maximum, _maximum);
+      found->second.sum += _sum;
+      found->second.count += _count;
+    }
+  };
+
+  size_t blocks = index.size / sizeof(block_index_t);
+  std::vector<int64_t> times;
+  for(size_t i=0; i<blocks; ++i) {
+    block_index_t block;
+    memcpy(&block, index.data + i * sizeof(block_index_t), sizeof(block));
+    if(block.timeMaximum < _from || block.timeMinimum >= _to) {
+      continue;
+    }
+
+    // The whole block in a single bucket: the index is enough
+    if(block.timeMinimum >= _from && block.timeMaximum < _to
+       && bucketOf(block.timeMinimum) == bucketOf(block.timeMaximum)) {
+      merge(bucketOf(block.timeMinimum), block.minimum[_column], block.maximum[_column],
+            block.sum[_column], block.count);
+      continue;
+    }
+
+    // Otherwise decode the block
+    if(block.timeOffset + block.timeLength > time.size
+       || (block.firstRecord + block.count) * column->width > data.size) {
+      return false;
+    }
+    const uint8_t * encoded = time.data + block.timeOffset;
+    if(!decodeTimes(encoded, encoded + block.timeLength, block.count, times)) {
+      return false;
+    }
+    const uint8_t * values = data.data + block.firstRecord * column->width;
+    for(uint32_t j=0; j<block.count; ++j) {
+      if(times[j] >= _from && times[j] < _to) {
+        int64_t value = readValue(values + j * column->width, *column);
+        merge(bucketOf(times[j]), value, value, value, 1);
+      }
+    }
+  }
+
+  _buckets.clear();
+  for(std::map<int64_t, store_bucket_t>::iterator i = buckets.begin(); i != buckets.end(); ++i) {
+    _buckets.push_back(i->second);
+  }
+  return true;
+}
+
+/*
+ * Size and time range of a store.
+ */
+bool ColumnStore::info(const std::string & _directory, uint64_t & _records, uint64_t & _blocks,
+                       int64_t & _first, int64_t & _last) {
+  MappedFile index;
+  if(!index.open(_directory + "/index")) {
+    return false;
+  }
+  _blocks = index.size / sizeof(block_index_t);
+  _records = 0;
+  _first = 0;
+  _last = 0;
+  for(size_t i=0; i<_blocks; ++i) {
+    block_index_t block;
+    memcpy(&block, index.data + i * sizeof(block_index_t), sizeof(block));
+    _first = i == 0 ? block.timeMinimum : std::min(_first, block.timeMinimum);
+    _last = i == 0 ? block.timeMaximum : std::max(_last, block.timeMaximum);
+    _records += block.count;
+  }
+  return true;
+}
@@ -0,0 +1,115 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+#ifndef _COLUMNSTORE_H_
+#define _COLUMNSTORE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "Record.h"
+
+/*
+ * Columnar time series of one unit, stored in a directory:
+ *
+ *   time.col     timestamps, delta and zigzag varint encoded per block
+ *   <field>.col  one file per field, fixed width little endian values
+ *   index        one block_index_t per block of records
+ *
+ * Records are appended in blocks of STORE_BLOCK_RECORDS. Every block has
+ * its time range and the minimum, maximum and sum of each field in the
+ * index, so queries only decode the blocks that straddle a bucket or the
+ * edges of the range. Reading is done through read only memory maps.
+ *
+ * The last block may be partial; it is rewritten when more records are
+ * appended. Records must be appended in time order.
+ */
+#define STORE_BLOCK_RECORDS 4096
+#define STORE_COLUMNS       8
+
+typedef struct store_column {
+  const char * name;
+  int width;
+  bool isSigned;
+} store_column_t;
+
+typedef struct block_index {
+  uint64_t firstRecord;
+  uint64_t timeOffset;
+  uint32_t count;
+  uint32_t timeLength;
+  int64_t timeMinimum;
+  int64_t timeMaximum;
+  int64_t minimum[STORE_COLUMNS];
+  int64_t maximum[STORE_COLUMNS];
+  int64_t sum[STORE_COLUMNS];
+} block_index_t;
+
+typedef struct store_bucket {
+  int64_t start;
+  int64_t minimum;
+  int64_t maximum;
+  int64_t sum;
+  uint64_t count;
+} store_bucket_t;
+
+class ColumnStore {
+  public:
+    ColumnStore();
+    ~ColumnStore();
+    bool open(const std::string & _directory);
+    bool append(const ingest_record_t & _record);
+    bool flush();
+    bool close();
+
+    static int findColumn(const std::string & _name);
+    static const store_column_t * getColumn(int _column);
+    static bool query(const std::string & _directory, int _column, int64_t _from, int64_t _to,
+                      int64_t _bucket, std::vector<store_bucket_t> & _buckets);
+    static bool info(const std::string & _directory, uint64_t & _records, uint64_t & _blocks,
+                     int64_t & _first, int64_t & _last);
+
+  private:
+    std::string directory;
+    FILE * timeFile;
+    FILE * columnFiles[STORE_COLUMNS];
+    FILE * indexFile;
+
+    // The block being filled, and where it goes in the files
+    std::vector<int64_t> times;
+    std::vector<int64_t> values[STORE_COLUMNS];
+    uint64_t records;
+    uint64_t timeBytes;
+    uint64_t blocks;
+    bool failed;
+
+    bool writeBlock();
+    bool loadTail(const block_index_t & _block);
+};
+
+#endif
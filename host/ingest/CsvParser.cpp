@@ -0,0 +1,236 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+#include "CsvParser.h"
+#include <string.h>
+#include <time.h>
+
+#define MAX_FIELDS 13
+
+/*
+ * Helper function for parsing a decimal number with at most two decimals
+ * into an integer scaled by 100 (or by 1 for plain integers when _scale
+ * is false). Returns false on anything else.
+ */
+static bool parseField(const char * _begin, const char * _end, bool _scale, int64_t & _value) {
+  bool negative = _begin < _end && *_begin == '-';
+  if(negative) {
+    ++_begin;
+  }
+  if(_begin == _end) {
+    return false;
+  }
+
+  int64_t value = 0;
+  int decimals = -1;
+  for(const char * p = _begin; p < _end; ++p) {
+    if(*p >= '0' && *p <= '9') {
+      if(decimals >= 2 || value > 100000000000000LL) {
+        return false;
+      }
+      value = value * 10 + (*p - '0');
+      if(decimals >= 0) {
+        ++decimals;
+      }
+    } else if(*p == '.' && decimals < 0 && _scale) {
+      decimals = 0;
+    } else {
+      return false;
+    }
+  }
+  if(_scale) {
+    for(int i = decimals < 0 ? 0 : decimals; i < 2; ++i) {
+      value *= 10;
+    }
+  }
+  _value = negative ? -value : value;
+  return true;
+}
+
+/*
+ * Constructor, the handler is called for every valid line.
+ */
+CsvParser::CsvParser(record_handler_t _handler) {
+  handler = _handler;
+  baseTime = 0;
+  baseKnown = false;
+  baseFixed = false;
+  lastUptime = 0;
+  pendingLength = 0;
+  pendingOverflow = false;
+  records = 0;
+  errors = 0;
+  skipped = 0;
+}
+
+/*
+ * Wall clock time at uptime 0, for lines without a time field.
+ */
+void CsvParser::setBaseTime(int64_t _time) {
+  baseTime = _time;
+  baseKnown = true;
+  baseFixed = true;
+}
+
+/*
+ * Parse a chunk of input.
+ */
+void CsvParser::feed(const char * _data, size_t _length) {
+  const char * end = _data + _length;
+  const char * begin = _data;
+
+  while(begin < end) {
+    const char * newline = (const char *)memchr(begin, '\n', end - begin);
+    if(newline == NULL) {
+      // Keep the start of the line for the next chunk
+      size_t length = end - begin;
+      if(pendingLength + length > sizeof(pending)) {
+        pendingOverflow = true;
+      } else {
+        memcpy(pending + pendingLength, begin, length);
+        pendingLength += length;
+      }
+      return;
+    }
+
+    if(pendingLength > 0 || pendingOverflow) {
+      size_t length = newline - begin;
+      if(!pendingOverflow && pendingLength + length <= sizeof(pending)) {
+        memcpy(pending + pendingLength, begin, length);
+        parseLine(pending, pending + pendingLength + length);
+      } else {
+        ++errors;
+      }
+      pendingLength = 0;
+      pendingOverflow = false;
+    } else {
+      parseLine(begin, newline);
+    }
+    begin = newline + 1;
+  }
+}
+
+/*
+ * Parse what is left when the input ends without a newline.
+ */
+void CsvParser::finish() {
+  if(pendingOverflow) {
+    ++errors;
+  } else if(pendingLength > 0) {
+    parseLine(pending, pending + pendingLength);
+  }
+  pendingLength = 0;
+  pendingOverflow = false;
+}
+
+/*
+ * Parse a single line (without the newline).
+ */
+void CsvParser::parseLine(const char * _begin, const char * _end) {
+  if(_end > _begin && _end[-1] == '\r') {
+    --_end;
+  }
+  if(_end == _begin) {
+    return;
+  }
+
+  // Split the fields
+  const char * fields[MAX_FIELDS + 1];
+  int count = 0;
+  fields[count++] = _begin;
+  for(const char * p = _begin; p < _end; ++p) {
+    if(*p == ';') {
+      if(count == MAX_FIELDS) {
+        ++errors;
+        return;
+      }
+      fields[count++] = p + 1;
+    }
+  }
+  fields[count] = _end + 1;
+  if(count != 12 && count != 13) {
+    ++errors;
+    return;
+  }
+
+  // Temperatures are scaled, everything else is an integer
+  static const bool scaled[12] = {false, true, true, true, false, false, false,
+                                  false, false, false, false, false};
+  int offset = count - 12;
+  int64_t values[13];
+  for(int i=0; i<count; ++i) {
+    bool scale = i >= offset && scaled[i - offset];
+    if(!parseField(fields[i], fields[i + 1] - 1, scale, values[i])) {
+      ++errors;
+      return;
+    }
+  }
+
+  const int64_t * v = values + offset;
+  if(offset == 0) {
+    // The uptime starts over after a reboot or the wrap of millis()
+    if(!baseFixed && (!baseKnown || v[0] < lastUptime)) {
+      baseTime = (int64_t)time(NULL) - v[0];
+      baseKnown = true;
+    }
+    lastUptime = v[0];
+  }
+  if(v[1] == RECORD_NO_TEMPERATURE) {
+    ++skipped;
+    return;
+  }
+
+  ingest_record_t record;
+  record.time = offset == 1 ? values[0] : baseTime + v[0];
+  record.temperature = (int16_t)v[1];
+  record.requestedTemperature = (int16_t)v[2];
+  record.hysteresis = (int16_t)v[3];
+  record.flags = (v[4] ? RECORD_HEATING : 0) | (v[5] ? RECORD_ENABLED : 0)
+                 | (v[6] ? RECORD_GRACE : 0) | (v[10] ? RECORD_ALARM : 0);
+  record.lastHeatStart = (uint32_t)v[7];
+  record.lastHeat = (uint32_t)v[8];
+  record.lastStatusChange = (uint32_t)v[9];
+  record.dutyCycle = (uint16_t)v[11];
+
+  ++records;
+  handler(record);
+}
+
+/*
+ * Statistics
+ */
+uint64_t CsvParser::getRecords() {
+  return records;
+}
+
+uint64_t CsvParser::getErrors() {
+  return errors;
+}
+
+uint64_t CsvParser::getSkipped() {
+  return skipped;
+}
@@ -0,0 +1,83 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+#ifndef _CSVPARSER_H_
+#define _CSVPARSER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include "Record.h"
+
+typedef std::function<void(const ingest_record_t & _record)> record_handler_t;
+
+/*
+ * Incremental parser for the CSV lines of the thermostat:
+ *
+ *   uptime;temperature;requested;hysteresis;heating;enabled;grace;
+ *   last heat start;last heat;last status change;alarm;duty cycle
+ *
+ * (uptime and timestamps in seconds, temperatures with two decimals).
+ * Lines may also start with an extra field holding the wall clock time
+ * (seconds since the epoch), as added by a logger. Otherwise the time is
+ * the base time plus the uptime. Without a base time, the first line is
+ * assumed to be sent right now, as is the first line after the uptime
+ * went backwards (a reboot of the unit or the wrap of millis()).
+ *
+ * Chunks can be split anywhere, malformed lines are counted and skipped,
+ * as are the lines without a valid temperature (RECORD_NO_TEMPERATURE).
+ * The parser doesn't allocate: it works on the chunk itself and only
+ * copies a line that is split over two chunks.
+ */
+class CsvParser {
+  public:
+    CsvParser(record_handler_t _handler);
+    void setBaseTime(int64_t _time);
+    void feed(const char * _data, size_t _length);
+    void finish();
+
+    uint64_t getRecords();
+    uint64_t getErrors();
+    uint64_t getSkipped();
+
+  private:
+    record_handler_t handler;
+    int64_t baseTime;
+    bool baseKnown;
+    bool baseFixed;
+    int64_t lastUptime;
+    char pending[256];
+    size_t pendingLength;
+    bool pendingOverflow;
+    uint64_t records;
+    uint64_t errors;
+    uint64_t skipped;
+
+    void parseLine(const char * _begin, const char * _end);
+};
+
+#endif
@@ -0,0 +1,60 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+#ifndef _RECORD_H_
+#define _RECORD_H_
+
+#include <stdint.h>
+
+/*
+ * One report of a unit, as stored by the ingest tool. Temperatures are in
+ * centi-degrees, time is wall clock (seconds since the epoch), the other
+ * timestamps are the uptime of the unit in seconds.
+ */
+typedef struct ingest_record {
+  int64_t time;
+  int16_t temperature;
+  int16_t requestedTemperature;
+  int16_t hysteresis;
+  uint8_t flags;
+  uint32_t lastHeatStart;
+  uint32_t lastHeat;
+  uint32_t lastStatusChange;
+  uint16_t dutyCycle;
+} ingest_record_t;
+
+// Flags (same bits as the binary telemetry)
+#define RECORD_HEATING 0x01
+#define RECORD_ENABLED 0x02
+#define RECORD_GRACE   0x04
+#define RECORD_ALARM   0x08
+
+// Temperature of a report sent before the unit had a valid reading
+// (-327.68 in CSV), such reports aren't stored
+#define RECORD_NO_TEMPERATURE (-32767 - 1)
+
+#endif
@@ -0,0 +1,390 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+
+/*
+ * Description:
+ *   Collects the reports of a thermostat (CSV lines or binary telemetry
+ *   frames, from a serial device, a file or stdin) into a columnar store
+ *   per unit, and answers aggregate queries on it:
+ *
+ *     thermostat_ingest ingest <store> <unit> [options] [<file or device>]
+ *       --binary         input is binary telemetry instead of CSV
+ *       --base <time>    wall clock time at uptime 0 (default: derived
+ *                        from the first report and the current time,
+ *                        again whenever the uptime goes backwards)
+ *       --baud <rate>    baud rate for serial devices (default 9600)
+ *     thermostat_ingest query <store> <unit> --from <time> --to <time>
+ *       --field <name>   column to aggregate (default temperature)
+ *       --bucket <s>     bucket size in seconds (default 3600)
+ *     thermostat_ingest info <store> <unit>
+ *
+ *   Times are seconds since the epoch or YYYY-MM-DD[THH:MM[:SS]] (UTC).
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "ColumnStore.h"
+#include "CsvParser.h"
+#include "TelemetryDecoder.h"
+
+// Partial blocks are written at least this often when reading a device
+#define DEVICE_FLUSH_INTERVAL 60
+
+static volatile sig_atomic_t stopRequested = 0;
+
+/*
+ * Stop reading on SIGINT/SIGTERM, so the store is closed cleanly.
+ */
+static void requestStop(int _signal) {
+  stopRequested = 1;
+}
+
+/*
+ * Parse a time: seconds since the epoch or an ISO date (UTC).
+ */
+static bool parseTime(const char * _text, int64_t & _time) {
+  char * end;
+  long long seconds = strtoll(_text, &end, 10);
+  if(*end == '\0' && end != _text) {
+    _time = seconds;
+    return true;
+  }
+
+  struct tm date;
+  memset(&date, 0, sizeof(date));
+  int parsed = sscanf(_text, "%d-%d-%dT%d:%d:%d", &date.tm_year, &date.tm_mon, &date.tm_mday,
+                      &date.tm_hour, &date.tm_min, &date.tm_sec);
+  if(parsed < 3) {
+    return false;
+  }
+  date.tm_year -= 1900;
+  date.tm_mon -= 1;
+  _time = timegm(&date);
+  return true;
+}
+
+/*
+ * Configure a serial device: raw mode at the given baud rate.
+ */
+static bool configureDevice(int _descriptor, long _baud) {
+  struct termios settings;
+  if(tcgetattr(_descriptor, &settings) != 0) {
+    return false;
+  }
+  speed_t speed;
+  switch(_baud) {
+    case 9600:   speed = B9600;   break;
+    case 19200:  speed = B19200;  break;
+    case 38400:  speed = B38400;  break;
+    case 57600:  speed = B57600;  break;
+    case 115200: speed = B115200; break;
+    default:
+      return false;
+  }
+  cfmakeraw(&settings);
+  cfsetispeed(&settings, speed);
+  cfsetospeed(&settings, speed);
+  settings.c_cc[VMIN] = 1;
+  settings.c_cc[VTIME] = 0;
+  return tcsetattr(_descriptor, TCSANOW, &settings) == 0;
+}
+
+static int usage() {
+  fprintf(stderr,
+          "usage: thermostat_ingest ingest <store> <unit> [--binary] [--base <time>] [--baud <rate>] [<input>]\n"
+          "       thermostat_ingest query <store> <unit> --from <time> --to <time> [--field <name>] [--bucket <s>]\n"
+          "       thermostat_ingest info <store> <unit>\n");
+  return 2;
+}
+
+/*
+ * Read reports into the store.
+ */
+static int ingest(const std::string & _directory, int _argc, char ** _argv) {
+  bool binary = false;
+  bool automaticBase = true;
+  int64_t base = 0;
+  long baud = 9600;
+  const char * input = NULL;
+  for(int i=0; i<_argc; ++i) {
+    if(strcmp(_argv[i], "--binary") == 0) {
+      binary = true;
+    } else if(strcmp(_argv[i], "--base") == 0 && i + 1 < _argc) {
+      if(!parseTime(_argv[++i], base)) {
+        return usage();
+      }
+      automaticBase = false;
+    } else if(strcmp(_argv[i], "--baud") == 0 && i + 1 < _argc) {
+      baud = atol(_argv[++i]);
+    } else if(input == NULL && _argv[i][0] != '-') {
+      input = _argv[i];
+    } else {
+      return usage();
+    }
+  }
+
+  int descriptor = input == NULL ? 0 : open(input, O_RDONLY | O_NOCTTY);
+  if(descriptor < 0) {
+    fprintf(stderr, "cannot open %s: %s\n", input, strerror(errno));
+    return 1;
+  }
+  bool device = isatty(descriptor);
+  if(device && input != NULL && !configureDevice(descriptor, baud)) {
+    fprintf(stderr, "cannot configure %s at %ld baud\n", input, baud);
+    return 1;
+  }
+
+  ColumnStore store;
+  if(!store.open(_directory)) {
+    fprintf(stderr, "cannot open store %s: %s\n", _directory.c_str(), strerror(errno));
+    return 1;
+  }
+
+  // A failed write stops the reading, the store keeps what was written
+  bool writeFailed = false;
+
+  // Binary reports: without a base time, assume the first one was sent
+  // just now, as is the first one after a reboot or the wrap of millis()
+  bool baseKnown = !automaticBase;
+  int64_t lastUptime = 0;
+  auto stamp = [&](ingest_record_t _record) {
+    if(automaticBase && (!baseKnown || _record.time < lastUptime)) {
+      base = (int64_t)time(NULL) - _record.time;
+      baseKnown = true;
+    }
+    lastUptime = _record.time;
+    _record.time += base;
+    writeFailed = !store.append(_record) || writeFailed;
+  };
+
+  CsvParser parser([&](const ingest_record_t & _record) {
+    writeFailed = !store.append(_record) || writeFailed;
+  });
+  if(!automaticBase) {
+    parser.setBaseTime(base);
+  }
+
+  uint64_t decoded = 0;
+  uint64_t skipped = 0;
+  accounting_report_t accounting[2];
+  bool accountingSeen[2] = {false, false};
+  anticipator_report_t anticipator;
+  bool anticipatorSeen = false;
+  TelemetryDecoder decoder([&](uint8_t _type, const uint8_t * _payload, size_t _length) {
+    if(_type == TELEMETRY_FRAME_ANTICIPATOR) {
+      if(TelemetryDecoder::decodeAnticipator(_payload, _length, anticipator)) {
+        anticipatorSeen = true;
+      }
+      return;
+    }
+    accounting_report_t report;
+    if(_type == TELEMETRY_FRAME_ACCOUNTING && TelemetryDecoder::decodeAccounting(_payload, _length, report)
+       && report.set <= ACCOUNTING_TRIP) {
+      accounting[report.set] = report;
+      accountingSeen[report.set] = true;
+      return;
+    }
+    status_record_t status;
+    if(_type != TELEMETRY_FRAME_STATUS || !TelemetryDecoder::decodeStatus(_payload, _length, status)) {
+      return;
+    }
+    if(status.temperature == RECORD_NO_TEMPERATURE) {
+      ++skipped;
+      return;
+    }
+    ingest_record_t record;
+    record.time = status.time / 1000;
+    record.temperature = status.temperature;
+    record.requestedTemperature = status.requestedTemperature;
+    record.hysteresis = status.hysteresis;
+    record.flags = status.flags;
+    record.lastHeatStart = status.lastHeatStart / 1000;
+    record.lastHeat = status.lastHeat / 1000;
+    record.lastStatusChange = status.lastStatusChange / 1000;
+    record.dutyCycle = status.dutyCycle;
+    ++decoded;
+    stamp(record);
+  });
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = requestStop;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+
+  std::vector<char> buffer(1 << 20);
+  time_t lastFlush = time(NULL);
+  while(!stopRequested && !writeFailed) {
+    ssize_t length = read(descriptor, buffer.data(), buffer.size());
+    if(length < 0 && errno == EINTR) {
+      continue;
+    }
+    if(length <= 0) {
+      break;
+    }
+    if(binary) {
+      decoder.feed((const uint8_t *)buffer.data(), length);
+    } else {
+      parser.feed(buffer.data(), length);
+    }
+    if(device && time(NULL) - lastFlush >= DEVICE_FLUSH_INTERVAL) {
+      writeFailed = !store.flush();
+      lastFlush = time(NULL);
+    }
+  }
+  if(!binary && !writeFailed) {
+    parser.finish();
+  }
+  if(!store.close() || writeFailed) {
+    fprintf(stderr, "cannot write store %s\n", _directory.c_str());
+    writeFailed = true;
+  }
+  if(descriptor != 0) {
+    close(descriptor);
+  }
+
+  if(binary) {
+    fprintf(stderr, "%llu records, %llu without temperature, %llu crc errors, %llu framing errors\n",
+            (unsigned long long)decoded, (unsigned long long)skipped,
+            (unsigned long long)decoder.getCrcErrors(), (unsigned long long)decoder.getFramingErrors());
+    // The counters are totals, only the last report matters
+    const char * names[2] = {"lifetime", "trip"};
+    for(int i=0; i<2; ++i) {
+      if(accountingSeen[i]) {
+        fprintf(stderr, "%s: %.1f h burner, %.1f kWh, %u cycles, %u grace blocks, "
+                "%u/%u/%u alarms (min/max/time) at %u W\n", names[i],
+                accounting[i].heatSeconds / 3600.0, accounting[i].energy / 1000.0,
+                accounting[i].cycles, accounting[i].graceBlocks, accounting[i].alarms[0],
+                accounting[i].alarms[1], accounting[i].alarms[2], accounting[i].burnerPower);
+      }
+    }
+    if(anticipatorSeen) {
+      double scale = 100.0 * (1 << ANTICIPATOR_FRACTION_BITS);
+      fprintf(stderr, "anticipator: slope %.2f degrees/min, rise %.2f degrees after %u cycles, "
+              "last rise %.2f, anticipation %.2f\n", anticipator.slope / scale,
+              anticipator.rise / scale, anticipator.cycles, anticipator.lastRise / 100.0,
+              anticipator.anticipation / 100.0);
+    }
+  } else {
+    fprintf(stderr, "%llu records, %llu without temperature, %llu malformed lines\n",
+            (unsigned long long)parser.getRecords(), (unsigned long long)parser.getSkipped(),
+            (unsigned long long)parser.getErrors());
+  }
+  return writeFailed ? 1 : 0;
+}
+
+/*
+ * Aggregate a column per bucket.
+ */
+static int query(const std::string & _directory, int _argc, char ** _argv) {
+  int64_t from = 0, to = 0, bucket = 3600;
+  bool hasFrom = false, hasTo = false;
+  std::string field = "temperature";
+  for(int i=0; i + 1 < _argc; i += 2) {
+    if(strcmp(_argv[i], "--from") == 0) {
+      hasFrom = parseTime(_argv[i + 1], from);
+    } else if(strcmp(_argv[i], "--to") == 0) {
+      hasTo = parseTime(_argv[i + 1], to);
+    } else if(strcmp(_argv[i], "--field") == 0) {
+      field = _argv[i + 1];
+    } else if(strcmp(_argv[i], "--bucket") == 0) {
+      bucket = atoll(_argv[i + 1]);
+    } else {
+      return usage();
+    }
+  }
+  int column = ColumnStore::findColumn(field);
+  if(!hasFrom || !hasTo || _argc % 2 != 0 || column < 0 || bucket <= 0) {
+    return usage();
+  }
+
+  std::vector<store_bucket_t> buckets;
+  if(!ColumnStore::query(_directory, column, from, to, bucket, buckets)) {
+    fprintf(stderr, "cannot read store %s\n", _directory.c_str());
+    return 1;
+  }
+
+  printf("start;min;max;avg;count\n");
+  for(size_t i=0; i<buckets.size(); ++i) {
+    char start[32];
+    time_t seconds = buckets[i].start;
+    struct tm date;
+    gmtime_r(&seconds, &date);
+    strftime(start, sizeof(start), "%Y-%m-%dT%H:%M:%S", &date);
+    printf("%s;%lld;%lld;%.2f;%llu\n", start, (long long)buckets[i].minimum,
+           (long long)buckets[i].maximum, (double)buckets[i].sum / buckets[i].count,
+           (unsigned long long)buckets[i].count);
+  }
+  return 0;
+}
+
+/*
+ * Print the size of the store.
+ */
+static int info(const std::string & _directory) {
+  uint64_t records, blocks;
+  int64_t first, last;
+  if(!ColumnStore::info(_directory, records, blocks, first, last)) {
+    fprintf(stderr, "cannot read store %s\n", _directory.c_str());
+    return 1;
+  }
+  printf("records: %llu\nblocks: %llu\nfirst: %lld\nlast: %lld\n", (unsigned long long)records,
+         (unsigned long long)blocks, (long long)first, (long long)last);
+  return 0;
+}
+
+int main(int _argc, char ** _argv) {
+  if(_argc < 4) {
+    return usage();
+  }
+  std::string store = _argv[2];
+  if(mkdir(store.c_str(), 0755) != 0 && errno != EEXIST) {
+    fprintf(stderr, "cannot create %s: %s\n", store.c_str(), strerror(errno));
+    return 1;
+  }
+  std::string directory = store + "/" + _argv[3];
+
+  if(strcmp(_argv[1], "ingest") == 0) {
+    return ingest(directory, _argc - 4, _argv + 4);
+  } else if(strcmp(_argv[1], "query") == 0) {
+    return query(directory, _argc - 4, _argv + 4);
+  } else if(strcmp(_argv[1], "info") == 0 && _argc == 4) {
+    return info(directory);
+  }
+  return usage();
+}
@@ -0,0 +1,64 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+
+#include <math.h>
+#include "SensorTable.h"
+#include "MagicNumbers.h"
+#include "TemperatureTable.h"
+
+/*
+ * Constructor, reads the temperature of every ADC value from the table.
+ */
+SensorTable::SensorTable() {
+  for(int value=0; value<SENSOR_VALUES; ++value) {
+    temperatures[value] = lookupTemperature(value << ADC_RAW_SHIFT).raw();
+  }
+  increasing = temperatures[SENSOR_VALUES - 1] >= temperatures[0];
+}
+
+/*
+ * ADC value that reads closest to a temperature (degrees). The table is
+ * monotonic, so a binary search does.
+ */
+int SensorTable::rawFor(double _temperature) {
+  long target = lround(_temperature * 100);
+  int low = 0;
+  int high = SENSOR_VALUES - 1;
+  while(low < high) {
+    int middle = (low + high) / 2;
+    if((temperatures[middle] < target) == increasing) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  if(low > 0 && labs(temperatures[low - 1] - target) <= labs(temperatures[low] - target)) {
+    return low - 1;
+  }
+  return low;
+}
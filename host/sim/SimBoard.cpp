@@ -0,0 +1,459 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include "SimBoard.h"
+
+// HD44780 (20x4): the line after the end of a row in display memory
+static const uint8_t nextLcdRow[SIM_LCD_ROWS] = {2, 3, 1, 0};
+
+static thread_local SimBoard * currentBoard = NULL;
+
+/*
+ * Constructor, the board starts at time 0 with all pins low and an erased
+ * EEPROM.
+ */
+SimBoard::SimBoard() {
+  now = 0;
+  timerCount = 0;
+  memset(analog, 0, sizeof(analog));
+  memset(digital, 0, sizeof(digital));
+  memset(modes, 0, sizeof(modes));
+  memset(transitions, 0, sizeof(transitions));
+  memset(eeprom, 0xFF, sizeof(eeprom));
+  memset(eepromWrites, 0, sizeof(eepromWrites));
+  eepromTotalWrites = 0;
+  memset(lcdText, ' ', sizeof(lcdText));
+  memset(glyphs, 0, sizeof(glyphs));
+  lcdRow = 0;
+  lcdColumn = 0;
+  lcdTransactions = 0;
+  serialOpen = false;
+  baud = 9600;
+  pending = 0;
+  drainTime = 0;
+  resetRequested = false;
+}
+
+/*
+ * Make this the board of the calling thread.
+ */
+void SimBoard::select() {
+  currentBoard = this;
+}
+
+/*
+ * The board of the calling thread.
+ */
+SimBoard * SimBoard::current() {
+  return currentBoard;
+}
+
+/*
+ * Current time of the virtual clock (us.)
+ */
+uint64_t SimBoard::getMicros() {
+  return now;
+}
+
+/*
+ * Move the clock forward, firing the timers that are due on the way (in
+ * time order).
+ */
+void SimBoard::advance(uint64_t _micros) {
+  uint64_t target = now + _micros;
+  while(true) {
+    sim_timer_entry_t * due = NULL;
+    for(uint8_t i=0; i<timerCount; ++i) {
+      if(timers[i].next <= target && (due == NULL || timers[i].next < due->next)) {
+        due = &timers[i];
+      }
+    }
+    if(due == NULL) {
+      break;
+    }
+    if(due->next > now) {
+      now = due->next;
+    }
+    due->next += due->period;
+    due->timer(due->context);
+  }
+  if(target > now) {
+    now = target;
+  }
+}
+
+/*
+ * Call _timer every _period us. of virtual time, the first time one period
+ * from now. Returns false when all timers are taken.
+ */
+bool SimBoard::attachTimer(unsigned long _period, sim_timer_t _timer, void * _context) {
+  if(timerCount >= SIM_TIMERS || _period == 0) {
+    return false;
+  }
+  timers[timerCount].period = _period;
+  timers[timerCount].next = now + _period;
+  timers[timerCount].timer = _timer;
+  timers[timerCount].context = _context;
+  ++timerCount;
+  return true;
+}
+
+/*
+ * Stop all timers.
+ */
+void SimBoard::detachTimers() {
+  timerCount = 0;
+}
+
+/*
+ * Set the level of an analog input (0-1023).
+ */
+void SimBoard::setAnalog(uint8_t _pin, int _value) {
+  int index = pinIndex(_pin);
+  if(index >= 0) {
+    analog[index] = _value < 0 ? 0 : (_value > 1023 ? 1023 : _value);
+  }
+}
+
+/*
+ * Level of an analog input.
+ */
+int SimBoard::getAnalog(uint8_t _pin) {
+  int index = pinIndex(_pin);
+  return index >= 0 ? analog[index] : 0;
+}
+
+/*
+ * Drive a digital pin (by the sketch or from the outside).
+ */
+void SimBoard::setDigital(uint8_t _pin, uint8_t _value) {
+  int index = pinIndex(_pin);
+  if(index >= 0) {
+    _value = _value ? 1 : 0;
+    if(digital[index] != _value) {
+      digital[index] = _value;
+      ++transitions[index];
+    }
+  }
+}
+
+/*
+ * Level of a digital pin.
+ */
+uint8_t SimBoard::getDigital(uint8_t _pin) {
+  int index = pinIndex(_pin);
+  return index >= 0 ? digital[index] : 0;
+}
+
+/*
+ * Mode of a pin, as set with pinMode().
+ */
+uint8_t SimBoard::getPinMode(uint8_t _pin) {
+  int index = pinIndex(_pin);
+  return index >= 0 ? modes[index] : 0;
+}
+
+/*
+ * Set the mode of a pin.
+ */
+void SimBoard::setPinMode(uint8_t _pin, uint8_t _mode) {
+  int index = pinIndex(_pin);
+  if(index >= 0) {
+    modes[index] = _mode;
+  }
+}
+
+/*
+ * Number of level changes of a digital pin.
+ */
+unsigned long SimBoard::getTransitions(uint8_t _pin) {
+  int index = pinIndex(_pin);
+  return index >= 0 ? transitions[index] : 0;
+}
+
+/*
+ * Read an EEPROM cell, out of range reads return an erased cell.
+ */
+uint8_t SimBoard::readEeprom(int _address) {
+  if(_address < 0 || _address >= SIM_EEPROM_SIZE) {
+    return 0xFF;
+  }
+  return eeprom[_address];
+}
+
+/*
+ * Write an EEPROM cell (an erase/write cycle, even when the value doesn't
+ * change).
+ */
+void SimBoard::writeEeprom(int _address, uint8_t _value) {
+  if(_address < 0 || _address >= SIM_EEPROM_SIZE) {
+    return;
+  }
+  eeprom[_address] = _value;
+  ++eepromWrites[_address];
+  ++eepromTotalWrites;
+}
+
+/*
+ * Total number of EEPROM writes.
+ */
+unsigned long SimBoard::getEepromWrites() {
+  return eepromTotalWrites;
+}
+
+/*
+ * Number of writes of a single EEPROM cell.
+ */
+unsigned long SimBoard::getEepromWrites(int _address) {
+  if(_address < 0 || _address >= SIM_EEPROM_SIZE) {
+    return 0;
+  }
+  return eepromWrites[_address];
+}
+
+/*
+ * Load the EEPROM image from a file, a missing file leaves the EEPROM
+ * erased.
+ */
+bool SimBoard::loadEeprom(const char * _path) {
+  FILE * file = fopen(_path, "rb");
+  if(file == NULL) {
+    return false;
+  }
+  size_t length = fread(eeprom, 1, SIM_EEPROM_SIZE, file);
+  fclose(file);
+  return length == SIM_EEPROM_SIZE;
+}
+
+/*
+ * Store the EEPROM image in a file.
+ */
+bool SimBoard::saveEeprom(const char * _path) {
+  FILE * file = fopen(_path, "wb");
+  if(file == NULL) {
+    return false;
+  }
+  size_t length = fwrite(eeprom, 1, SIM_EEPROM_SIZE, file);
+  return fclose(file) == 0 && length == SIM_EEPROM_SIZE;
+}
+
+/*
+ * Clear the display and move the cursor home.
+ */
+void SimBoard::lcdClear() {
+  memset(lcdText, ' ', sizeof(lcdText));
+  lcdRow = 0;
+  lcdColumn = 0;
+  ++lcdTransactions;
+}
+
+/*
+ * Move the cursor.
+ */
+void SimBoard::lcdSetCursor(uint8_t _column, uint8_t _row) {
+  lcdRow = _row < SIM_LCD_ROWS ? _row : SIM_LCD_ROWS - 1;
+  lcdColumn = _column < SIM_LCD_COLUMNS ? _column : SIM_LCD_COLUMNS - 1;
+  ++lcdTransactions;
+}
+
+/*
+ * Put a character at the cursor and move the cursor on. Like on the
+ * HD44780, row 0 continues on row 2 and row 1 on row 3, and the codes 8-15
+ * show the custom characters 0-7 as well.
+ */
+void SimBoard::lcdWrite(uint8_t _value) {
+  lcdText[lcdRow][lcdColumn] = (char)(_value < 2 * SIM_GLYPHS ? _value & (SIM_GLYPHS - 1) : _value);
+  if(++lcdColumn >= SIM_LCD_COLUMNS) {
+    lcdColumn = 0;
+    lcdRow = nextLcdRow[lcdRow];
+  }
+  ++lcdTransactions;
+}
+
+/*
+ * Define one of the custom characters (8 rows of 5 bits.)
+ */
+void SimBoard::lcdCreateChar(uint8_t _location, const uint8_t * _rows) {
+  memcpy(glyphs[_location & (SIM_GLYPHS - 1)], _rows, 8);
+  lcdTransactions += 9;
+}
+
+/*
+ * Text of a row of the display, custom characters are left as their code
+ * (0-7).
+ */
+std::string SimBoard::getLcdLine(uint8_t _row) {
+  if(_row >= SIM_LCD_ROWS) {
+    return std::string();
+  }
+  return std::string(lcdText[_row], SIM_LCD_COLUMNS);
+}
+
+/*
+ * Pixel rows of a custom character.
+ */
+const uint8_t * SimBoard::getGlyph(uint8_t _location) {
+  return glyphs[_location & (SIM_GLYPHS - 1)];
+}
+
+/*
+ * Number of LCD bus transactions (commands and characters.)
+ */
+unsigned long SimBoard::getLcdTransactions() {
+  return lcdTransactions;
+}
+
+/*
+ * Open the serial port.
+ */
+void SimBoard::serialBegin(unsigned long _baud) {
+  serialOpen = true;
+  baud = _baud > 0 ? _baud : 9600;
+  pending = 0;
+  drainTime = now;
+}
+
+/*
+ * Close the serial port, whatever is still in the buffer is sent first.
+ */
+void SimBoard::serialEnd() {
+  serialOpen = false;
+  pending = 0;
+}
+
+/*
+ * Check if the port is open.
+ */
+bool SimBoard::isSerialOpen() {
+  return serialOpen;
+}
+
+/*
+ * Queue characters for the sketch to receive.
+ */
+void SimBoard::sendSerial(const char * _text) {
+  serialInput.append(_text);
+}
+
+/*
+ * Number of received characters (the receive buffer holds 64.)
+ */
+int SimBoard::serialAvailable() {
+  if(!serialOpen) {
+    return 0;
+  }
+  return serialInput.size() < SIM_SERIAL_BUFFER ? (int)serialInput.size() : SIM_SERIAL_BUFFER;
+}
+
+/*
+ * Take a received character, -1 when there's none.
+ */
+int SimBoard::serialRead() {
+  if(!serialOpen || serialInput.empty()) {
+    return -1;
+  }
+  uint8_t value = serialInput[0];
+  serialInput.erase(0, 1);
+  return value;
+}
+
+/*
+ * Free space in the transmit buffer.
+ */
+int SimBoard::serialAvailableForWrite() {
+  drainSerial();
+  return SIM_SERIAL_BUFFER - 1 - pending;
+}
+
+/*
+ * Send a character. Like the real port this waits (on the virtual clock)
+ * while the transmit buffer is full.
+ */
+void SimBoard::serialWrite(uint8_t _value) {
+  if(!serialOpen) {
+    return;
+  }
+  drainSerial();
+  while(pending >= SIM_SERIAL_BUFFER - 1) {
+    advance(10000000UL / baud + 1);
+    drainSerial();
+  }
+  ++pending;
+  serialOutput.push_back((char)_value);
+}
+
+/*
+ * Take everything the sketch sent so far.
+ */
+std::string SimBoard::takeSerialOutput() {
+  std::string output;
+  output.swap(serialOutput);
+  return output;
+}
+
+/*
+ * Flag a reset (the sketch jumps to the reset vector on the real board.)
+ */
+void SimBoard::requestReset() {
+  resetRequested = true;
+}
+
+/*
+ * Check if the sketch asked for a reset.
+ */
+bool SimBoard::isResetRequested() {
+  return resetRequested;
+}
+
+/*
+ * Index in the pin arrays, -1 for unknown pins.
+ */
+int SimBoard::pinIndex(uint8_t _pin) {
+  return _pin < SIM_PINS ? _pin : -1;
+}
+
+/*
+ * Account for the characters sent since the last call, one character per
+ * 10 bits at the baud rate.
+ */
+void SimBoard::drainSerial() {
+  if(pending == 0) {
+    drainTime = now;
+    return;
+  }
+  uint64_t sent = (now - drainTime) * baud / 10000000ULL;
+  if(sent >= pending) {
+    pending = 0;
+    drainTime = now;
+  } else {
+    pending -= sent;
+    drainTime += sent * 10000000ULL / baud;
+  }
+}
@@ -0,0 +1,159 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+
+#ifndef _SIMBOARD_H_
+#define _SIMBOARD_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+#define SIM_PINS          20
+#define SIM_EEPROM_SIZE   1024
+#define SIM_LCD_ROWS      4
+#define SIM_LCD_COLUMNS   20
+#define SIM_GLYPHS        8
+#define SIM_TIMERS        4
+#define SIM_SERIAL_BUFFER 64
+#define SIM_ANALOG_PIN    14
+
+/*
+ * Simulated ATmega328 board for running the sketch on the host. The stand-in
+ * Arduino core (host/sim/arduino) forwards every call to the board that is
+ * current for the calling thread, so each thread can run its own board.
+ *
+ * The board keeps:
+ *  - a virtual clock: delay() and friends advance it instead of waiting,
+ *    timers attached to the board fire as the clock passes them (like the
+ *    timer interrupts on the real board);
+ *  - the analog inputs (10 bit) and digital pins, with a count of the
+ *    level changes of every pin;
+ *  - the EEPROM image, with the number of writes per cell;
+ *  - the text and glyphs of a 20x4 HD44780 LCD;
+ *  - the serial port: received characters and the transmit buffer, which
+ *    drains at the baud rate of the virtual clock.
+ *
+ * Types have their host sizes (int is 32 bit, unsigned long 64 bit) and
+ * millis() doesn't wrap after 49 days.
+ */
+typedef void (* sim_timer_t)(void * _context);
+
+class SimBoard {
+  public:
+    SimBoard();
+    void select();
+    static SimBoard * current();
+
+    // Clock
+    uint64_t getMicros();
+    void advance(uint64_t _micros);
+    bool attachTimer(unsigned long _period, sim_timer_t _timer, void * _context);
+    void detachTimers();
+
+    // Pins
+    void setAnalog(uint8_t _pin, int _value);
+    int getAnalog(uint8_t _pin);
+    void setDigital(uint8_t _pin, uint8_t _value);
+    uint8_t getDigital(uint8_t _pin);
+    uint8_t getPinMode(uint8_t _pin);
+    void setPinMode(uint8_t _pin, uint8_t _mode);
+    unsigned long getTransitions(uint8_t _pin);
+
+    // EEPROM
+    uint8_t readEeprom(int _address);
+    void writeEeprom(int _address, uint8_t _value);
+    unsigned long getEepromWrites();
+    unsigned long getEepromWrites(int _address);
+    bool loadEeprom(const char * _path);
+    bool saveEeprom(const char * _path);
+
+    // LCD
+    void lcdClear();
+    void lcdSetCursor(uint8_t _column, uint8_t _row);
+    void lcdWrite(uint8_t _value);
+    void lcdCreateChar(uint8_t _location, const uint8_t * _rows);
+    std::string getLcdLine(uint8_t _row);
+    const uint8_t * getGlyph(uint8_t _location);
+    unsigned long getLcdTransactions();
+
+    // Serial port
+    void serialBegin(unsigned long _baud);
+    void serialEnd();
+    bool isSerialOpen();
+    void sendSerial(const char * _text);
+    int serialAvailable();
+    int serialRead();
+    int serialAvailableForWrite();
+    void serialWrite(uint8_t _value);
+    std::string takeSerialOutput();
+
+    // Reset
+    void requestReset();
+    bool isResetRequested();
+
+  private:
+    typedef struct sim_timer_entry {
+      unsigned long period;
+      uint64_t next;
+      sim_timer_t timer;
+      void * context;
+    } sim_timer_entry_t;
+
+    uint64_t now;
+    sim_timer_entry_t timers[SIM_TIMERS];
+    uint8_t timerCount;
+
+    int analog[SIM_PINS];
+    uint8_t digital[SIM_PINS];
+    uint8_t modes[SIM_PINS];
+    unsigned long transitions[SIM_PINS];
+
+    uint8_t eeprom[SIM_EEPROM_SIZE];
+    unsigned long eepromWrites[SIM_EEPROM_SIZE];
+    unsigned long eepromTotalWrites;
+
+    char lcdText[SIM_LCD_ROWS][SIM_LCD_COLUMNS];
+    uint8_t glyphs[SIM_GLYPHS][8];
+    uint8_t lcdRow;
+    uint8_t lcdColumn;
+    unsigned long lcdTransactions;
+
+    bool serialOpen;
+    unsigned long baud;
+    std::string serialInput;
+    std::string serialOutput;
+    unsigned int pending;
+    uint64_t drainTime;
+
+    bool resetRequested;
+
+    int pinIndex(uint8_t _pin);
+    void drainSerial();
+};
+
+#endif
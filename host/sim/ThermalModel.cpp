@@ -0,0 +1,134 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+
+#include <math.h>
+#include "ThermalModel.h"
+
+// Heat capacity of water (J/(l.K))
+#define WATER_CAPACITY 4186.0
+
+#define SECONDS_PER_DAY 86400.0
+
+/*
+ * A 150 l tank on a small boiler, with a shower in the morning, the dishes
+ * at noon and a bath in the evening.
+ */
+void defaultThermalParameters(thermal_parameters_t & _parameters) {
+  _parameters.volume = 150;
+  _parameters.heaterPower = 12000;
+  _parameters.exchangerCapacity = 20000;
+  _parameters.exchangeRate = 600;
+  _parameters.lossRate = 2;
+  _parameters.ambientTemperature = 18;
+  _parameters.coldTemperature = 10;
+  _parameters.sensorLag = 60;
+  _parameters.startTemperature = 40;
+  _parameters.drawOffs.clear();
+  _parameters.drawOffs.push_back(draw_off_t {7 * 3600.0, 600, 8});
+  _parameters.drawOffs.push_back(draw_off_t {12 * 3600.0, 180, 5});
+  _parameters.drawOffs.push_back(draw_off_t {19.5 * 3600.0, 900, 10});
+}
+
+/*
+ * Constructor, everything starts at the start temperature.
+ */
+ThermalModel::ThermalModel(const thermal_parameters_t & _parameters) {
+  parameters = _parameters;
+  tankCapacity = parameters.volume * WATER_CAPACITY;
+  time = 0;
+  tank = parameters.startTemperature;
+  coil = parameters.startTemperature;
+  sensor = parameters.startTemperature;
+  drawn = 0;
+}
+
+/*
+ * Move the model on by _seconds, with the boiler on or off.
+ */
+void ThermalModel::step(double _seconds, bool _heating) {
+  double flow = drawOffFlow(time) / 60.0;
+  double exchanged = parameters.exchangeRate * (coil - tank);
+  double lost = parameters.lossRate * (tank - parameters.ambientTemperature);
+  double replaced = flow * WATER_CAPACITY * (tank - parameters.coldTemperature);
+
+  coil += ((_heating ? parameters.heaterPower : 0) - exchanged) * _seconds / parameters.exchangerCapacity;
+  tank += (exchanged - lost - replaced) * _seconds / tankCapacity;
+  sensor += (tank - sensor) * (1 - exp(-_seconds / parameters.sensorLag));
+  drawn += flow * _seconds;
+  time += _seconds;
+}
+
+/*
+ * Time since the start (s.)
+ */
+double ThermalModel::getTime() {
+  return time;
+}
+
+/*
+ * Temperature of the water in the tank.
+ */
+double ThermalModel::getTankTemperature() {
+  return tank;
+}
+
+/*
+ * Temperature of the coil.
+ */
+double ThermalModel::getCoilTemperature() {
+  return coil;
+}
+
+/*
+ * Temperature at the thermistor.
+ */
+double ThermalModel::getSensorTemperature() {
+  return sensor;
+}
+
+/*
+ * Hot water taken so far (l.)
+ */
+double ThermalModel::getDrawnVolume() {
+  return drawn;
+}
+
+/*
+ * Flow of the draw-offs at a time (l/min.)
+ */
+double ThermalModel::drawOffFlow(double _time) {
+  double timeOfDay = fmod(_time, SECONDS_PER_DAY);
+  double flow = 0;
+  for(size_t i=0; i<parameters.drawOffs.size(); ++i) {
+    const draw_off_t & drawOff = parameters.drawOffs[i];
+    if(timeOfDay >= drawOff.start && timeOfDay < drawOff.start + drawOff.duration) {
+      flow += drawOff.flow;
+    }
+  }
+  return flow;
+}
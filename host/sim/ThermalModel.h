@@ -0,0 +1,94 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+
+#ifndef _THERMALMODEL_H_
+#define _THERMALMODEL_H_
+
+#include <vector>
+
+/*
+ * Hot water taken from the tank every day, replaced by cold water.
+ */
+typedef struct draw_off {
+  double start;       // s. since midnight
+  double duration;    // s.
+  double flow;        // l/min
+} draw_off_t;
+
+/*
+ * Properties of the tank and the boiler.
+ */
+typedef struct thermal_parameters {
+  double volume;              // l, the tank
+  double heaterPower;         // W, delivered by the boiler
+  double exchangerCapacity;   // J/K, the coil and the water in it
+  double exchangeRate;        // W/K, from the coil to the tank
+  double lossRate;            // W/K, from the tank to its surroundings
+  double ambientTemperature;  // degrees
+  double coldTemperature;     // degrees, of the water replacing a draw-off
+  double sensorLag;           // s., time constant of the thermistor
+  double startTemperature;    // degrees, of everything at time 0
+  std::vector<draw_off_t> drawOffs;
+} thermal_parameters_t;
+
+void defaultThermalParameters(thermal_parameters_t & _parameters);
+
+/*
+ * Lumped model of a hot water tank heated by a boiler through a coil:
+ *  - the boiler heats the coil while the relay is closed;
+ *  - the coil passes heat to the tank in proportion to the temperature
+ *    difference, so heat keeps arriving after the relay opens (overshoot);
+ *  - the tank loses heat to its surroundings and to draw-offs;
+ *  - the thermistor follows the tank with a first order lag.
+ * Integrated with explicit Euler steps, which is accurate enough for steps
+ * well below the time constant of the coil.
+ */
+class ThermalModel {
+  public:
+    ThermalModel(const thermal_parameters_t & _parameters);
+    void step(double _seconds, bool _heating);
+
+    double getTime();
+    double getTankTemperature();
+    double getCoilTemperature();
+    double getSensorTemperature();
+    double getDrawnVolume();
+
+  private:
+    thermal_parameters_t parameters;
+    double tankCapacity;
+    double time;
+    double tank;
+    double coil;
+    double sensor;
+    double drawn;
+
+    double drawOffFlow(double _time);
+};
+
+#endif
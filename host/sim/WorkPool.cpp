@@ -0,0 +1,174 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+
+#include "WorkPool.h"
+
+/*
+ * Constructor, starts the workers (one per core by default).
+ */
+WorkPool::WorkPool(unsigned int _workers) {
+  if(_workers == 0) {
+    _workers = std::thread::hardware_concurrency();
+  }
+  if(_workers == 0) {
+    _workers = 1;
+  }
+  pending = 0;
+  queued = 0;
+  nextQueue = 0;
+  steals = 0;
+  stopping = false;
+  for(unsigned int i=0; i<_workers; ++i) {
+    queues.push_back(new work_queue_t());
+  }
+  for(unsigned int i=0; i<_workers; ++i) {
+    threads.push_back(std::thread(&WorkPool::run, this, i));
+  }
+}
+
+/*
+ * Destructor, finishes the submitted work and stops the workers.
+ */
+WorkPool::~WorkPool() {
+  wait();
+  {
+    std::lock_guard<std::mutex> guard(stateLock);
+    stopping = true;
+  }
+  workAvailable.notify_all();
+  for(size_t i=0; i<threads.size(); ++i) {
+    threads[i].join();
+  }
+  for(size_t i=0; i<queues.size(); ++i) {
+    delete queues[i];
+  }
+}
+
+/*
+ * Queue work, on the next worker in turn.
+ */
+void WorkPool::submit(work_t _work) {
+  work_queue_t * queue;
+  {
+    std::lock_guard<std::mutex> guard(stateLock);
+    queue = queues[nextQueue];
+    nextQueue = (nextQueue + 1) % queues.size();
+    ++pending;
+    ++queued;
+  }
+  {
+    std::lock_guard<std::mutex> guard(queue->lock);
+    queue->work.push_back(_work);
+  }
+  workAvailable.notify_one();
+}
+
+/*
+ * Wait until all submitted work is done.
+ */
+void WorkPool::wait() {
+  std::unique_lock<std::mutex> guard(stateLock);
+  while(pending > 0) {
+    workDone.wait(guard);
+  }
+}
+
+/*
+ * Number of workers.
+ */
+unsigned int WorkPool::getWorkers() {
+  return threads.size();
+}
+
+/*
+ * Number of jobs taken from the queue of another worker.
+ */
+unsigned long WorkPool::getSteals() {
+  std::lock_guard<std::mutex> guard(stateLock);
+  return steals;
+}
+
+/*
+ * Worker: take work until the pool stops.
+ */
+void WorkPool::run(unsigned int _worker) {
+  while(true) {
+    {
+      std::unique_lock<std::mutex> guard(stateLock);
+      while(queued == 0 && !stopping) {
+        workAvailable.wait(guard);
+      }
+      if(queued == 0) {
+        return;
+      }
+    }
+
+    work_t work;
+    if(!take(_worker, work)) {
+      continue;
+    }
+    work();
+
+    std::lock_guard<std::mutex> guard(stateLock);
+    if(--pending == 0) {
+      workDone.notify_all();
+    }
+  }
+}
+
+/*
+ * Take work from the back of the own queue, or steal it from the front of
+ * another one. Returns false when another worker was faster (or the work
+ * is counted but not queued yet).
+ */
+bool WorkPool::take(unsigned int _worker, work_t & _work) {
+  size_t count = queues.size();
+  for(size_t i=0; i<count; ++i) {
+    work_queue_t * queue = queues[(_worker + i) % count];
+    std::unique_lock<std::mutex> guard(queue->lock);
+    if(queue->work.empty()) {
+      continue;
+    }
+    if(i == 0) {
+      _work = queue->work.back();
+      queue->work.pop_back();
+    } else {
+      _work = queue->work.front();
+      queue->work.pop_front();
+    }
+    guard.unlock();
+
+    std::lock_guard<std::mutex> state(stateLock);
+    --queued;
+    if(i > 0) {
+      ++steals;
+    }
+    return true;
+  }
+  return false;
+}
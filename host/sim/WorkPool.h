@@ -0,0 +1,81 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+
+#ifndef _WORKPOOL_H_
+#define _WORKPOOL_H_
+
+#include <stddef.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef std::function<void()> work_t;
+
+/*
+ * Work stealing thread pool. Every worker has its own queue: it takes work
+ * from the back of its own queue and, once that's empty, steals from the
+ * front of the others. Work is handed out round robin, so with jobs of
+ * unequal length the idle workers even out the load instead of waiting.
+ *
+ * The queues are guarded by a mutex each, the jobs this is meant for
+ * (simulation runs) take far longer than a lock.
+ */
+class WorkPool {
+  public:
+    WorkPool(unsigned int _workers = 0);
+    ~WorkPool();
+    void submit(work_t _work);
+    void wait();
+    unsigned int getWorkers();
+    unsigned long getSteals();
+
+  private:
+    typedef struct work_queue {
+      std::mutex lock;
+      std::deque<work_t> work;
+    } work_queue_t;
+
+    std::vector<work_queue_t *> queues;
+    std::vector<std::thread> threads;
+    std::mutex stateLock;
+    std::condition_variable workAvailable;
+    std::condition_variable workDone;
+    size_t pending;
+    size_t queued;
+    size_t nextQueue;
+    unsigned long steals;
+    bool stopping;
+
+    void run(unsigned int _worker);
+    bool take(unsigned int _worker, work_t & _work);
+};
+
+#endif
@@ -0,0 +1,359 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+
+#include "Arduino.h"
+#include "SimBoard.h"
+
+HardwareSerial Serial;
+
+/*
+ * The board of the calling thread, there has to be one.
+ */
+static SimBoard * board() {
+  SimBoard * current = SimBoard::current();
+  if(current == NULL) {
+    fprintf(stderr, "no simulated board selected for this thread\n");
+    abort();
+  }
+  return current;
+}
+
+/*
+ * Milliseconds since the board started.
+ */
+unsigned long millis() {
+  return board()->getMicros() / 1000;
+}
+
+/*
+ * Microseconds since the board started.
+ */
+unsigned long micros() {
+  return board()->getMicros();
+}
+
+/*
+ * Wait, on the virtual clock: returns right away.
+ */
+void delay(unsigned long _ms) {
+  board()->advance((uint64_t)_ms * 1000);
+}
+
+/*
+ * Wait, on the virtual clock.
+ */
+void delayMicroseconds(unsigned int _us) {
+  board()->advance(_us);
+}
+
+/*
+ * Set the mode of a pin, INPUT_PULLUP pulls an input high.
+ */
+void pinMode(uint8_t _pin, uint8_t _mode) {
+  board()->setPinMode(_pin, _mode);
+  if(_mode == INPUT_PULLUP) {
+    board()->setDigital(_pin, HIGH);
+  }
+}
+
+/*
+ * Drive a pin.
+ */
+void digitalWrite(uint8_t _pin, uint8_t _value) {
+  board()->setDigital(_pin, _value);
+}
+
+/*
+ * Read a pin.
+ */
+int digitalRead(uint8_t _pin) {
+  return board()->getDigital(_pin);
+}
+
+/*
+ * Convert an analog input, A0-A5 or 0-5.
+ */
+int analogRead(uint8_t _pin) {
+  if(_pin < SIM_ANALOG_PIN) {
+    _pin += SIM_ANALOG_PIN;
+  }
+  return board()->getAnalog(_pin);
+}
+
+/*
+ * The reference is part of the simulated input levels.
+ */
+void analogReference(uint8_t _mode) {
+}
+
+/*
+ * Ask the host to reset the board.
+ */
+void resetBoard() {
+  board()->requestReset();
+}
+
+/*
+ * Write a buffer.
+ */
+size_t Print::write(const uint8_t * _buffer, size_t _length) {
+  size_t written = 0;
+  while(_length--) {
+    written += write(*_buffer++);
+  }
+  return written;
+}
+
+/*
+ * Write a string.
+ */
+size_t Print::write(const char * _text) {
+  return write((const uint8_t *)_text, strlen(_text));
+}
+
+/*
+ * Write a buffer of characters.
+ */
+size_t Print::write(const char * _buffer, size_t _length) {
+  return write((const uint8_t *)_buffer, _length);
+}
+
+/*
+ * Print a string from flash (ordinary memory on the host.)
+ */
+size_t Print::print(const __FlashStringHelper * _text) {
+  return write((const char *)_text);
+}
+
+/*
+ * Print a string.
+ */
+size_t Print::print(const char * _text) {
+  return write(_text);
+}
+
+/*
+ * Print a character.
+ */
+size_t Print::print(char _value) {
+  return write((uint8_t)_value);
+}
+
+/*
+ * Print a number.
+ */
+size_t Print::print(unsigned char _value, int _base) {
+  return print((unsigned long)_value, _base);
+}
+
+/*
+ * Print a number.
+ */
+size_t Print::print(int _value, int _base) {
+  return print((long)_value, _base);
+}
+
+/*
+ * Print a number.
+ */
+size_t Print::print(unsigned int _value, int _base) {
+  return print((unsigned long)_value, _base);
+}
+
+/*
+ * Print a number, negative numbers only get a sign in base 10.
+ */
+size_t Print::print(long _value, int _base) {
+  if(_base == DEC && _value < 0) {
+    return write((uint8_t)'-') + printNumber(-(unsigned long)_value, DEC);
+  }
+  return printNumber((unsigned long)_value, _base);
+}
+
+/*
+ * Print a number.
+ */
+size_t Print::print(unsigned long _value, int _base) {
+  return printNumber(_value, _base);
+}
+
+/*
+ * Print a floating point number with a fixed number of decimals.
+ */
+size_t Print::print(double _value, int _digits) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.*f", _digits, _value);
+  return write(buffer);
+}
+
+/*
+ * End a line.
+ */
+size_t Print::println() {
+  return write("\r\n");
+}
+
+/*
+ * Print and end the line.
+ */
+size_t Print::println(const __FlashStringHelper * _text) {
+  return print(_text) + println();
+}
+
+/*
+ * Print and end the line.
+ */
+size_t Print::println(const char * _text) {
+  return print(_text) + println();
+}
+
+/*
+ * Print and end the line.
+ */
+size_t Print::println(char _value) {
+  return print(_value) + println();
+}
+
+/*
+ * Print and end the line.
+ */
+size_t Print::println(unsigned char _value, int _base) {
+  return print(_value, _base) + println();
+}
+
+/*
+ * Print and end the line.
+ */
+size_t Print::println(int _value, int _base) {
+  return print(_value, _base) + println();
+}
+
+/*
+ * Print and end the line.
+ */
+size_t Print::println(unsigned int _value, int _base) {
+  return print(_value, _base) + println();
+}
+
+/*
+ * Print and end the line.
+ */
+size_t Print::println(long _value, int _base) {
+  return print(_value, _base) + println();
+}
+
+/*
+ * Print and end the line.
+ */
+size_t Print::println(unsigned long _value, int _base) {
+  return print(_value, _base) + println();
+}
+
+/*
+ * Print and end the line.
+ */
+size_t Print::println(double _value, int _digits) {
+  return print(_value, _digits) + println();
+}
+
+/*
+ * Print the digits of a number in a base between 2 and 16.
+ */
+size_t Print::printNumber(unsigned long _value, int _base) {
+  char buffer[8 * sizeof(unsigned long) + 1];
+  char * digit = &buffer[sizeof(buffer) - 1];
+  *digit = '\0';
+  if(_base < 2 || _base > 16) {
+    _base = DEC;
+  }
+  do {
+    unsigned long remainder = _value % _base;
+    _value /= _base;
+    *--digit = remainder < 10 ? '0' + remainder : 'A' + remainder - 10;
+  } while(_value > 0);
+  return write(digit);
+}
+
+/*
+ * Open the port.
+ */
+void HardwareSerial::begin(unsigned long _baud) {
+  board()->serialBegin(_baud);
+}
+
+/*
+ * Close the port.
+ */
+void HardwareSerial::end() {
+  board()->serialEnd();
+}
+
+/*
+ * Number of received characters.
+ */
+int HardwareSerial::available() {
+  return board()->serialAvailable();
+}
+
+/*
+ * Take a received character, -1 when there's none.
+ */
+int HardwareSerial::read() {
+  return board()->serialRead();
+}
+
+/*
+ * Free space in the transmit buffer.
+ */
+int HardwareSerial::availableForWrite() {
+  return board()->serialAvailableForWrite();
+}
+
+/*
+ * Wait until everything was sent.
+ */
+void HardwareSerial::flush() {
+  while(board()->serialAvailableForWrite() < SIM_SERIAL_BUFFER - 1) {
+    board()->advance(100);
+  }
+}
+
+/*
+ * Send a character, waits while the transmit buffer is full.
+ */
+size_t HardwareSerial::write(uint8_t _value) {
+  board()->serialWrite(_value);
+  return 1;
+}
+
+/*
+ * True once the port is open.
+ */
+HardwareSerial::operator bool() {
+  return board()->isSerialOpen();
+}
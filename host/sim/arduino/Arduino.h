@@ -0,0 +1,155 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+
+#ifndef _ARDUINO_H_
+#define _ARDUINO_H_
+
+/*
+ * Stand-in for the Arduino core on the host: the part of the API used by
+ * the sketch, backed by the simulated board of the calling thread (see
+ * SimBoard.h). Everything is resolved at compile time, the sketch sources
+ * are built unchanged against these headers.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <avr/pgmspace.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x0
+#define OUTPUT       0x1
+#define INPUT_PULLUP 0x2
+
+#define LED_BUILTIN 13
+
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+
+#define DEFAULT  1
+#define EXTERNAL 0
+#define INTERNAL 3
+
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+// Time (virtual clock of the board)
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long _ms);
+void delayMicroseconds(unsigned int _us);
+
+// Pins
+void pinMode(uint8_t _pin, uint8_t _mode);
+void digitalWrite(uint8_t _pin, uint8_t _value);
+int digitalRead(uint8_t _pin);
+int analogRead(uint8_t _pin);
+void analogReference(uint8_t _mode);
+
+// There are no interrupts on the host, timers run from the clock
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+// Not part of the Arduino core: the sketch jumps to the reset vector on AVR
+void resetBoard();
+
+class __FlashStringHelper;
+#define F(_text) (reinterpret_cast<const __FlashStringHelper *>(_text))
+
+/*
+ * Formatted output on top of write(), like the Print class of the core.
+ */
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t _value) = 0;
+    virtual size_t write(const uint8_t * _buffer, size_t _length);
+    size_t write(const char * _text);
+    size_t write(const char * _buffer, size_t _length);
+
+    size_t print(const __FlashStringHelper * _text);
+    size_t print(const char * _text);
+    size_t print(char _value);
+    size_t print(unsigned char _value, int _base = DEC);
+    size_t print(int _value, int _base = DEC);
+    size_t print(unsigned int _value, int _base = DEC);
+    size_t print(long _value, int _base = DEC);
+    size_t print(unsigned long _value, int _base = DEC);
+    size_t print(double _value, int _digits = 2);
+
+    size_t println();
+    size_t println(const __FlashStringHelper * _text);
+    size_t println(const char * _text);
+    size_t println(char _value);
+    size_t println(unsigned char _value, int _base = DEC);
+    size_t println(int _value, int _base = DEC);
+    size_t println(unsigned int _value, int _base = DEC);
+    size_t println(long _value, int _base = DEC);
+    size_t println(unsigned long _value, int _base = DEC);
+    size_t println(double _value, int _digits = 2);
+
+  private:
+    size_t printNumber(unsigned long _value, int _base);
+};
+
+/*
+ * The serial port of the board.
+ */
+class HardwareSerial : public Print {
+  public:
+    void begin(unsigned long _baud);
+    void end();
+    int available();
+    int read();
+    int availableForWrite();
+    void flush();
+    virtual size_t write(uint8_t _value);
+    using Print::write;
+    operator bool();
+};
+
+extern HardwareSerial Serial;
+
+#endif
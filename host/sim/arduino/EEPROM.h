@@ -0,0 +1,75 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+
+#ifndef _EEPROM_H_
+#define _EEPROM_H_
+
+#include <stdint.h>
+#include "Arduino.h"
+
+/*
+ * Stand-in for the EEPROM library, on the EEPROM image of the board.
+ */
+class EEPROMClass {
+  public:
+    uint8_t read(int _address);
+    void write(int _address, uint8_t _value);
+    void update(int _address, uint8_t _value);
+    uint16_t length();
+
+    template<typename T> T & get(int _address, T & _value);
+    template<typename T> const T & put(int _address, const T & _value);
+};
+
+/*
+ * Read an object, byte by byte.
+ */
+template<typename T>
+T & EEPROMClass::get(int _address, T & _value) {
+  uint8_t * bytes = (uint8_t *)&_value;
+  for(size_t i=0; i<sizeof(T); ++i) {
+    bytes[i] = read(_address + i);
+  }
+  return _value;
+}
+
+/*
+ * Write an object, only the bytes that change (like update()).
+ */
+template<typename T>
+const T & EEPROMClass::put(int _address, const T & _value) {
+  const uint8_t * bytes = (const uint8_t *)&_value;
+  for(size_t i=0; i<sizeof(T); ++i) {
+    update(_address + i, bytes[i]);
+  }
+  return _value;
+}
+
+extern EEPROMClass EEPROM;
+
+#endif
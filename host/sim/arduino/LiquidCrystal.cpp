@@ -0,0 +1,80 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+
+#include "LiquidCrystal.h"
+#include "SimBoard.h"
+
+/*
+ * Constructor, the pins are ignored.
+ */
+LiquidCrystal::LiquidCrystal(uint8_t _rs, uint8_t _enable,
+                             uint8_t _d4, uint8_t _d5, uint8_t _d6, uint8_t _d7) {
+}
+
+/*
+ * Initialize the display (always 20x4.)
+ */
+void LiquidCrystal::begin(uint8_t _columns, uint8_t _rows) {
+  SimBoard::current()->lcdClear();
+}
+
+/*
+ * Clear the display.
+ */
+void LiquidCrystal::clear() {
+  SimBoard::current()->lcdClear();
+}
+
+/*
+ * Move the cursor to the top left corner.
+ */
+void LiquidCrystal::home() {
+  SimBoard::current()->lcdSetCursor(0, 0);
+}
+
+/*
+ * Move the cursor.
+ */
+void LiquidCrystal::setCursor(uint8_t _column, uint8_t _row) {
+  SimBoard::current()->lcdSetCursor(_column, _row);
+}
+
+/*
+ * Define a custom character.
+ */
+void LiquidCrystal::createChar(uint8_t _location, uint8_t _rows[]) {
+  SimBoard::current()->lcdCreateChar(_location, _rows);
+}
+
+/*
+ * Put a character at the cursor.
+ */
+size_t LiquidCrystal::write(uint8_t _value) {
+  SimBoard::current()->lcdWrite(_value);
+  return 1;
+}
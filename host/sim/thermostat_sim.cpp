@@ -0,0 +1,181 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+
+/*
+ * Description:
+ *   Runs the complete sketch on a simulated board, on a virtual clock:
+ *
+ *     thermostat_sim [options]
+ *       --hours <h>          simulated time (default 24)
+ *       --temperature <t>    tank temperature in degrees (default 60)
+ *       --disabled           keep the enable input low
+ *       --eeprom <file>      EEPROM image, loaded before and saved after
+ *                            the run
+ *       --send <text>        characters received on the serial port at the
+ *                            start (\n for a new line)
+ *       --serial             copy the serial output to stdout
+ *
+ *   At the end the LCD and a few counters of the board are printed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include "SimBoard.h"
+#include "SensorTable.h"
+#include "MagicNumbers.h"
+#include "AnalogSampler.h"
+
+// Entry points of the sketch (Sketch.cpp)
+void setup();
+void loop();
+
+/*
+ * Stand-in for the timer that triggers the conversions.
+ */
+static void triggerSampler(void * _context) {
+  ((AnalogSampler *)_context)->trigger();
+}
+
+/*
+ * Replace the \n escapes of a command line argument.
+ */
+static std::string unescape(const char * _text) {
+  std::string text;
+  for(; *_text; ++_text) {
+    if(_text[0] == '\\' && _text[1] == 'n') {
+      text.push_back('\n');
+      ++_text;
+    } else {
+      text.push_back(*_text);
+    }
+  }
+  return text;
+}
+
+/*
+ * Wall clock time (s.)
+ */
+static double wallTime() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*
+ * Print the usage and quit.
+ */
+static void usage() {
+  fprintf(stderr, "usage: thermostat_sim [--hours <h>] [--temperature <t>] [--disabled]\n"
+                  "                      [--eeprom <file>] [--send <text>] [--serial]\n");
+  exit(2);
+}
+
+/*
+ * Run the sketch for the requested time and show the result.
+ */
+int main(int _argc, char ** _argv) {
+  double hours = 24;
+  double temperature = 60;
+  bool enabled = true;
+  const char * eepromPath = NULL;
+  std::string input;
+  bool echoSerial = false;
+
+  for(int i=1; i<_argc; ++i) {
+    const char * option = _argv[i];
+    bool hasValue = i + 1 < _argc;
+    if(strcmp(option, "--hours") == 0 && hasValue) {
+      hours = atof(_argv[++i]);
+    } else if(strcmp(option, "--temperature") == 0 && hasValue) {
+      temperature = atof(_argv[++i]);
+    } else if(strcmp(option, "--disabled") == 0) {
+      enabled = false;
+    } else if(strcmp(option, "--eeprom") == 0 && hasValue) {
+      eepromPath = _argv[++i];
+    } else if(strcmp(option, "--send") == 0 && hasValue) {
+      input += unescape(_argv[++i]);
+    } else if(strcmp(option, "--serial") == 0) {
+      echoSerial = true;
+    } else {
+      usage();
+    }
+  }
+
+  SimBoard board;
+  board.select();
+  if(eepromPath != NULL) {
+    board.loadEeprom(eepromPath);
+  }
+  SensorTable sensorTable;
+  board.setAnalog(THERMISTOR_PIN, sensorTable.rawFor(temperature));
+  board.setDigital(ENABLE_PIN, enabled ? HIGH : LOW);
+
+  double start = wallTime();
+  setup();
+  if(AnalogSampler::active != NULL) {
+    board.attachTimer(1000000UL / ADC_SAMPLE_RATE, triggerSampler, AnalogSampler::active);
+  }
+  board.sendSerial(input.c_str());
+
+  uint64_t end = (uint64_t)(hours * 3600e6);
+  while(board.getMicros() < end && !board.isResetRequested()) {
+    loop();
+    std::string output = board.takeSerialOutput();
+    if(echoSerial && !output.empty()) {
+      fwrite(output.data(), 1, output.size(), stdout);
+    }
+  }
+  double elapsed = wallTime() - start;
+
+  if(eepromPath != NULL && !board.saveEeprom(eepromPath)) {
+    fprintf(stderr, "can't write %s\n", eepromPath);
+  }
+
+  printf("+--------------------+\n");
+  for(uint8_t row=0; row<SIM_LCD_ROWS; ++row) {
+    std::string line = board.getLcdLine(row);
+    for(size_t i=0; i<line.size(); ++i) {
+      if((uint8_t)line[i] < SIM_GLYPHS) {
+        line[i] = '#';
+      } else if(line[i] == '\337') {
+        line[i] = 'o';
+      }
+    }
+    printf("|%s|\n", line.c_str());
+  }
+  printf("+--------------------+\n");
+  double simulated = board.getMicros() / 1e6;
+  printf("simulated %.0f s in %.3f s (%.0fx)%s\n", simulated, elapsed,
+         elapsed > 0 ? simulated / elapsed : 0, board.isResetRequested() ? ", reset" : "");
+  printf("relay switches %lu, eeprom writes %lu, lcd transactions %lu\n",
+         board.getTransitions(RELAY_PIN), board.getEepromWrites(), board.getLcdTransactions());
+  return 0;
+}
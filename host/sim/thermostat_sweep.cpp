@@ -0,0 +1,465 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+
+/*
+ * Description:
+ *   Tunes the thermostat on a simulated tank: runs the Thermostat of the
+ *   sketch (on a simulated board) against a lumped thermal model of the
+ *   tank (see ThermalModel.h) for every combination of the given settings,
+ *   in parallel, and reports how each combination did:
+ *
+ *     thermostat_sweep [options]
+ *       --setpoint <values>     requested temperature (centi-degrees)
+ *       --hysteresis <values>   hysteresis (centi-degrees)
+ *       --grace <values>        grace time (s.)
+ *       --maxheat <values>      maximum heat time (s.)
+ *       --control <values>      control mode (CONTROL_*)
+ *       --gain <values>, --integral <values>, --derivative <values>,
+ *       --window <values>, --pulse <values>
+ *                               tuning of the PID (see Pid.h)
+ *       --days <d>              simulated time per run (default 7)
+ *       --alarm-restart <s>     time a unit stays in alarm before it's
+ *                               power cycled (default 1800)
+ *       --power <W>, --volume <l>, --loss <W/K>, --lag <s>, --start <t>
+ *                               tank and boiler (see ThermalModel.cpp)
+ *       --threads <n>           workers (default: one per core)
+ *       --json                  JSON instead of CSV
+ *
+ *   Values are a comma separated list or a range from:to:step, in the
+ *   units of the serial commands. Settings that aren't swept keep their
+ *   default.
+ *
+ *   Per run: the worst and the mean (per heat cycle) overshoot above
+ *   setpoint + hysteresis / 2 and undershoot below setpoint - hysteresis /
+ *   2 of the tank (after the first heat cycle), relay cycles per hour, the
+ *   share of the time the boiler was on, the energy it delivered, the
+ *   number of alarms and the RMS deviation of the tank from the setpoint
+ *   (after the first heat cycle).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include "SimBoard.h"
+#include "SensorTable.h"
+#include "ThermalModel.h"
+#include "WorkPool.h"
+#include "MagicNumbers.h"
+#include "AnalogSampler.h"
+#include "Telemetry.h"
+#include "Thermostat.h"
+
+/*
+ * One combination of settings.
+ */
+typedef struct sweep_settings {
+  long setpoint;
+  long hysteresis;
+  long grace;
+  long maxheat;
+  long control;
+  long gain;
+  long integral;
+  long derivative;
+  long window;
+  long pulse;
+} sweep_settings_t;
+
+// The settings that can be swept, in the order of the grid (the last one
+// changes fastest)
+#define SWEEP_AXES 10
+
+/*
+ * Outcome of a run.
+ */
+typedef struct sweep_result {
+  double overshootMax;
+  double overshootMean;
+  double undershootMax;
+  double undershootMean;
+  double cyclesPerHour;
+  double heatShare;
+  double energy;
+  unsigned int alarms;
+  double errorRms;
+} sweep_result_t;
+
+/*
+ * Everything a run needs besides its settings.
+ */
+typedef struct sweep_setup {
+  thermal_parameters_t model;
+  double days;
+  double alarmRestart;
+} sweep_setup_t;
+
+static SensorTable sensorTable;
+
+/*
+ * Stand-in for the timer that triggers the conversions.
+ */
+static void triggerSampler(void * _context) {
+  ((AnalogSampler *)_context)->trigger();
+}
+
+/*
+ * Bring up a thermostat with the settings of the run (as after a power
+ * cycle: the EEPROM holds the defaults, the settings are applied on top).
+ */
+static void startThermostat(Thermostat & _thermostat, const sweep_settings_t & _settings) {
+  _thermostat.begin();
+  _thermostat.setRequestedTemperature(Centidegrees::saturate(_settings.setpoint));
+  _thermostat.setHysteresis(Centidegrees::saturate(_settings.hysteresis));
+  _thermostat.setGraceTime(_settings.grace * 1000UL);
+  _thermostat.setMaxHeatTime(_settings.maxheat * 1000UL);
+  _thermostat.setControlMode(_settings.control);
+  _thermostat.setPidGain(_settings.gain);
+  _thermostat.setPidIntegralTime(_settings.integral);
+  _thermostat.setPidDerivativeTime(_settings.derivative);
+  _thermostat.setPidWindow(_settings.window);
+  _thermostat.setPidMinimumPulse(_settings.pulse);
+}
+
+/*
+ * Simulate one combination of settings, on a board of the calling thread.
+ */
+static sweep_result_t simulate(const sweep_setup_t & _setup, const sweep_settings_t & _settings) {
+  SimBoard board;
+  board.select();
+  board.setDigital(ENABLE_PIN, HIGH);
+
+  // The sampler isn't started: begin() only registers it for the
+  // interrupt, the timer of the board drives it here.
+  AnalogSampler sampler;
+  Telemetry telemetry(&Serial);
+  Thermostat * thermostat = new Thermostat(&sampler, &telemetry, THERMISTOR_PIN, ENABLE_PIN);
+  board.attachTimer(1000000UL / ADC_SAMPLE_RATE, triggerSampler, &sampler);
+  startThermostat(*thermostat, _settings);
+
+  ThermalModel model(_setup.model);
+  double step = CONTROL_PERIOD / 1000.0;
+  double end = _setup.days * 86400;
+  double upper = (_settings.setpoint + _settings.hysteresis / 2) / 100.0;
+  double lower = (_settings.setpoint - _settings.hysteresis / 2) / 100.0;
+
+  sweep_result_t result;
+  memset(&result, 0, sizeof(result));
+  bool heating = false;
+  bool settled = false;
+  unsigned long cycles = 0;
+  double heatTime = 0;
+  double alarmSince = -1;
+  double peak = 0;
+  double trough = 0;
+  double overshootTotal = 0;
+  double undershootTotal = 0;
+  unsigned long overshoots = 0;
+  unsigned long undershoots = 0;
+  double setpoint = _settings.setpoint / 100.0;
+  double errorSquares = 0;
+  double errorTime = 0;
+
+  while(model.getTime() < end) {
+    model.step(step, heating);
+    if(heating) {
+      heatTime += step;
+    }
+    board.setAnalog(THERMISTOR_PIN, sensorTable.rawFor(model.getSensorTemperature()));
+    board.advance(CONTROL_PERIOD * 1000UL);
+
+    // A unit in alarm is power cycled after a while
+    if(thermostat->inAlarm()) {
+      if(alarmSince < 0) {
+        alarmSince = model.getTime();
+        ++result.alarms;
+      } else if(model.getTime() - alarmSince >= _setup.alarmRestart) {
+        delete thermostat;
+        thermostat = new Thermostat(&sampler, &telemetry, THERMISTOR_PIN, ENABLE_PIN);
+        startThermostat(*thermostat, _settings);
+        alarmSince = -1;
+      }
+    }
+
+    thermostat->sample(millis());
+    bool next = thermostat->shouldHeat();
+
+    // Track the extremes of the tank between relay switches
+    double tank = model.getTankTemperature();
+    if(next && !heating) {
+      ++cycles;
+      if(settled && peak > upper) {
+        overshootTotal += peak - upper;
+        ++overshoots;
+      }
+      trough = tank;
+    } else if(!next && heating) {
+      if(settled && trough < lower) {
+        undershootTotal += lower - trough;
+        ++undershoots;
+      }
+      settled = true;
+      peak = tank;
+    }
+    if(next) {
+      trough = tank < trough ? tank : trough;
+    } else {
+      peak = tank > peak ? tank : peak;
+    }
+    if(settled || !next) {
+      if(tank - upper > result.overshootMax) {
+        result.overshootMax = tank - upper;
+      }
+    }
+    if(settled && lower - tank > result.undershootMax) {
+      result.undershootMax = lower - tank;
+    }
+    if(settled) {
+      errorSquares += (tank - setpoint) * (tank - setpoint) * step;
+      errorTime += step;
+    }
+    heating = next;
+  }
+  delete thermostat;
+
+  result.overshootMean = overshoots > 0 ? overshootTotal / overshoots : 0;
+  result.undershootMean = undershoots > 0 ? undershootTotal / undershoots : 0;
+  result.cyclesPerHour = cycles / (end / 3600);
+  result.heatShare = heatTime / end;
+  result.energy = heatTime * _setup.model.heaterPower / 3.6e6;
+  result.errorRms = errorTime > 0 ? sqrt(errorSquares / errorTime) : 0;
+  return result;
+}
+
+/*
+ * Parse a list of values: a,b,c or from:to:step.
+ */
+static bool parseValues(const char * _text, std::vector<long> & _values) {
+  _values.clear();
+  long from, to, step;
+  char tail;
+  if(sscanf(_text, "%ld:%ld:%ld%c", &from, &to, &step, &tail) == 3) {
+    if(step <= 0 || to < from) {
+      return false;
+    }
+    for(long value=from; value<=to; value+=step) {
+      _values.push_back(value);
+    }
+    return true;
+  }
+  const char * position = _text;
+  while(*position) {
+    char * end;
+    _values.push_back(strtol(position, &end, 10));
+    if(end == position || (*end != ',' && *end != '\0')) {
+      return false;
+    }
+    position = *end == ',' ? end + 1 : end;
+  }
+  return !_values.empty();
+}
+
+/*
+ * Wall clock time (s.)
+ */
+static double wallTime() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*
+ * Print the usage and quit.
+ */
+static void usage() {
+  fprintf(stderr, "usage: thermostat_sweep [--setpoint <values>] [--hysteresis <values>]\n"
+                  "                        [--grace <values>] [--maxheat <values>]\n"
+                  "                        [--control <values>] [--gain <values>]\n"
+                  "                        [--integral <values>] [--derivative <values>]\n"
+                  "                        [--window <values>] [--pulse <values>] [--days <d>]\n"
+                  "                        [--alarm-restart <s>] [--power <W>] [--volume <l>]\n"
+                  "                        [--loss <W/K>] [--lag <s>] [--start <t>]\n"
+                  "                        [--threads <n>] [--json]\n"
+                  "values: a,b,c or from:to:step\n");
+  exit(2);
+}
+
+/*
+ * Run the grid and print the results, in the order of the grid.
+ */
+int main(int _argc, char ** _argv) {
+  std::vector<long> setpoints(1, DEFAULT_REQUESTED_TEMPERATURE);
+  std::vector<long> hystereses(1, DEFAULT_HYSTERESIS);
+  std::vector<long> graces(1, DEFAULT_GRACE_TIME / 1000);
+  std::vector<long> maxheats(1, DEFAULT_MAX_HEAT_TIME / 1000);
+  std::vector<long> controls(1, DEFAULT_CONTROL_MODE);
+  std::vector<long> gains(1, DEFAULT_PID_GAIN);
+  std::vector<long> integrals(1, DEFAULT_PID_INTEGRAL_TIME);
+  std::vector<long> derivatives(1, DEFAULT_PID_DERIVATIVE_TIME);
+  std::vector<long> windows(1, DEFAULT_PID_WINDOW);
+  std::vector<long> pulses(1, DEFAULT_PID_MINIMUM_PULSE);
+  sweep_setup_t setup;
+  defaultThermalParameters(setup.model);
+  setup.days = 7;
+  setup.alarmRestart = 1800;
+  unsigned int threads = 0;
+  bool json = false;
+
+  for(int i=1; i<_argc; ++i) {
+    const char * option = _argv[i];
+    const char * value = i + 1 < _argc ? _argv[i + 1] : NULL;
+    bool valid = value != NULL;
+    if(strcmp(option, "--json") == 0) {
+      json = true;
+      continue;
+    } else if(strcmp(option, "--setpoint") == 0 && valid) {
+      valid = parseValues(value, setpoints);
+    } else if(strcmp(option, "--hysteresis") == 0 && valid) {
+      valid = parseValues(value, hystereses);
+    } else if(strcmp(option, "--grace") == 0 && valid) {
+      valid = parseValues(value, graces);
+    } else if(strcmp(option, "--maxheat") == 0 && valid) {
+      valid = parseValues(value, maxheats);
+    } else if(strcmp(option, "--control") == 0 && valid) {
+      valid = parseValues(value, controls);
+    } else if(strcmp(option, "--gain") == 0 && valid) {
+      valid = parseValues(value, gains);
+    } else if(strcmp(option, "--integral") == 0 && valid) {
+      valid = parseValues(value, integrals);
+    } else if(strcmp(option, "--derivative") == 0 && valid) {
+      valid = parseValues(value, derivatives);
+    } else if(strcmp(option, "--window") == 0 && valid) {
+      valid = parseValues(value, windows);
+    } else if(strcmp(option, "--pulse") == 0 && valid) {
+      valid = parseValues(value, pulses);
+    } else if(strcmp(option, "--days") == 0 && valid) {
+      setup.days = atof(value);
+    } else if(strcmp(option, "--alarm-restart") == 0 && valid) {
+      setup.alarmRestart = atof(value);
+    } else if(strcmp(option, "--power") == 0 && valid) {
+      setup.model.heaterPower = atof(value);
+    } else if(strcmp(option, "--volume") == 0 && valid) {
+      setup.model.volume = atof(value);
+    } else if(strcmp(option, "--loss") == 0 && valid) {
+      setup.model.lossRate = atof(value);
+    } else if(strcmp(option, "--lag") == 0 && valid) {
+      setup.model.sensorLag = atof(value);
+    } else if(strcmp(option, "--start") == 0 && valid) {
+      setup.model.startTemperature = atof(value);
+    } else if(strcmp(option, "--threads") == 0 && valid) {
+      threads = atoi(value);
+    } else {
+      valid = false;
+    }
+    if(!valid) {
+      usage();
+    }
+    ++i;
+  }
+
+  // Every combination, as if the axes were nested loops
+  const std::vector<long> * axes[SWEEP_AXES] = {&setpoints, &hystereses, &graces, &maxheats,
+                                                &controls, &gains, &integrals, &derivatives,
+                                                &windows, &pulses};
+  size_t combinations = 1;
+  for(int a=0; a<SWEEP_AXES; ++a) {
+    combinations *= axes[a]->size();
+  }
+  std::vector<sweep_settings_t> grid;
+  for(size_t n=0; n<combinations; ++n) {
+    long values[SWEEP_AXES];
+    size_t rest = n;
+    for(int a=SWEEP_AXES-1; a>=0; --a) {
+      values[a] = (*axes[a])[rest % axes[a]->size()];
+      rest /= axes[a]->size();
+    }
+    grid.push_back(sweep_settings_t {values[0], values[1], values[2], values[3], values[4],
+                                     values[5], values[6], values[7], values[8], values[9]});
+  }
+
+  std::vector<sweep_result_t> results(grid.size());
+  double start = wallTime();
+  unsigned int workers;
+  unsigned long steals;
+  {
+    WorkPool pool(threads);
+    for(size_t i=0; i<grid.size(); ++i) {
+      pool.submit([&setup, &grid, &results, i]() {
+        results[i] = simulate(setup, grid[i]);
+      });
+    }
+    pool.wait();
+    workers = pool.getWorkers();
+    steals = pool.getSteals();
+  }
+  double elapsed = wallTime() - start;
+
+  if(json) {
+    printf("[\n");
+  } else {
+    printf("setpoint,hysteresis,grace,maxheat,control,gain,integral,derivative,window,pulse,"
+           "overshoot_max,overshoot_mean,undershoot_max,undershoot_mean,cycles_per_hour,"
+           "heat_share,energy_kwh,alarms,error_rms\n");
+  }
+  for(size_t i=0; i<grid.size(); ++i) {
+    const sweep_settings_t & settings = grid[i];
+    const sweep_result_t & result = results[i];
+    if(json) {
+      printf("  {\"setpoint\": %ld, \"hysteresis\": %ld, \"grace\": %ld, \"maxheat\": %ld, "
+             "\"control\": %ld, \"gain\": %ld, \"integral\": %ld, \"derivative\": %ld, "
+             "\"window\": %ld, \"pulse\": %ld, "
+             "\"overshoot_max\": %.2f, \"overshoot_mean\": %.2f, \"undershoot_max\": %.2f, "
+             "\"undershoot_mean\": %.2f, \"cycles_per_hour\": %.3f, \"heat_share\": %.4f, "
+             "\"energy_kwh\": %.2f, \"alarms\": %u, \"error_rms\": %.2f}%s\n",
+             settings.setpoint, settings.hysteresis, settings.grace, settings.maxheat,
+             settings.control, settings.gain, settings.integral, settings.derivative,
+             settings.window, settings.pulse,
+             result.overshootMax, result.overshootMean, result.undershootMax,
+             result.undershootMean, result.cyclesPerHour, result.heatShare,
+             result.energy, result.alarms, result.errorRms, i + 1 < grid.size() ? "," : "");
+    } else {
+      printf("%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%.2f,%.2f,%.2f,%.2f,%.3f,%.4f,%.2f,%u,%.2f\n",
+             settings.setpoint, settings.hysteresis, settings.grace, settings.maxheat,
+             settings.control, settings.gain, settings.integral, settings.derivative,
+             settings.window, settings.pulse,
+             result.overshootMax, result.overshootMean, result.undershootMax,
+             result.undershootMean, result.cyclesPerHour, result.heatShare,
+             result.energy, result.alarms, result.errorRms);
+    }
+  }
+  if(json) {
+    printf("]\n");
+  }
+  fprintf(stderr, "%zu runs of %.1f days in %.2f s on %u workers (%lu steals)\n",
+          grid.size(), setup.days, elapsed, workers, steals);
+  return 0;
+}
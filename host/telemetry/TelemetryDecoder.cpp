@@ -0,0 +1,209 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+#include "TelemetryDecoder.h"
+
+// Longest frame accepted before giving up on a missing delimiter
+#define MAX_ENCODED_FRAME 512
+
+/*
+ * Add a byte to a CRC-16/CCITT-FALSE (same as the sketch).
+ */
+uint16_t TelemetryDecoder::crc16Update(uint16_t _crc, uint8_t _value) {
+  _crc ^= (uint16_t)_value << 8;
+  for(int i=0; i<8; ++i) {
+    _crc = (_crc & 0x8000) ? (_crc << 1) ^ 0x1021 : _crc << 1;
+  }
+  return _crc;
+}
+
+/*
+ * Decode a COBS block (without the delimiter). Returns false on a
+ * malformed block.
+ */
+bool TelemetryDecoder::cobsDecode(const uint8_t * _input, size_t _length, std::vector<uint8_t> & _output) {
+  _output.clear();
+  size_t position = 0;
+  while(position < _length) {
+    uint8_t code = _input[position++];
+    if(code == 0 || position + code - 1 > _length) {
+      return false;
+    }
+    for(int i=1; i<code; ++i) {
+      _output.push_back(_input[position++]);
+    }
+    if(code != 0xFF && position < _length) {
+      _output.push_back(0);
+    }
+  }
+  return true;
+}
+
+/*
+ * Read little endian values
+ */
+static uint16_t get16(const uint8_t * _data) {
+  return _data[0] | (uint16_t)_data[1] << 8;
+}
+
+static uint32_t get32(const uint8_t * _data) {
+  return get16(_data) | (uint32_t)get16(_data + 2) << 16;
+}
+
+/*
+ * Constructor, the handler is called for every valid frame.
+ */
+TelemetryDecoder::TelemetryDecoder(frame_handler_t _handler) {
+  handler = _handler;
+  frames = 0;
+  crcErrors = 0;
+  framingErrors = 0;
+}
+
+/*
+ * Feed received bytes, in chunks of any size.
+ */
+void TelemetryDecoder::feed(const uint8_t * _data, size_t _length) {
+  for(size_t i=0; i<_length; ++i) {
+    if(_data[i] == 0) {
+      processFrame();
+      encoded.clear();
+    } else if(encoded.size() < MAX_ENCODED_FRAME) {
+      encoded.push_back(_data[i]);
+    }
+  }
+}
+
+/*
+ * Forget a partially received frame (e.g. after reopening the port).
+ */
+void TelemetryDecoder::reset() {
+  encoded.clear();
+}
+
+/*
+ * Check and dispatch a complete frame.
+ */
+void TelemetryDecoder::processFrame() {
+  if(encoded.empty()) {
+    return;
+  }
+  if(encoded.size() >= MAX_ENCODED_FRAME
+     || !cobsDecode(encoded.data(), encoded.size(), decoded)
+     || decoded.size() < 3) {
+    ++framingErrors;
+    return;
+  }
+
+  size_t length = decoded.size() - 2;
+  uint16_t crc = 0xFFFF;
+  for(size_t i=0; i<length; ++i) {
+    crc = crc16Update(crc, decoded[i]);
+  }
+  if(crc != get16(&decoded[length])) {
+    ++crcErrors;
+    return;
+  }
+
+  ++frames;
+  handler(decoded[0], decoded.data() + 1, length - 1);
+}
+
+/*
+ * Statistics
+ */
+uint64_t TelemetryDecoder::getFrames() {
+  return frames;
+}
+
+uint64_t TelemetryDecoder::getCrcErrors() {
+  return crcErrors;
+}
+
+uint64_t TelemetryDecoder::getFramingErrors() {
+  return framingErrors;
+}
+
+/*
+ * Unpack the payload of a status frame. Longer payloads are accepted, so
+ * fields can be appended without breaking older decoders.
+ */
+bool TelemetryDecoder::decodeStatus(const uint8_t * _payload, size_t _length, status_record_t & _record) {
+  if(_length < STATUS_RECORD_SIZE) {
+    return false;
+  }
+  _record.time = get32(_payload);
+  _record.temperature = get16(_payload + 4);
+  _record.requestedTemperature = get16(_payload + 6);
+  _record.hysteresis = get16(_payload + 8);
+  _record.flags = _payload[10];
+  _record.lastHeatStart = get32(_payload + 11);
+  _record.lastHeat = get32(_payload + 15);
+  _record.lastStatusChange = get32(_payload + 19);
+  _record.alarmCause = _payload[23];
+  _record.dutyCycle = get16(_payload + 24);
+  _record.drops = get16(_payload + 26);
+  return true;
+}
+
+/*
+ * Unpack the payload of an accounting frame, returns false if it's too
+ * short.
+ */
+bool TelemetryDecoder::decodeAccounting(const uint8_t * _payload, size_t _length, accounting_report_t & _report) {
+  if(_length < ACCOUNTING_REPORT_SIZE) {
+    return false;
+  }
+  _report.time = get32(_payload);
+  _report.set = _payload[4];
+  _report.heatSeconds = get32(_payload + 5);
+  _report.energy = get32(_payload + 9);
+  _report.cycles = get32(_payload + 13);
+  _report.graceBlocks = get32(_payload + 17);
+  for(int i=0; i<ACCOUNTING_ALARM_CAUSES; ++i) {
+    _report.alarms[i] = get16(_payload + 21 + 2 * i);
+  }
+  _report.burnerPower = get16(_payload + 27);
+  return true;
+}
+
+/*
+ * Unpack the payload of an anticipator frame, returns false if it's too
+ * short.
+ */
+bool TelemetryDecoder::decodeAnticipator(const uint8_t * _payload, size_t _length, anticipator_report_t & _report) {
+  if(_length < ANTICIPATOR_REPORT_SIZE) {
+    return false;
+  }
+  _report.time = get32(_payload);
+  _report.slope = get16(_payload + 4);
+  _report.rise = get16(_payload + 6);
+  _report.cycles = get16(_payload + 8);
+  _report.lastRise = get16(_payload + 10);
+  _report.anticipation = get16(_payload + 12);
+  return true;
+}
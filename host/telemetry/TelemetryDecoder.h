@@ -0,0 +1,126 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+#ifndef _TELEMETRYDECODER_H_
+#define _TELEMETRYDECODER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include <vector>
+#include "MagicNumbers.h"
+
+/*
+ * Host side decoder for the binary telemetry of the thermostat (see
+ * sketch/priority_thermostat/Telemetry.h). Frames are separated by zero
+ * bytes and COBS encoded; a decoded frame holds a type byte, the payload
+ * and a CRC-16/CCITT-FALSE (little endian) over the type and payload.
+ */
+
+/*
+ * Status report (TELEMETRY_FRAME_STATUS), temperatures in centi-degrees,
+ * times in ms. since the unit started.
+ */
+typedef struct status_record {
+  uint32_t time;
+  int16_t temperature;
+  int16_t requestedTemperature;
+  int16_t hysteresis;
+  uint8_t flags;
+  uint32_t lastHeatStart;
+  uint32_t lastHeat;
+  uint32_t lastStatusChange;
+  uint8_t alarmCause;
+  uint16_t dutyCycle;
+  uint16_t drops;
+} status_record_t;
+
+#define STATUS_RECORD_SIZE 28
+
+/*
+ * Accounting counters (TELEMETRY_FRAME_ACCOUNTING), the lifetime or the
+ * trip set (ACCOUNTING_LIFETIME, ACCOUNTING_TRIP).
+ */
+typedef struct accounting_report {
+  uint32_t time;
+  uint8_t set;
+  uint32_t heatSeconds;
+  uint32_t energy;
+  uint32_t cycles;
+  uint32_t graceBlocks;
+  uint16_t alarms[ACCOUNTING_ALARM_CAUSES];
+  uint16_t burnerPower;
+} accounting_report_t;
+
+#define ACCOUNTING_REPORT_SIZE 29
+
+/*
+ * Estimates of the overshoot anticipator (TELEMETRY_FRAME_ANTICIPATOR),
+ * slope and rise in fixed point with ANTICIPATOR_FRACTION_BITS fractional
+ * bits.
+ */
+typedef struct anticipator_report {
+  uint32_t time;
+  int16_t slope;
+  int16_t rise;
+  uint16_t cycles;
+  int16_t lastRise;
+  int16_t anticipation;
+} anticipator_report_t;
+
+#define ANTICIPATOR_REPORT_SIZE 14
+
+typedef std::function<void(uint8_t _type, const uint8_t * _payload, size_t _length)> frame_handler_t;
+
+class TelemetryDecoder {
+  public:
+    TelemetryDecoder(frame_handler_t _handler);
+    void feed(const uint8_t * _data, size_t _length);
+    void reset();
+
+    uint64_t getFrames();
+    uint64_t getCrcErrors();
+    uint64_t getFramingErrors();
+
+    static bool decodeStatus(const uint8_t * _payload, size_t _length, status_record_t & _record);
+    static bool decodeAccounting(const uint8_t * _payload, size_t _length, accounting_report_t & _report);
+    static bool decodeAnticipator(const uint8_t * _payload, size_t _length, anticipator_report_t & _report);
+    static uint16_t crc16Update(uint16_t _crc, uint8_t _value);
+    static bool cobsDecode(const uint8_t * _input, size_t _length, std::vector<uint8_t> & _output);
+
+  private:
+    frame_handler_t handler;
+    std::vector<uint8_t> encoded;
+    std::vector<uint8_t> decoded;
+    uint64_t frames;
+    uint64_t crcErrors;
+    uint64_t framingErrors;
+
+    void processFrame();
+};
+
+#endif
@@ -0,0 +1,121 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+
+/*
+ * Feeds known samples through the host stand-in of the AnalogSampler
+ * (trigger() converts the simulated pin levels) and checks the round
+ * robin, the left alignment, the oversampled readings and the overrun
+ * count. Exits with 1 when a check fails.
+ */
+
+#include <stdio.h>
+#include "SimBoard.h"
+#include "AnalogSampler.h"
+
+static int failures = 0;
+
+/*
+ * Report a failed check.
+ */
+static void expect(const char * _what, long _actual, long _expected) {
+  if(_actual != _expected) {
+    printf("%s: %ld, expected %ld\n", _what, _actual, _expected);
+    ++failures;
+  }
+}
+
+int main() {
+  SimBoard board;
+  board.select();
+
+  AnalogSampler sampler;
+  byte first = sampler.attach(A0);
+  byte second = sampler.attach(A1);
+  expect("slot of an attached pin", sampler.attach(A0), first);
+  sampler.begin(DEFAULT);
+
+  // Round robin: the conversions alternate between the slots
+  static const int levels[] = { 0, 1, 512, 1000, 1023 };
+  for(byte i=0; i<sizeof(levels) / sizeof(levels[0]); ++i) {
+    board.setAnalog(A0, levels[i]);
+    board.setAnalog(A1, 1023 - levels[i]);
+    sampler.trigger();
+    sampler.trigger();
+  }
+  for(byte i=0; i<sizeof(levels) / sizeof(levels[0]); ++i) {
+    uint16_t value = 0;
+    expect("sample available", sampler.read(first, value), true);
+    expect("first slot", value, (long)levels[i] << ADC_RAW_SHIFT);
+    expect("sample available", sampler.read(second, value), true);
+    expect("second slot", value, (long)(1023 - levels[i]) << ADC_RAW_SHIFT);
+  }
+  uint16_t value = 0;
+  expect("drained", sampler.read(first, value), false);
+  expect("latest", sampler.latest(first), 1023L << ADC_RAW_SHIFT);
+  expect("overruns", sampler.getOverruns(), 0);
+
+  // Oversampled and decimated readings are left aligned as well, the
+  // largest sum (64 x 1023) must not overflow
+  for(byte bits=0; bits<=3; ++bits) {
+    for(byte i=0; i<sizeof(levels) / sizeof(levels[0]); ++i) {
+      board.setAnalog(A1, levels[i]);
+      expect("acquire", sampler.acquire(second, bits), (long)levels[i] << ADC_RAW_SHIFT);
+    }
+  }
+  expect("acquire leaves the buffers alone", sampler.read(second, value), false);
+
+  // A reader that doesn't keep up loses the samples beyond the buffer,
+  // the oldest ones are kept
+  board.setAnalog(A0, 100);
+  for(int i=0; i<2 * (ADC_BUFFER_SIZE + 3); ++i) {
+    sampler.trigger();
+  }
+  expect("overruns", sampler.getOverruns(), 2 * 3);
+  int count = 0;
+  while(sampler.read(first, value)) {
+    expect("buffered sample", value, 100L << ADC_RAW_SHIFT);
+    ++count;
+  }
+  expect("buffered samples", count, ADC_BUFFER_SIZE);
+  sampler.discard(second);
+
+  // A watched slot raises an event on a large enough step only
+  sampler.watch(first, 10 << ADC_RAW_SHIFT);
+  board.setAnalog(A0, 105);
+  sampler.trigger();
+  sampler.trigger();
+  expect("small step", sampler.takeEvents(), 0);
+  board.setAnalog(A0, 200);
+  sampler.trigger();
+  sampler.trigger();
+  expect("large step", sampler.takeEvents(), 1 << first);
+  expect("events cleared", sampler.takeEvents(), 0);
+
+  printf("analog sampler: %d failures\n", failures);
+  return failures == 0 ? 0 : 1;
+}
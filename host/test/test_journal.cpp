@@ -0,0 +1,203 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+
+/*
+ * Checks Journal::load() on the EEPROM image of the simulated board: the
+ * newest record after the ring wrapped, the walk back over torn writes
+ * and the migration of the parameters from the previous version (slots
+ * of another size over the same region). Exits with 1 when a check
+ * fails.
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include "SimBoard.h"
+#include "Journal.h"
+#include "Thermostat.h"
+
+typedef struct test_record {
+  uint16_t value;
+  uint16_t check;
+} test_record_t;
+
+// A small journal at the start of the EEPROM (11 slots of 11 bytes)
+#define TEST_START   0
+#define TEST_SIZE    128
+#define TEST_VERSION 1
+#define TEST_SLOT    (sizeof(uint32_t) + 1 + sizeof(test_record_t) + sizeof(uint16_t))
+#define TEST_SLOTS   (TEST_SIZE / TEST_SLOT)
+
+static int failures = 0;
+
+/*
+ * Report a failed check.
+ */
+static void expect(const char * _what, long _actual, long _expected) {
+  if(_actual != _expected) {
+    printf("%s: %ld, expected %ld\n", _what, _actual, _expected);
+    ++failures;
+  }
+}
+
+/*
+ * Commit records _first to _last (inclusive).
+ */
+static void commitRange(Journal & _journal, uint16_t _first, uint16_t _last) {
+  for(uint16_t i=_first; i<=_last; ++i) {
+    test_record_t record = {i, (uint16_t)~i};
+    _journal.commit(&record);
+  }
+}
+
+/*
+ * Load the newest record with a fresh journal (as after a reset), returns
+ * its value or -1.
+ */
+static long loadValue(unsigned long & _commits) {
+  Journal journal(TEST_START, TEST_SIZE, sizeof(test_record_t), TEST_VERSION);
+  test_record_t record;
+  if(!journal.load(&record)) {
+    return -1;
+  }
+  _commits = journal.getCommits();
+  expect("record intact", record.check, (uint16_t)~record.value);
+  return record.value;
+}
+
+/*
+ * Damage one byte of the record in a slot, as a write that was cut off.
+ */
+static void tear(SimBoard & _board, byte _slot) {
+  int address = TEST_START + _slot * TEST_SLOT + sizeof(uint32_t) + 1;
+  _board.writeEeprom(address, ~_board.readEeprom(address));
+}
+
+/*
+ * The ring and the walk back.
+ */
+static void testJournal() {
+  SimBoard board;
+  board.select();
+  unsigned long commits = 0;
+
+  expect("erased", loadValue(commits), -1);
+
+  // Less than a round, then several rounds
+  Journal journal(TEST_START, TEST_SIZE, sizeof(test_record_t), TEST_VERSION);
+  commitRange(journal, 1, 5);
+  expect("newest", loadValue(commits), 5);
+  expect("commits", commits, 5);
+  commitRange(journal, 6, 3 * TEST_SLOTS + 3);
+  expect("newest after the wrap", loadValue(commits), 3 * TEST_SLOTS + 3);
+  expect("commits after the wrap", commits, 3 * TEST_SLOTS + 3);
+
+  // A torn last write (slot of the last commit, counting from 0) falls
+  // back to the one before, two torn writes to the one before that
+  byte last = (3 * TEST_SLOTS + 3 - 1) % TEST_SLOTS;
+  tear(board, last);
+  expect("torn write", loadValue(commits), 3 * TEST_SLOTS + 2);
+  expect("commits of the record before", commits, 3 * TEST_SLOTS + 2);
+  tear(board, last - 1);
+  expect("two torn writes", loadValue(commits), 3 * TEST_SLOTS + 1);
+
+  // The next commit goes after the record that was loaded, over the torn
+  // slots, and wins
+  Journal reloaded(TEST_START, TEST_SIZE, sizeof(test_record_t), TEST_VERSION);
+  test_record_t record;
+  reloaded.load(&record);
+  commitRange(reloaded, 100, 100);
+  expect("commit after a torn write", loadValue(commits), 100);
+  expect("commits after a torn write", commits, 3 * TEST_SLOTS + 2);
+
+  // With the newest record in the first slot the walk back continues at
+  // the end of the region
+  SimBoard fresh;
+  fresh.select();
+  Journal ring(TEST_START, TEST_SIZE, sizeof(test_record_t), TEST_VERSION);
+  commitRange(ring, 1, TEST_SLOTS + 1);
+  tear(fresh, 0);
+  expect("walk back across the end", loadValue(commits), TEST_SLOTS);
+}
+
+/*
+ * Parameters of the previous version are picked up by the Thermostat and
+ * saved in the current version.
+ */
+static void testMigration() {
+  SimBoard board;
+  board.select();
+
+  // More records than slots, so the ring of the old version wrapped
+  Journal previous(EEPROM_JOURNAL_ADDR, EEPROM_JOURNAL_SIZE, offsetof(parameter_record_t, tuning),
+                   PREVIOUS_PARAMETER_VERSION);
+  parameter_record_t record;
+  memset(&record, 0, sizeof(record));
+  record.maximumHeatTime = 3600000UL;
+  record.graceTime = 60000UL;
+  record.offsetTemperature = -100;
+  record.hysteresis = 300;
+  record.maximumTemperature = 9000;
+  record.minimumTemperature = 500;
+  record.serialMode = TELEMETRY_OFF;
+  record.oversampling = 2;
+  for(int i=0; i<60; ++i) {
+    record.requestedTemperature = 4000 + 10 * i;
+    previous.commit(&record);
+  }
+
+  AnalogSampler sampler;
+  Telemetry telemetry(&Serial);
+  Thermostat thermostat(&sampler, &telemetry, A0, 2);
+  thermostat.begin();
+  expect("migrated setpoint", thermostat.getRequestedTemperature().raw(), 4590);
+  expect("migrated hysteresis", thermostat.getHysteresis().raw(), 300);
+  expect("migrated offset", thermostat.getOffsetTemperature().raw(), -100);
+  expect("migrated max. heat time", thermostat.getMaxHeatTime(), 3600000L);
+  expect("migrated oversampling", thermostat.getOversampling(), 2);
+  expect("default control mode", thermostat.getControlMode(), DEFAULT_CONTROL_MODE);
+  expect("default gain", thermostat.getPidGain(), DEFAULT_PID_GAIN);
+
+  // Saved in the current version right away
+  Journal current(EEPROM_JOURNAL_ADDR, EEPROM_JOURNAL_SIZE, sizeof(parameter_record_t), PARAMETER_VERSION);
+  parameter_record_t saved;
+  expect("saved in the current version", current.load(&saved), true);
+  expect("saved setpoint", saved.requestedTemperature, 4590);
+  expect("saved control mode", saved.controlMode, DEFAULT_CONTROL_MODE);
+
+  // And loaded from there after the next reset
+  Thermostat restarted(&sampler, &telemetry, A0, 2);
+  restarted.begin();
+  expect("setpoint after a reset", restarted.getRequestedTemperature().raw(), 4590);
+}
+
+int main() {
+  testJournal();
+  testMigration();
+  printf("journal: %d failures\n", failures);
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,208 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+
+/*
+ * Encodes frames with the Telemetry of the sketch on the simulated board
+ * (status, anticipator and accounting reports, as the units send them)
+ * and decodes them with the TelemetryDecoder of the host tools: the
+ * payload layouts, the COBS framing and the CRC, a corrupted byte and
+ * frames split over feed() calls. Exits with 1 when a check fails.
+ */
+
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "SimBoard.h"
+#include "Thermostat.h"
+#include "Accounting.h"
+#include "Functions.h"
+#include "TelemetryDecoder.h"
+
+typedef struct test_frame {
+  uint8_t type;
+  std::vector<uint8_t> payload;
+} test_frame_t;
+
+static int failures = 0;
+
+/*
+ * Report a failed check.
+ */
+static void expect(const char * _what, long _actual, long _expected) {
+  if(_actual != _expected) {
+    printf("%s: %ld, expected %ld\n", _what, _actual, _expected);
+    ++failures;
+  }
+}
+
+/*
+ * Move what the Telemetry buffered to the (simulated) UART.
+ */
+static void drain(SimBoard & _board, Telemetry & _telemetry) {
+  for(int i=0; i<200; ++i) {
+    _telemetry.drain();
+    _board.advance(1000);
+  }
+}
+
+/*
+ * Decode a stream in chunks of _chunk bytes.
+ */
+static std::vector<test_frame_t> decode(const std::string & _stream, size_t _chunk,
+                                        TelemetryDecoder * & _decoder) {
+  std::vector<test_frame_t> frames;
+  _decoder = new TelemetryDecoder([&frames](uint8_t _type, const uint8_t * _payload, size_t _length) {
+    test_frame_t frame;
+    frame.type = _type;
+    frame.payload.assign(_payload, _payload + _length);
+    frames.push_back(frame);
+  });
+  const uint8_t * data = (const uint8_t *)_stream.data();
+  for(size_t i=0; i<_stream.size(); i+=_chunk) {
+    _decoder->feed(data + i, std::min(_chunk, _stream.size() - i));
+  }
+  return frames;
+}
+
+int main() {
+  // Both ends use CRC-16/CCITT-FALSE (check value of "123456789": 0x29B1)
+  uint16_t sketchCrc = 0xFFFF, hostCrc = 0xFFFF;
+  for(const char * p = "123456789"; *p != '\0'; ++p) {
+    sketchCrc = crc16Update(sketchCrc, *p);
+    hostCrc = TelemetryDecoder::crc16Update(hostCrc, *p);
+  }
+  expect("crc of the sketch", sketchCrc, 0x29B1);
+  expect("crc of the decoder", hostCrc, 0x29B1);
+
+  SimBoard board;
+  board.select();
+  AnalogSampler sampler;
+  Telemetry telemetry(&Serial);
+  Thermostat thermostat(&sampler, &telemetry, THERMISTOR_PIN, ENABLE_PIN);
+  Accounting accounting(&telemetry);
+  sampler.begin(DEFAULT);
+  thermostat.begin();
+  accounting.begin();
+  thermostat.setSerialMode(TELEMETRY_BINARY);
+  accounting.setBurnerPower(24500);
+
+  // A temperature to report, and some burner time
+  board.setAnalog(THERMISTOR_PIN, 515);
+  for(int i=0; i<100; ++i) {
+    sampler.trigger();
+  }
+  thermostat.sample(1000);
+  accounting.update(1000, true, false, ALARM_NONE);
+  accounting.update(3601000, false, false, ALARM_NONE);
+  board.takeSerialOutput();
+
+  thermostat.report(123456789UL, 734);
+  drain(board, telemetry);
+  accounting.report(3601000);
+  drain(board, telemetry);
+  std::string stream = board.takeSerialOutput();
+
+  TelemetryDecoder * decoder;
+  std::vector<test_frame_t> frames = decode(stream, stream.size(), decoder);
+  expect("frames", frames.size(), 4);
+  expect("crc errors", decoder->getCrcErrors(), 0);
+  expect("framing errors", decoder->getFramingErrors(), 0);
+  delete decoder;
+  if(frames.size() != 4) {
+    printf("telemetry: %d failures\n", failures);
+    return 1;
+  }
+
+  // Status
+  status_record_t status;
+  expect("status frame", frames[0].type, TELEMETRY_FRAME_STATUS);
+  expect("status decoded", TelemetryDecoder::decodeStatus(frames[0].payload.data(),
+                                                          frames[0].payload.size(), status), true);
+  expect("status time", status.time, 123456789L);
+  expect("status temperature", status.temperature, thermostat.getTemperature().raw());
+  expect("status requested", status.requestedTemperature, thermostat.getRequestedTemperature().raw());
+  expect("status hysteresis", status.hysteresis, thermostat.getHysteresis().raw());
+  expect("status alarm", status.alarmCause, thermostat.getAlarmCause());
+  expect("status duty cycle", status.dutyCycle, 734);
+  expect("status drops", status.drops, 0);
+
+  // Anticipator
+  anticipator_report_t anticipator;
+  expect("anticipator frame", frames[1].type, TELEMETRY_FRAME_ANTICIPATOR);
+  expect("anticipator decoded", TelemetryDecoder::decodeAnticipator(frames[1].payload.data(),
+                                                                    frames[1].payload.size(), anticipator), true);
+  expect("anticipator time", anticipator.time, 123456789L);
+  expect("anticipator cycles", anticipator.cycles, thermostat.getAnticipator()->getCycles());
+  expect("anticipator slope", anticipator.slope, thermostat.getAnticipator()->getSlope());
+
+  // Accounting, lifetime and trip
+  const accounting_counters_t * sets[2] = {accounting.getLifetime(), accounting.getTrip()};
+  for(int i=0; i<2; ++i) {
+    accounting_report_t report;
+    expect("accounting frame", frames[2 + i].type, TELEMETRY_FRAME_ACCOUNTING);
+    expect("accounting decoded", TelemetryDecoder::decodeAccounting(frames[2 + i].payload.data(),
+                                                                    frames[2 + i].payload.size(), report), true);
+    expect("accounting time", report.time, 3601000L);
+    expect("accounting set", report.set, i == 0 ? ACCOUNTING_LIFETIME : ACCOUNTING_TRIP);
+    expect("accounting heat", report.heatSeconds, sets[i]->heatSeconds);
+    expect("accounting energy", report.energy, sets[i]->energy);
+    expect("accounting cycles", report.cycles, sets[i]->cycles);
+    expect("accounting burner power", report.burnerPower, 24500);
+  }
+  expect("burner time reported", frames[2].payload.size() > 0 && sets[0]->heatSeconds > 0, true);
+
+  // Split anywhere: the same frames, byte by byte and in odd chunks
+  for(size_t chunk=1; chunk<=7; chunk+=3) {
+    std::vector<test_frame_t> split = decode(stream, chunk, decoder);
+    expect("frames of a split stream", split.size(), frames.size());
+    for(size_t i=0; i<split.size() && i<frames.size(); ++i) {
+      expect("payload of a split frame", split[i].payload == frames[i].payload, true);
+    }
+    delete decoder;
+  }
+
+  // A corrupted byte in the first frame loses that frame only
+  std::string corrupted = stream;
+  size_t position = 5;
+  corrupted[position] = corrupted[position] == 0x55 ? 0x56 : 0x55;
+  std::vector<test_frame_t> rest = decode(corrupted, 3, decoder);
+  expect("frames after a corrupted byte", rest.size(), frames.size() - 1);
+  expect("errors of a corrupted byte", decoder->getCrcErrors() + decoder->getFramingErrors(), 1);
+  expect("frame after the corrupted one", rest.size() > 0 && rest[0].type == TELEMETRY_FRAME_ANTICIPATOR, true);
+  delete decoder;
+
+  // A frame cut off by the start of the next one (the delimiter was lost)
+  std::string cut = stream.substr(0, 10) + stream.substr(stream.find('\0') + 1);
+  rest = decode(cut, 4, decoder);
+  expect("frames after a cut off frame", rest.size(), frames.size() - 2);
+  delete decoder;
+
+  printf("telemetry: %d failures\n", failures);
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+
+/*
+ * Checks the compile time temperature table (TemperatureTable.h) against
+ * the run time interpolation it replaced, for every ADC value. Exits
+ * with 1 on the first mismatches (all of them are listed).
+ */
+
+#include <stdio.h>
+#include "TemperatureTable.h"
+
+static const long calX[CALIBRATION_SET_SIZE] = CALIBRATION_RAW;
+static const long calY[CALIBRATION_SET_SIZE] = CALIBRATION_TEMPERATURE;
+
+/*
+ * The original interpolation (Thermostat::interpolateTemperature before
+ * the table), _value is the ADC value multiplied by 100.
+ */
+static long interpolateTemperature(long _value) {
+  // Determine reference frame (when going out of bounds, take the closest)
+  int i0 = 0;
+  if(_value >= calX[0]) {
+    for(int i=CALIBRATION_SET_SIZE - 2; i>=0; --i) {
+      if(_value >= calX[i]) {
+        i0 = i;
+        break;
+      }
+    }
+  }
+
+  // Interpolate.
+  int i1 = i0 + 1;
+  long xPart = (_value - calX[i0]) * 1000L / (calX[i1] - calX[i0]);
+  long tmp = calY[i0] * (1000L - xPart) + calY[i1] * xPart;
+  return tmp / 1000L;
+}
+
+/*
+ * The table clips to the range of Centidegrees.
+ */
+static long clip(long _value) {
+  return Centidegrees::saturate(_value).raw();
+}
+
+int main() {
+  int failures = 0;
+
+  for(long code=0; code<1024; ++code) {
+    long table = lookupTemperature(code << ADC_RAW_SHIFT).raw();
+    if(THERMISTOR_CURVE == CURVE_LINEAR) {
+      long expected = clip(interpolateTemperature(code * 100L));
+      if(table != expected) {
+        printf("ADC %ld: table %ld, interpolation %ld\n", code, table, expected);
+        ++failures;
+      }
+    }
+  }
+
+  // The polynomial only has to stay close to the calibration points
+  for(int i=0; i<CALIBRATION_SET_SIZE; ++i) {
+    long table = lookupTemperature((calX[i] / 100L) << ADC_RAW_SHIFT).raw();
+    long difference = table > calY[i] ? table - calY[i] : calY[i] - table;
+    if(difference > (THERMISTOR_CURVE == CURVE_POLYNOMIAL ? CALIBRATION_TOLERANCE : 0)) {
+      printf("calibration point %d: table %ld, expected %ld\n", i, table, calY[i]);
+      ++failures;
+    }
+  }
+
+  printf("temperature table: %d failures\n", failures);
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,239 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+
+#include "Accounting.h"
+#include "Functions.h"
+
+/*
+ * Constructor
+ */
+Accounting::Accounting(Telemetry * _telemetry)
+  : journal(EEPROM_ACCOUNTING_ADDR, EEPROM_ACCOUNTING_SIZE, sizeof(accounting_record_t), ACCOUNTING_VERSION) {
+  telemetry = _telemetry;
+
+  // The stored counters are loaded by begin()
+  memset(&record, 0, sizeof(record));
+  record.burnerPower = DEFAULT_BURNER_POWER;
+  dirty = false;
+  generation = 0;
+
+  started = false;
+  burning = false;
+  graceBlocked = false;
+  alarmCause = ALARM_NONE;
+  lastUpdate = 0;
+  lastFlush = 0;
+  lastReport = 0;
+  heatMillis = 0;
+  energyRemainder = 0;
+}
+
+/*
+ * Load the counters from EEPROM (called from setup()).
+ */
+void Accounting::begin() {
+  journal.load(&record);
+  ++generation;
+}
+
+/*
+ * Integrate the state of the relay since the last call and count the
+ * events (called by the control task). _graceBlocked is set while the
+ * thermostat wants heat but waits for the grace period to end.
+ */
+void Accounting::update(unsigned long _millis, bool _burning, bool _graceBlocked, byte _alarmCause) {
+  if(!started) {
+    started = true;
+    lastUpdate = _millis;
+    lastFlush = _millis;
+  }
+
+  // Heat time (and energy) for the interval that just ended
+  if(burning) {
+    heatMillis += diffUL(lastUpdate, _millis);
+    while(heatMillis >= 1000) {
+      heatMillis -= 1000;
+      countHeatSecond();
+    }
+  }
+  lastUpdate = _millis;
+
+  // Events
+  if(_burning && !burning) {
+    ++record.lifetime.cycles;
+    ++record.trip.cycles;
+    dirty = true;
+    ++generation;
+  }
+  if(_graceBlocked && !graceBlocked) {
+    ++record.lifetime.graceBlocks;
+    ++record.trip.graceBlocks;
+    dirty = true;
+    ++generation;
+  }
+  bool newAlarm = _alarmCause != alarmCause && _alarmCause != ALARM_NONE
+                  && _alarmCause <= ACCOUNTING_ALARM_CAUSES;
+  if(newAlarm) {
+    ++record.lifetime.alarms[_alarmCause - 1];
+    ++record.trip.alarms[_alarmCause - 1];
+    dirty = true;
+    ++generation;
+  }
+  burning = _burning;
+  graceBlocked = _graceBlocked;
+  alarmCause = _alarmCause;
+
+  // Store the counters once in a while, or when an alarm went off
+  if(dirty && (newAlarm || diffUL(lastFlush, _millis) >= ACCOUNTING_FLUSH_INTERVAL)) {
+    flush();
+    lastFlush = _millis;
+  }
+}
+
+/*
+ * Add a second of heat time and the energy burnt in it.
+ */
+void Accounting::countHeatSecond() {
+  ++record.lifetime.heatSeconds;
+  ++record.trip.heatSeconds;
+
+  // Watt seconds, carried over until there's a Wh
+  energyRemainder += record.burnerPower;
+  while(energyRemainder >= 3600) {
+    energyRemainder -= 3600;
+    ++record.lifetime.energy;
+    ++record.trip.energy;
+  }
+  dirty = true;
+  ++generation;
+}
+
+/*
+ * Report both sets of counters, at most every ACCOUNTING_REPORT_PERIOD ms.
+ * (called by the telemetry task in binary mode).
+ */
+void Accounting::report(unsigned long _millis) {
+  if(lastReport != 0 && diffUL(lastReport, _millis) < ACCOUNTING_REPORT_PERIOD) {
+    return;
+  }
+  lastReport = _millis;
+  reportCounters(_millis, ACCOUNTING_LIFETIME, &record.lifetime);
+  reportCounters(_millis, ACCOUNTING_TRIP, &record.trip);
+}
+
+/*
+ * Report a set of counters as a binary frame (see Accounting.h)
+ */
+void Accounting::reportCounters(unsigned long _millis, byte _set, const accounting_counters_t * _counters) {
+  telemetry->beginFrame(TELEMETRY_FRAME_ACCOUNTING);
+  telemetry->put32(_millis);
+  telemetry->put8(_set);
+  telemetry->put32(_counters->heatSeconds);
+  telemetry->put32(_counters->energy);
+  telemetry->put32(_counters->cycles);
+  telemetry->put32(_counters->graceBlocks);
+  for(byte i=0; i<ACCOUNTING_ALARM_CAUSES; ++i) {
+    telemetry->put16(_counters->alarms[i]);
+  }
+  telemetry->put16(record.burnerPower);
+  telemetry->endFrame();
+}
+
+/*
+ * Store changed counters right away (e.g. before a reset).
+ */
+void Accounting::flush() {
+  if(dirty) {
+    journal.commit(&record);
+    dirty = false;
+  }
+}
+
+/*
+ * Clear the trip counters, stored right away.
+ */
+void Accounting::resetTrip() {
+  memset(&record.trip, 0, sizeof(record.trip));
+  dirty = true;
+  ++generation;
+  flush();
+}
+
+/*
+ * Lifetime counters
+ */
+const accounting_counters_t * Accounting::getLifetime() {
+  return &record.lifetime;
+}
+
+/*
+ * Trip counters (since the last resetTrip())
+ */
+const accounting_counters_t * Accounting::getTrip() {
+  return &record.trip;
+}
+
+/*
+ * Total number of alarms in a set of counters
+ */
+unsigned int Accounting::getAlarms(const accounting_counters_t * _counters) {
+  unsigned int total = 0;
+  for(byte i=0; i<ACCOUNTING_ALARM_CAUSES; ++i) {
+    total += _counters->alarms[i];
+  }
+  return total;
+}
+
+/*
+ * Retrieve the burner power (W) used for the energy estimate
+ */
+unsigned int Accounting::getBurnerPower() {
+  return record.burnerPower;
+}
+
+/*
+ * Change the burner power (W), stored right away. The energy counted so
+ * far is kept.
+ */
+void Accounting::setBurnerPower(unsigned int _value) {
+  if(_value == record.burnerPower) {
+    return;
+  }
+  record.burnerPower = _value;
+  dirty = true;
+  ++generation;
+  flush();
+}
+
+/*
+ * Generation counter: changes whenever one of the counters (or the
+ * burner power) changes.
+ */
+byte Accounting::getGeneration() {
+  return generation;
+}
@@ -0,0 +1,116 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+
+#ifndef _ACCOUNTING_H_
+#define _ACCOUNTING_H_
+
+#include <Arduino.h>
+#include "MagicNumbers.h"
+#include "Telemetry.h"
+#include "Journal.h"
+
+/*
+ * Keeps track of how the burner is used: the time the relay was closed,
+ * the estimated energy (relay time at the configured burner power), the
+ * number of heat cycles, the number of times the thermostat wanted heat
+ * but was held back by the grace period, and the alarms per cause.
+ *
+ * There are two sets of counters: the lifetime counters, which are never
+ * cleared, and the trip counters, which can be reset from the menu. Both
+ * are kept in RAM and stored in a journal of their own (see Journal.h),
+ * at most every ACCOUNTING_FLUSH_INTERVAL ms., right away when an alarm
+ * goes off (the alarm may end in a power cycle) and before a reset. A
+ * power failure loses at most the heat time since the last flush.
+ *
+ * In binary mode the counters are reported every ACCOUNTING_REPORT_PERIOD
+ * ms. as two TELEMETRY_FRAME_ACCOUNTING frames (lifetime and trip) with
+ * the fields, little endian:
+ *   uint32 time (ms.), uint8 set (ACCOUNTING_LIFETIME or ACCOUNTING_TRIP),
+ *   uint32 heat time (s.), uint32 energy (Wh), uint32 heat cycles,
+ *   uint32 grace period blocks, uint16 alarms per cause (ALARM_MIN_-
+ *   TEMPERATURE, ALARM_MAX_TEMPERATURE, ALARM_MAX_HEAT_TIME),
+ *   uint16 burner power (W)
+ */
+typedef struct accounting_counters {
+  uint32_t heatSeconds;
+  uint32_t energy;
+  uint32_t cycles;
+  uint32_t graceBlocks;
+  uint16_t alarms[ACCOUNTING_ALARM_CAUSES];
+} accounting_counters_t;
+
+/*
+ * The counters as stored in the journal (fixed widths, no padding).
+ */
+typedef struct accounting_record {
+  accounting_counters_t lifetime;
+  accounting_counters_t trip;
+  uint16_t burnerPower;
+} accounting_record_t;
+
+class Accounting {
+  public:
+    Accounting(Telemetry * _telemetry);
+    void begin();
+    void update(unsigned long _millis, bool _burning, bool _graceBlocked, byte _alarmCause);
+    void report(unsigned long _millis);
+    void flush();
+    void resetTrip();
+
+    const accounting_counters_t * getLifetime();
+    const accounting_counters_t * getTrip();
+    unsigned int getAlarms(const accounting_counters_t * _counters);
+    unsigned int getBurnerPower();
+    void setBurnerPower(unsigned int _value);
+
+    // Generation counter, incremented when the counters change
+    byte getGeneration();
+
+  private:
+    Telemetry * telemetry;
+    Journal journal;
+    accounting_record_t record;
+    bool dirty;
+    byte generation;
+
+    // the state
+    bool started;
+    bool burning;
+    bool graceBlocked;
+    byte alarmCause;
+    unsigned long lastUpdate;
+    unsigned long lastFlush;
+    unsigned long lastReport;
+    unsigned long heatMillis;
+    unsigned long energyRemainder;
+
+    void countHeatSecond();
+    void reportCounters(unsigned long _millis, byte _set, const accounting_counters_t * _counters);
+};
+
+#endif
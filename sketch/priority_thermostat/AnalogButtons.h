@@ -30,41 +30,116 @@
 
 #include <Arduino.h>
 #include "MagicNumbers.h"
+#include "AnalogSampler.h"
+#include "RingBuffer.h"
+#include "Functions.h"
+
+/*
+ * Buttons on a single analog line (a resistor ladder), one at a time.
+ *
+ * The line is decoded in the conversion interrupt of the sampler, so a
+ * press doesn't depend on how often the main loop polls. Every button
+ * has a debounce counter that moves one step towards each sample (up
+ * when the line is within the tolerance of the button, down otherwise):
+ * the button goes down when the counter reaches BUTTON_DEBOUNCE_SAMPLES
+ * and up again when it's back at 0. This yields timestamped events in a
+ * lock-free queue:
+ *
+ *   BUTTON_EVENT_PRESS      the button went down
+ *   BUTTON_EVENT_LONGPRESS  held down for LONGPRESS_TIME ms.
+ *   BUTTON_EVENT_RELEASE    the button went up
+ *   BUTTON_EVENT_REPEAT     still held (buttons set to repeat only)
+ *
+ * A button that repeats posts its first repeat BUTTON_REPEAT_DELAY ms.
+ * after the press, then they speed up in stages: every
+ * BUTTON_REPEAT_STAGE repeats the next period of BUTTON_REPEAT_PERIODS
+ * applies. The stage comes with the event, so the reader can take bigger
+ * steps as well.
+ *
+ * sample() takes one event from the queue, it's then seen through
+ * getPressed(), isShortPress(), isLongPress() and isRepeat() until the
+ * next call. When the queue is full, new events are dropped.
+ */
+typedef struct button_event {
+  unsigned long timestamp;
+  byte button;
+  byte type;
+  byte stage;
+} button_event_t;
 
 template<size_t N>
 class AnalogButtons {
+  static_assert(N <= 8, "At most 8 buttons on a line");
+
   public:
-    AnalogButtons(byte _pin, byte _tolerance);
+    AnalogButtons(AnalogSampler * _sampler, byte _pin, byte _tolerance);
     void set(byte _index, int _analogValue);
+    void setRepeat(byte _index, bool _repeat);
+    void begin();
     void sample();
     void sample(unsigned long _millis);
+    bool pending();
     byte getPressed();
     bool isShortPress();
     bool isLongPress();
+    bool isRepeat();
+    byte getRepeatStage();
     bool recentlyActive();
 
   private:
+    AnalogSampler * sampler;
     byte pin;
+    byte channel;
     byte tolerance;
     int lowValues[N];
     int highValues[N];
     byte lastPressedButton;
     bool shortPress;
     bool longPress;
-    unsigned long downTimestamp;
+    bool repeat;
+    byte repeatStage;
     unsigned long lastActivity;
+
+    // the decoder (interrupt side)
+    byte counts[N];
+    unsigned long downTimestamps[N];
+    unsigned long repeatTimestamps[N];
+    byte repeats[N];
+    byte down;
+    byte held;
+    byte repeating;
+    RingBuffer<button_event_t, BUTTON_QUEUE_SIZE> events;
+
+    static void onSample(void * _context, uint16_t _value);
+    void decode(uint16_t _value);
+    void post(byte _button, byte _type, unsigned long _timestamp, byte _stage = 0);
 };
 
 /*
  * Constructor, N defines the number of buttons on the analog pin.
  */
 template<size_t N>
-AnalogButtons<N>::AnalogButtons(byte _pin, byte _tolerance) {
+AnalogButtons<N>::AnalogButtons(AnalogSampler * _sampler, byte _pin, byte _tolerance) {
+  sampler = _sampler;
   pin = _pin;
+  channel = sampler->attach(pin);
   tolerance = _tolerance;
-  lastPressedButton = -1;
+  lastPressedButton = BUTTON_NONE;
   shortPress = false;
   longPress = false;
+  repeat = false;
+  repeatStage = 0;
+  lastActivity = 0;
+
+  for(byte i=0; i<N; ++i) {
+    counts[i] = 0;
+    downTimestamps[i] = 0;
+    repeatTimestamps[i] = 0;
+    repeats[i] = 0;
+  }
+  down = 0;
+  held = 0;
+  repeating = 0;
 }
 
 /*
@@ -77,7 +152,29 @@ void AnalogButtons<N>::set(byte _index, int _analogValue) {
 }
 
 /*
- * Sample the analog line and millis
+ * Have a button repeat while it's held (e.g. to step through values).
+ */
+template<size_t N>
+void AnalogButtons<N>::setRepeat(byte _index, bool _repeat) {
+  noInterrupts();
+  if(_repeat) {
+    repeating |= 1 << _index;
+  } else {
+    repeating &= ~(1 << _index);
+  }
+  interrupts();
+}
+
+/*
+ * Start decoding the line (once all buttons are set).
+ */
+template<size_t N>
+void AnalogButtons<N>::begin() {
+  sampler->listen(channel, onSample, this);
+}
+
+/*
+ * Take the next event and millis
  */
 template<size_t N>
 void AnalogButtons<N>::sample() {
@@ -85,46 +182,40 @@ void AnalogButtons<N>::sample() {
 }
 
 /*
- * Sample the analog line and determine the pressed button.
+ * Take the next event from the queue, if any.
  */
 template<size_t N>
 void AnalogButtons<N>::sample(unsigned long _millis) {
-  int value = analogRead(pin);
-  delay(10);
-
-  bool pressed = false;
-  for(byte i=0; i<N; ++i) {
-    if(value >= lowValues[i] && value <= highValues[i]) {
-      // Detected short press
-      if(i != lastPressedButton) {
-        lastPressedButton = i;
-        shortPress = true;
-        downTimestamp = _millis;
-      } else {
-        shortPress = false;
-
-        // Detect long press
-        if(downTimestamp + LONGPRESS_TIME < _millis) {
-          longPress = true;
-        } else
-          longPress = false;
-      }
-
-      pressed = true;
-    } 
+  button_event_t event;
+  shortPress = false;
+  longPress = false;
+  repeat = false;
+  if(!events.pop(event)) {
+    return;
   }
-      
-  if(!pressed) {
-    shortPress = false;
-    longPress = false;
-    lastPressedButton = -1;
+
+  if(event.type == BUTTON_EVENT_RELEASE) {
+    lastPressedButton = BUTTON_NONE;
   } else {
-    lastActivity = _millis;
+    lastPressedButton = event.button;
+    shortPress = event.type == BUTTON_EVENT_PRESS;
+    longPress = event.type == BUTTON_EVENT_LONGPRESS;
+    repeat = event.type == BUTTON_EVENT_REPEAT;
+    repeatStage = event.stage;
   }
+  lastActivity = event.timestamp;
+}
+
+/*
+ * Check if there are events waiting to be taken.
+ */
+template<size_t N>
+bool AnalogButtons<N>::pending() {
+  return events.available() > 0;
 }
 
 /*
- * Return the last pressed button
+ * Return the button of the current event (BUTTON_NONE once released)
  */
 template<size_t N>
 byte AnalogButtons<N>::getPressed() {
@@ -132,7 +223,7 @@ byte AnalogButtons<N>::getPressed() {
 }
 
 /*
- * Returns true if sample() detected a short press
+ * Returns true if the current event is a press
  */
 template<size_t N>
 bool AnalogButtons<N>::isShortPress() {
@@ -140,13 +231,29 @@ bool AnalogButtons<N>::isShortPress() {
 }
 
 /*
- * Returns true if sample() detected a long press
+ * Returns true if the current event is a long press
  */
 template<size_t N>
 bool AnalogButtons<N>::isLongPress() {
   return longPress;
 }
 
+/*
+ * Returns true if the current event is a repeat
+ */
+template<size_t N>
+bool AnalogButtons<N>::isRepeat() {
+  return repeat;
+}
+
+/*
+ * Stage of the current repeat (0 for the slowest)
+ */
+template<size_t N>
+byte AnalogButtons<N>::getRepeatStage() {
+  return repeatStage;
+}
+
 /*
  * Check if there was any recent activity
  * note: duplicated code (see diffUL in Thermostat.cpp
@@ -162,5 +269,78 @@ bool AnalogButtons<N>::recentlyActive() {
   }
 }
 
-#endif
+/*
+ * Sample listener, runs in the conversion interrupt.
+ */
+template<size_t N>
+void AnalogButtons<N>::onSample(void * _context, uint16_t _value) {
+  ((AnalogButtons<N> *)_context)->decode(_value);
+}
 
+/*
+ * Move the debounce counters by a sample of the line and post the
+ * events. The long press and the repeats are timed with diffUL, so they
+ * survive the wrap of millis(). A button is down until its counter drops
+ * back to 0, a stray sample while it's held doesn't press it again.
+ */
+template<size_t N>
+void AnalogButtons<N>::decode(uint16_t _value) {
+  static const unsigned int periods[] = BUTTON_REPEAT_PERIODS;
+  static_assert(sizeof(periods) / sizeof(periods[0]) == BUTTON_REPEAT_STAGES,
+                "One repeat period per stage");
+  int value = _value >> ADC_RAW_SHIFT;
+  unsigned long now = millis();
+
+  for(byte i=0; i<N; ++i) {
+    byte bit = 1 << i;
+    if(value >= lowValues[i] && value <= highValues[i]) {
+      if(counts[i] < BUTTON_DEBOUNCE_SAMPLES && ++counts[i] == BUTTON_DEBOUNCE_SAMPLES
+         && !(down & bit)) {
+        down |= bit;
+        held &= ~bit;
+        downTimestamps[i] = now;
+        repeatTimestamps[i] = now;
+        repeats[i] = 0;
+        post(i, BUTTON_EVENT_PRESS, now);
+      }
+    } else if(counts[i] > 0 && --counts[i] == 0 && (down & bit)) {
+      down &= ~bit;
+      post(i, BUTTON_EVENT_RELEASE, now);
+    }
+
+    if((down & bit) && !(held & bit) && diffUL(downTimestamps[i], now) >= LONGPRESS_TIME) {
+      held |= bit;
+      post(i, BUTTON_EVENT_LONGPRESS, now);
+    }
+
+    if((down & bit) && (repeating & bit)) {
+      byte stage = repeats[i] / BUTTON_REPEAT_STAGE;
+      if(stage >= BUTTON_REPEAT_STAGES) {
+        stage = BUTTON_REPEAT_STAGES - 1;
+      }
+      unsigned int wait = repeats[i] == 0 ? BUTTON_REPEAT_DELAY : periods[stage];
+      if(diffUL(repeatTimestamps[i], now) >= wait) {
+        repeatTimestamps[i] = now;
+        if(repeats[i] < 0xFF) {
+          ++repeats[i];
+        }
+        post(i, BUTTON_EVENT_REPEAT, now, stage);
+      }
+    }
+  }
+}
+
+/*
+ * Queue an event (interrupt side).
+ */
+template<size_t N>
+void AnalogButtons<N>::post(byte _button, byte _type, unsigned long _timestamp, byte _stage) {
+  button_event_t event;
+  event.timestamp = _timestamp;
+  event.button = _button;
+  event.type = _type;
+  event.stage = _stage;
+  events.push(event);
+}
+
+#endif
@@ -0,0 +1,281 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+#include "AnalogSampler.h"
+
+#ifdef __AVR__
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#endif
+
+AnalogSampler * AnalogSampler::active = NULL;
+
+/*
+ * Constructor
+ */
+AnalogSampler::AnalogSampler() {
+  channels = 0;
+  reference = DEFAULT;
+  current = 0;
+  overruns = 0;
+  events = 0;
+  burst = false;
+  converted = false;
+  burstValue = 0;
+}
+
+/*
+ * Register an analog pin, returns the slot to read it back from. All pins
+ * must be attached before begin() is called.
+ */
+byte AnalogSampler::attach(byte _pin) {
+  for(byte i=0; i<channels; ++i) {
+    if(pins[i] == _pin) {
+      return i;
+    }
+  }
+  pins[channels] = _pin;
+  latestValues[channels] = 0;
+  watchDelta[channels] = 0;
+  listeners[channels] = NULL;
+  listenerContexts[channels] = NULL;
+  return channels++;
+}
+
+/*
+ * Start sampling. _reference takes the same values as analogReference().
+ */
+void AnalogSampler::begin(byte _reference) {
+  reference = _reference;
+  current = 0;
+  active = this;
+
+#ifdef __AVR__
+  noInterrupts();
+  selectChannel(0);
+
+  // Timer1 in CTC mode, prescaler 64, compare match B at the end of
+  // every period triggers the conversion.
+  TCCR1A = 0;
+  TCCR1B = _BV(WGM12) | _BV(CS11) | _BV(CS10);
+  OCR1A = F_CPU / 64 / ADC_SAMPLE_RATE - 1;
+  OCR1B = OCR1A;
+  TCNT1 = 0;
+  TIFR1 = _BV(OCF1B);
+
+  // ADC clock at F_CPU / 128, auto trigger on timer1 compare match B.
+  ADCSRB = (ADCSRB & ~(_BV(ADTS2) | _BV(ADTS1) | _BV(ADTS0))) | _BV(ADTS2) | _BV(ADTS0);
+  ADCSRA = _BV(ADEN) | _BV(ADATE) | _BV(ADIE) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+  interrupts();
+#endif
+}
+
+/*
+ * Take the oldest unread sample of a slot. Returns false when all samples
+ * were consumed.
+ */
+bool AnalogSampler::read(byte _slot, uint16_t & _value) {
+  return buffers[_slot].pop(_value);
+}
+
+/*
+ * Drop all unread samples of a slot.
+ */
+void AnalogSampler::discard(byte _slot) {
+  buffers[_slot].clear();
+}
+
+/*
+ * Most recent sample of a slot, read or not.
+ */
+uint16_t AnalogSampler::latest(byte _slot) {
+  noInterrupts();
+  uint16_t value = latestValues[_slot];
+  interrupts();
+  return value;
+}
+
+/*
+ * Number of samples dropped because a reader didn't keep up.
+ */
+unsigned int AnalogSampler::getOverruns() {
+  noInterrupts();
+  unsigned int value = overruns;
+  interrupts();
+  return value;
+}
+
+/*
+ * Raise an event when a sample of the slot differs more than _delta from
+ * the previous one (0 stops watching).
+ */
+void AnalogSampler::watch(byte _slot, uint16_t _delta) {
+  watchDelta[_slot] = _delta;
+}
+
+/*
+ * Hand every sample of the slot to _listener (called from the interrupt)
+ * instead of buffering it, NULL goes back to buffering.
+ */
+void AnalogSampler::listen(byte _slot, sample_listener_t _listener, void * _context) {
+  noInterrupts();
+  listeners[_slot] = _listener;
+  listenerContexts[_slot] = _context;
+  interrupts();
+}
+
+/*
+ * Retrieve (and clear) the events, one bit per slot.
+ */
+byte AnalogSampler::takeEvents() {
+  noInterrupts();
+  byte value = events;
+  events = 0;
+  interrupts();
+  return value;
+}
+
+/*
+ * Take an oversampled reading of 4^_bits conversions (_bits at most 3),
+ * decimated to 10 + _bits bits and left aligned. Blocks for 4^_bits
+ * conversion times, idling.
+ */
+uint16_t AnalogSampler::acquire(byte _slot, byte _bits) {
+  unsigned int conversions = 1U << (2 * _bits);
+  uint16_t sum = 0;
+
+#ifdef __AVR__
+  // Pause the round robin and let a running conversion finish.
+  ADCSRA &= ~_BV(ADATE);
+  while(ADCSRA & (_BV(ADSC) | _BV(ADIF))) {}
+
+  noInterrupts();
+  burst = true;
+  selectChannel(_slot);
+  interrupts();
+
+  // Idle while converting, the conversion complete interrupt wakes us up
+  // again. Other interrupts may wake us up earlier, hence the loop. The
+  // ADC noise reduction mode would stop the clock of the UART and the
+  // timers (and lose serial data and time).
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  for(unsigned int i=0; i<conversions; ++i) {
+    converted = false;
+    ADCSRA |= _BV(ADSC);
+    sleep_enable();
+    while(!converted) {
+      sleep_cpu();
+    }
+    sleep_disable();
+    sum += burstValue;
+  }
+
+  // Resume the round robin. The compare match flag is cleared so the
+  // next timer event is seen as a rising edge.
+  noInterrupts();
+  burst = false;
+  selectChannel(current);
+  TIFR1 = _BV(OCF1B);
+  ADCSRA |= _BV(ADATE);
+  interrupts();
+#else
+  for(unsigned int i=0; i<conversions; ++i) {
+    sum += analogRead(pins[_slot]);
+  }
+#endif
+
+  return (sum >> _bits) << (ADC_RAW_SHIFT - _bits);
+}
+
+/*
+ * Store a finished conversion and move on to the next channel.
+ */
+void AnalogSampler::convert(uint16_t _value) {
+  if(burst) {
+    burstValue = _value;
+    converted = true;
+    return;
+  }
+
+  byte slot = current;
+  _value <<= ADC_RAW_SHIFT;
+  if(watchDelta[slot] > 0) {
+    uint16_t previous = latestValues[slot];
+    uint16_t delta = _value > previous ? _value - previous : previous - _value;
+    if(delta > watchDelta[slot]) {
+      events |= 1 << slot;
+    }
+  }
+  latestValues[slot] = _value;
+  if(listeners[slot] != NULL) {
+    listeners[slot](listenerContexts[slot], _value);
+  } else if(!buffers[slot].push(_value)) {
+    ++overruns;
+  }
+
+  slot = (slot + 1 < channels) ? slot + 1 : 0;
+  current = slot;
+  selectChannel(slot);
+}
+
+/*
+ * Point the multiplexer to the pin of a slot. In auto trigger mode the
+ * next conversion only starts on the next timer event, so there's plenty
+ * of time for the input to settle.
+ */
+void AnalogSampler::selectChannel(byte _slot) {
+#ifdef __AVR__
+  byte pin = pins[_slot];
+  if(pin >= A0) {
+    pin -= A0;
+  }
+  ADMUX = (reference << 6) | (pin & 0x07);
+#endif
+}
+
+#ifdef __AVR__
+/*
+ * Conversion complete. The compare match flag is cleared by hand since
+ * there's no timer interrupt to do it, and the ADC only triggers on its
+ * rising edge.
+ */
+ISR(ADC_vect) {
+  TIFR1 = _BV(OCF1B);
+  if(AnalogSampler::active != NULL) {
+    AnalogSampler::active->convert(ADC);
+  }
+}
+#else
+/*
+ * Stand-in for the timer trigger: convert the current channel.
+ */
+void AnalogSampler::trigger() {
+  if(channels > 0) {
+    convert(analogRead(pins[current]));
+  }
+}
+#endif
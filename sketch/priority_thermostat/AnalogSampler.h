@@ -0,0 +1,108 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+#ifndef _ANALOGSAMPLER_H_
+#define _ANALOGSAMPLER_H_
+
+#include <Arduino.h>
+#include "MagicNumbers.h"
+#include "RingBuffer.h"
+
+/*
+ * Interrupt driven sampling of the analog pins. Timer1 auto-triggers a
+ * conversion at ADC_SAMPLE_RATE, the conversion complete interrupt stores
+ * the result in the ring buffer of the current channel and selects the
+ * next one (round robin). Readers never block: they drain whatever was
+ * collected since their last visit.
+ *
+ * A slot can be watched: a sample that differs more than a given delta
+ * from the previous one raises an event (e.g. to react on a button press
+ * right away).
+ *
+ * A slot can also have a listener instead of a buffer: it's called from
+ * the interrupt with every sample of the slot (e.g. to decode buttons
+ * without depending on how often the main loop gets to them). Keep it
+ * short, it delays the next conversion.
+ *
+ * Samples are delivered left aligned to 16 bits (see ADC_RAW_SHIFT).
+ *
+ * acquire() takes an oversampled reading: 4^n conversions in a row, each
+ * one while the CPU idles, decimated to 10 + n bits. The round robin is
+ * paused meanwhile. The idle mode keeps the UART and the timers running,
+ * unlike the ADC noise reduction mode.
+ *
+ * Don't use analogRead() once the sampler is running, it takes over the
+ * ADC.
+ *
+ * On other platforms (no AVR registers) the sampler is a stand-in:
+ * trigger() performs the conversion that the timer would have started,
+ * using analogRead(), and runs it through the same interrupt logic.
+ */
+typedef void (*sample_listener_t)(void * _context, uint16_t _value);
+
+class AnalogSampler {
+  public:
+    AnalogSampler();
+    byte attach(byte _pin);
+    void begin(byte _reference);
+    bool read(byte _slot, uint16_t & _value);
+    void discard(byte _slot);
+    uint16_t latest(byte _slot);
+    uint16_t acquire(byte _slot, byte _bits);
+    void watch(byte _slot, uint16_t _delta);
+    void listen(byte _slot, sample_listener_t _listener, void * _context);
+    byte takeEvents();
+    unsigned int getOverruns();
+
+    // Interrupt logic, called for every finished conversion.
+    void convert(uint16_t _value);
+#ifndef __AVR__
+    void trigger();
+#endif
+
+    static AnalogSampler * active;
+
+  private:
+    byte pins[ADC_CHANNELS];
+    byte channels;
+    byte reference;
+    volatile byte current;
+    volatile uint16_t latestValues[ADC_CHANNELS];
+    volatile unsigned int overruns;
+    uint16_t watchDelta[ADC_CHANNELS];
+    sample_listener_t listeners[ADC_CHANNELS];
+    void * listenerContexts[ADC_CHANNELS];
+    volatile byte events;
+    volatile bool burst;
+    volatile bool converted;
+    volatile uint16_t burstValue;
+    RingBuffer<uint16_t, ADC_BUFFER_SIZE> buffers[ADC_CHANNELS];
+
+    void selectChannel(byte _slot);
+};
+
+#endif
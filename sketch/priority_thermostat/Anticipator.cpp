@@ -0,0 +1,219 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+
+#include "Anticipator.h"
+#include "Functions.h"
+
+/*
+ * Constructor
+ */
+Anticipator::Anticipator()
+  : journal(EEPROM_ANTICIPATOR_ADDR, EEPROM_ANTICIPATOR_SIZE, sizeof(anticipator_record_t), ANTICIPATOR_VERSION) {
+  // The stored estimates are loaded by begin()
+  memset(&record, 0, sizeof(record));
+  dirty = false;
+  lastCommit = 0;
+  started = false;
+
+  heating = false;
+  markTime = 0;
+  markTemperature = Centidegrees::fromRaw(0);
+  slopeTime = 0;
+  slopeTemperature = Centidegrees::fromRaw(0);
+  tracking = false;
+  cycleSlope = 0;
+  cutoffTime = 0;
+  cutoffTemperature = Centidegrees::fromRaw(0);
+  peak = Centidegrees::fromRaw(0);
+  lastRise = 0;
+  anticipation = 0;
+}
+
+/*
+ * Load the estimates from EEPROM.
+ */
+void Anticipator::begin() {
+  if(!journal.load(&record)) {
+    memset(&record, 0, sizeof(record));
+  }
+}
+
+/*
+ * Follow the heat cycles and learn from them (called after every
+ * temperature sample, _heating is whether heat goes to the tank).
+ */
+void Anticipator::update(unsigned long _millis, Centidegrees _temperature, bool _heating) {
+  if(!started) {
+    started = true;
+    lastCommit = _millis;
+  }
+
+  if(_heating && !heating) {
+    // A new cycle, also ends the wait for the peak of the previous one
+    markTime = slopeTime = _millis;
+    markTemperature = slopeTemperature = _temperature;
+    tracking = false;
+  } else if(_heating) {
+    // Keep the start of the slope one to two windows back
+    if(diffUL(markTime, _millis) >= ANTICIPATOR_SLOPE_WINDOW) {
+      slopeTime = markTime;
+      slopeTemperature = markTemperature;
+      markTime = _millis;
+      markTemperature = _temperature;
+    }
+  } else if(heating) {
+    // Cutoff
+    tracking = recentSlope(_millis, _temperature, cycleSlope) && cycleSlope > 0;
+    if(tracking) {
+      cutoffTime = _millis;
+      cutoffTemperature = _temperature;
+      peak = _temperature;
+    }
+  } else if(tracking) {
+    // Wait for the peak after the cutoff
+    if(_temperature > peak) {
+      peak = _temperature;
+    }
+    if(_temperature <= peak - Centidegrees::fromRaw(ANTICIPATOR_DROP)
+       || diffUL(cutoffTime, _millis) >= ANTICIPATOR_WINDOW) {
+      tracking = false;
+      learn(cycleSlope, (peak - cutoffTemperature).raw());
+    }
+  }
+  heating = _heating;
+
+  if(dirty && diffUL(lastCommit, _millis) >= ANTICIPATOR_COMMIT_INTERVAL) {
+    flush();
+    lastCommit = _millis;
+  }
+}
+
+/*
+ * Slope since the start of the slope (centi-degrees per minute, fixed
+ * point), returns false if the heat hasn't been on for a window yet.
+ */
+bool Anticipator::recentSlope(unsigned long _millis, Centidegrees _temperature, int & _slope) {
+  unsigned long elapsed = diffUL(slopeTime, _millis);
+  if(elapsed < ANTICIPATOR_SLOPE_WINDOW) {
+    return false;
+  }
+  long slope = (long)(_temperature - slopeTemperature).raw() * 60000L
+               / (long)(elapsed >> ANTICIPATOR_FRACTION_BITS);
+  if(slope < 0) {
+    slope = 0;
+  } else if(slope > 32767) {
+    slope = 32767;
+  }
+  _slope = slope;
+  return true;
+}
+
+/*
+ * Move the estimates towards the measurements of a cycle (slope in fixed
+ * point, rise in centi-degrees).
+ */
+void Anticipator::learn(int _slope, int _rise) {
+  int maximum = 32767 >> ANTICIPATOR_FRACTION_BITS;
+  int rise = (_rise > maximum ? maximum : _rise) << ANTICIPATOR_FRACTION_BITS;
+  if(record.cycles == 0) {
+    record.slope = _slope;
+    record.rise = rise;
+  } else {
+    record.slope += (_slope - record.slope) / (1 << ANTICIPATOR_SHIFT);
+    record.rise += (rise - record.rise) / (1 << ANTICIPATOR_SHIFT);
+  }
+  if(record.cycles < 0xFFFF) {
+    ++record.cycles;
+  }
+  lastRise = _rise;
+  dirty = true;
+}
+
+/*
+ * Predicted rise after a cutoff now (centi-degrees).
+ */
+Centidegrees Anticipator::predict(unsigned long _millis, Centidegrees _temperature) {
+  anticipation = 0;
+  if(record.cycles == 0 || record.rise <= 0) {
+    return Centidegrees::fromRaw(0);
+  }
+
+  long predicted = record.rise;
+  int slope;
+  if(heating && record.slope > 0 && recentSlope(_millis, _temperature, slope)) {
+    predicted = predicted * slope / record.slope;
+  }
+  Centidegrees rise = Centidegrees::saturate(predicted >> ANTICIPATOR_FRACTION_BITS);
+  anticipation = rise.raw();
+  return rise;
+}
+
+/*
+ * Store changed estimates right away (e.g. before a reset).
+ */
+void Anticipator::flush() {
+  if(dirty) {
+    journal.commit(&record);
+    dirty = false;
+  }
+}
+
+/*
+ * Learned slope while heating (centi-degrees per minute, fixed point)
+ */
+int Anticipator::getSlope() {
+  return record.slope;
+}
+
+/*
+ * Learned rise after the cutoff (centi-degrees, fixed point)
+ */
+int Anticipator::getRise() {
+  return record.rise;
+}
+
+/*
+ * Number of cycles learned from
+ */
+unsigned int Anticipator::getCycles() {
+  return record.cycles;
+}
+
+/*
+ * Rise measured after the last cutoff (centi-degrees)
+ */
+int Anticipator::getLastRise() {
+  return lastRise;
+}
+
+/*
+ * Last prediction (centi-degrees)
+ */
+int Anticipator::getAnticipation() {
+  return anticipation;
+}
@@ -0,0 +1,111 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+
+#ifndef _ANTICIPATOR_H_
+#define _ANTICIPATOR_H_
+
+#include <Arduino.h>
+#include "MagicNumbers.h"
+#include "Journal.h"
+#include "Fixed.h"
+
+/*
+ * Predicts how far the tank keeps heating up after the relay opens (the
+ * heat in the coil and the lag of the thermistor), so the thermostat can
+ * open the relay that much earlier.
+ *
+ * Every heat cycle yields two measurements: the slope just before the
+ * cutoff (over the last one to two ANTICIPATOR_SLOPE_WINDOWs, cycles
+ * shorter than a window are skipped) and the rise after the cutoff (the
+ * peak within ANTICIPATOR_WINDOW ms., the peak is over once the
+ * temperature dropped ANTICIPATOR_DROP centi-degrees below it). Both are
+ * averaged with a recursive filter, every cycle moves the estimates
+ * 1 / 2^ANTICIPATOR_SHIFT of the way to the measurement. The estimates
+ * are in fixed point with ANTICIPATOR_FRACTION_BITS fractional bits:
+ * centi-degrees per minute and centi-degrees.
+ *
+ * The rise scales with the slope (a tank that heats up faster carries
+ * more heat in the coil), so the prediction is the learned rise times the
+ * current slope over the learned slope. The slope is measured over the
+ * last minutes only, the start of a cycle is slowed down by the lag of
+ * the coil and the thermistor. Until a cycle was learned, nothing is
+ * predicted.
+ *
+ * The estimates are stored in a journal of their own (see Journal.h) at
+ * most every ANTICIPATOR_COMMIT_INTERVAL ms., and by flush().
+ */
+
+/*
+ * The estimates as stored in the journal (fixed widths, no padding).
+ */
+typedef struct anticipator_record {
+  int16_t slope;
+  int16_t rise;
+  uint16_t cycles;
+} anticipator_record_t;
+
+class Anticipator {
+  public:
+    Anticipator();
+    void begin();
+    void update(unsigned long _millis, Centidegrees _temperature, bool _heating);
+    Centidegrees predict(unsigned long _millis, Centidegrees _temperature);
+    void flush();
+
+    int getSlope();
+    int getRise();
+    unsigned int getCycles();
+    int getLastRise();
+    int getAnticipation();
+
+  private:
+    Journal journal;
+    anticipator_record_t record;
+    bool dirty;
+    unsigned long lastCommit;
+    bool started;
+
+    // the running cycle
+    bool heating;
+    unsigned long markTime;
+    Centidegrees markTemperature;
+    unsigned long slopeTime;
+    Centidegrees slopeTemperature;
+    bool tracking;
+    int cycleSlope;
+    unsigned long cutoffTime;
+    Centidegrees cutoffTemperature;
+    Centidegrees peak;
+    int lastRise;
+    int anticipation;
+
+    bool recentSlope(unsigned long _millis, Centidegrees _temperature, int & _slope);
+    void learn(int _slope, int _rise);
+};
+
+#endif
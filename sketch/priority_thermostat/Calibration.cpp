@@ -0,0 +1,211 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+#include "Calibration.h"
+#include <EEPROM.h>
+
+/*
+ * Constructor
+ */
+Calibration::Calibration() {
+  count = 0;
+}
+
+/*
+ * Add a point, keeping the set sorted on the raw value. The point replaces
+ * every existing one within CALIBRATION_MIN_DISTANCE. Returns false when
+ * the set is full or the point would create an impossible slope (the set
+ * is left untouched in that case).
+ */
+bool Calibration::addPoint(uint16_t _raw, Centidegrees _temperature) {
+  calibration_point_t backup[CALIBRATION_MAX_POINTS];
+  byte backupCount = count;
+  memcpy(backup, points, sizeof(points));
+
+  // Replace the points that are too close (there can be two, one on
+  // either side)
+  byte kept = 0;
+  for(byte i=0; i<count; ++i) {
+    uint16_t distance = points[i].raw > _raw ? points[i].raw - _raw : _raw - points[i].raw;
+    if(distance >= CALIBRATION_MIN_DISTANCE) {
+      points[kept++] = points[i];
+    }
+  }
+  count = kept;
+
+  if(count >= CALIBRATION_MAX_POINTS) {
+    count = backupCount;
+    memcpy(points, backup, sizeof(points));
+    return false;
+  }
+
+  // Sorted insert
+  byte i = count;
+  while(i > 0 && points[i - 1].raw > _raw) {
+    points[i] = points[i - 1];
+    --i;
+  }
+  points[i].raw = _raw;
+  points[i].temperature = _temperature.raw();
+  ++count;
+
+  if(!computeSlopes()) {
+    count = backupCount;
+    memcpy(points, backup, sizeof(points));
+    computeSlopes();
+    return false;
+  }
+  return true;
+}
+
+/*
+ * Remove all points (the compiled table is used again).
+ */
+void Calibration::clear() {
+  count = 0;
+}
+
+/*
+ * Number of points in the set
+ */
+byte Calibration::getCount() {
+  return count;
+}
+
+/*
+ * Check if the set can be used for conversions
+ */
+bool Calibration::isActive() {
+  return count >= 2;
+}
+
+/*
+ * Convert a raw value to a temperature.
+ */
+Centidegrees Calibration::convert(uint16_t _raw) {
+  // Binary search for the last point at or below _raw (clamped to the
+  // first and last segment).
+  byte low = 0;
+  byte high = count - 2;
+  while(low < high) {
+    byte middle = (low + high + 1) / 2;
+    if(points[middle].raw <= _raw) {
+      low = middle;
+    } else {
+      high = middle - 1;
+    }
+  }
+
+  // The distance to the point fits 16 bits unsigned, its sign goes with
+  // the slope
+  uint16_t base = points[low].raw;
+  int32_t offset = _raw >= base ? multiplyWide(slopes[low], _raw - base)
+                                : multiplyWide(-slopes[low], base - _raw);
+  return Centidegrees::saturate(points[low].temperature + (offset >> CALIBRATION_SLOPE_SHIFT));
+}
+
+/*
+ * Calculate the slope of every segment. Fails if the points aren't in
+ * strictly increasing raw order, or a slope doesn't fit the fixed point
+ * format (two points too close for their temperatures).
+ */
+bool Calibration::computeSlopes() {
+  for(byte i=0; i+1<count; ++i) {
+    long dx = (long)points[i + 1].raw - (long)points[i].raw;
+    if(dx <= 0) {
+      return false;
+    }
+    long dy = (long)points[i + 1].temperature - (long)points[i].temperature;
+    long slope = (dy << CALIBRATION_SLOPE_SHIFT) / dx;
+    if(slope > 32767L || slope < -32767L) {
+      return false;
+    }
+    slopes[i] = slope;
+  }
+  return true;
+}
+
+/*
+ * Load the set from EEPROM. Returns false (and leaves the set empty) when
+ * there's no valid set stored.
+ */
+bool Calibration::load() {
+  byte tag[2];
+  byte expectedTag[2] = CALIBRATION_TAG;
+  byte version;
+  byte storedCount;
+
+  count = 0;
+  EEPROM.get(EEPROM_CALIBRATION_ADDR, tag);
+  EEPROM.get(EEPROM_CALIBRATION_ADDR + 2, version);
+  EEPROM.get(EEPROM_CALIBRATION_ADDR + 3, storedCount);
+  if(memcmp(tag, expectedTag, 2) != 0 || version != CALIBRATION_VERSION
+     || storedCount > CALIBRATION_MAX_POINTS) {
+    return false;
+  }
+
+  int address = EEPROM_CALIBRATION_ADDR + 4;
+  for(byte i=0; i<storedCount; ++i) {
+    EEPROM.get(address, points[i]);
+    address += sizeof(calibration_point_t);
+  }
+  for(byte i=0; i+1<storedCount; ++i) {
+    EEPROM.get(address, slopes[i]);
+    address += sizeof(int16_t);
+  }
+
+  // A set with points out of order can't be converted with
+  for(byte i=0; i+1<storedCount; ++i) {
+    if(points[i + 1].raw <= points[i].raw) {
+      return false;
+    }
+  }
+  count = storedCount;
+  return true;
+}
+
+/*
+ * Store the set, including the precomputed slopes.
+ */
+void Calibration::save() {
+  byte tag[2] = CALIBRATION_TAG;
+  byte version = CALIBRATION_VERSION;
+
+  EEPROM.put(EEPROM_CALIBRATION_ADDR, tag);
+  EEPROM.put(EEPROM_CALIBRATION_ADDR + 2, version);
+  EEPROM.put(EEPROM_CALIBRATION_ADDR + 3, count);
+
+  int address = EEPROM_CALIBRATION_ADDR + 4;
+  for(byte i=0; i<count; ++i) {
+    EEPROM.put(address, points[i]);
+    address += sizeof(calibration_point_t);
+  }
+  for(byte i=0; i+1<count; ++i) {
+    EEPROM.put(address, slopes[i]);
+    address += sizeof(int16_t);
+  }
+}
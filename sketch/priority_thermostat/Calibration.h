@@ -0,0 +1,71 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+#ifndef _CALIBRATION_H_
+#define _CALIBRATION_H_
+
+#include <Arduino.h>
+#include "MagicNumbers.h"
+#include "Fixed.h"
+
+typedef struct calibration_point {
+  uint16_t raw;        // left aligned ADC value (see ADC_RAW_SHIFT)
+  int16_t temperature; // centi-degrees
+} calibration_point_t;
+
+/*
+ * Calibration set captured on the device and stored in EEPROM. When it
+ * holds at least two points it replaces the compiled temperature table.
+ *
+ * The slope of every segment is calculated once, when a point is added
+ * or the set is loaded, in CALIBRATION_SLOPE_SHIFT fixed point. A
+ * conversion is a binary search for the segment followed by a single
+ * 16 x 16 bit multiply and shift, starting from the lower point of the
+ * segment. Values outside the set are extrapolated from the closest
+ * segment.
+ */
+class Calibration {
+  public:
+    Calibration();
+    bool addPoint(uint16_t _raw, Centidegrees _temperature);
+    void clear();
+    byte getCount();
+    bool isActive();
+    Centidegrees convert(uint16_t _raw);
+
+    bool load();
+    void save();
+
+  private:
+    calibration_point_t points[CALIBRATION_MAX_POINTS];
+    int16_t slopes[CALIBRATION_MAX_POINTS - 1];
+    byte count;
+
+    bool computeSlopes();
+};
+
+#endif
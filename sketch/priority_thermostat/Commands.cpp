@@ -0,0 +1,409 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+#include "Commands.h"
+#include "Format.h"
+#include "Profiler.h"
+
+static const command_parameter_t commandParameters[COMMAND_PARAMETERS] PROGMEM = COMMAND_PARAMETER_TABLE;
+
+/*
+ * Helper function for parsing a (signed) decimal number, returns false
+ * if the text isn't a number or is too long.
+ */
+bool parseNumber(const char * _text, long & _value) {
+  bool negative = *_text == '-';
+  if(negative) {
+    ++_text;
+  }
+  if(*_text == '\0') {
+    return false;
+  }
+  long value = 0;
+  for(byte digits=0; *_text != '\0'; ++digits, ++_text) {
+    if(*_text < '0' || *_text > '9' || digits >= 9) {
+      return false;
+    }
+    value = value * 10 + (*_text - '0');
+  }
+  _value = negative ? -value : value;
+  return true;
+}
+
+/*
+ * Helper function for splitting off the next word of a line, returns
+ * NULL if there is none.
+ */
+char * nextWord(char * & _text) {
+  while(*_text == ' ') {
+    ++_text;
+  }
+  if(*_text == '\0') {
+    return NULL;
+  }
+  char * word = _text;
+  while(*_text != ' ' && *_text != '\0') {
+    ++_text;
+  }
+  if(*_text == ' ') {
+    *_text++ = '\0';
+  }
+  return word;
+}
+
+/*
+ * Constructor
+ */
+Commands::Commands(HardwareSerial * _port, Thermostat * _thermostat, Telemetry * _telemetry) {
+  port = _port;
+  thermostat = _thermostat;
+  telemetry = _telemetry;
+  scheduler = NULL;
+  sampler = NULL;
+  length = 0;
+  overflow = false;
+  inBatch = false;
+  staged = 0;
+}
+
+/*
+ * Where the overrun counters come from (they read 0 until set).
+ */
+void Commands::setDiagnostics(Scheduler * _scheduler, AnalogSampler * _sampler) {
+  scheduler = _scheduler;
+  sampler = _sampler;
+}
+
+/*
+ * Read what has arrived (at most COMMAND_READ_LIMIT characters) and
+ * execute a command once a line is complete.
+ */
+void Commands::poll() {
+  if(!telemetry->isActive()) {
+    return;
+  }
+
+  for(byte i=0; i<COMMAND_READ_LIMIT && port->available() > 0; ++i) {
+    char character = port->read();
+    if(character == '\n' || character == '\r') {
+      if(overflow) {
+        respond("err length");
+      } else if(length > 0) {
+        line[length] = '\0';
+        execute();
+      }
+      length = 0;
+      overflow = false;
+      return;
+    }
+    if(length < COMMAND_LENGTH) {
+      line[length++] = (character >= 'A' && character <= 'Z') ? character + 'a' - 'A' : character;
+    } else {
+      overflow = true;
+    }
+  }
+}
+
+/*
+ * Execute the command in the line buffer.
+ */
+void Commands::execute() {
+  char * text = line;
+  char * command = nextWord(text);
+  char * name = nextWord(text);
+  char * value = nextWord(text);
+
+  if(command == NULL) {
+    return;
+  } else if(strcmp(command, "get") == 0 && name != NULL && value == NULL) {
+    executeGet(name);
+  } else if(strcmp(command, "set") == 0 && value != NULL && nextWord(text) == NULL) {
+    executeSet(name, value);
+  } else if(strcmp(command, "batch") == 0 && name == NULL) {
+    inBatch = true;
+    staged = 0;
+    respond("ok");
+  } else if(strcmp(command, "commit") == 0 && name == NULL) {
+    executeCommit();
+  } else if(strcmp(command, "abort") == 0 && name == NULL) {
+    inBatch = false;
+    staged = 0;
+    respond("ok");
+#if PROFILING
+  } else if(strcmp(command, "prof") == 0 && name == NULL) {
+    // Too much for the transmit buffer, this one waits for the UART. The
+    // plain text would end up in the middle of the binary frames.
+    if(thermostat->getSerialMode() == TELEMETRY_BINARY) {
+      respond("err binary");
+    } else {
+      profiler.dump(port);
+    }
+#endif
+  } else {
+    respond("err syntax");
+  }
+}
+
+/*
+ * get <name>
+ */
+void Commands::executeGet(char * _name) {
+  byte parameter = findParameter(_name);
+  if(parameter == COMMAND_PARAMETERS) {
+    respond("err name");
+    return;
+  }
+  respond("ok", parameter, getValue(parameter));
+}
+
+/*
+ * set <name> <value>: outside of a batch the change is applied and saved
+ * right away.
+ */
+void Commands::executeSet(char * _name, char * _value) {
+  byte parameter = findParameter(_name);
+  long value;
+  if(parameter == COMMAND_PARAMETERS) {
+    respond("err name");
+    return;
+  }
+  if(!parseNumber(_value, value)) {
+    respond("err syntax");
+    return;
+  }
+
+  command_parameter_t limits;
+  memcpy_P(&limits, &commandParameters[parameter], sizeof(limits));
+  if(!limits.writable) {
+    respond("err readonly");
+    return;
+  }
+  if(value < limits.minimum || value > limits.maximum) {
+    respond("err range");
+    return;
+  }
+
+  if(!inBatch) {
+    staged = 0;
+  }
+  staged |= 1UL << parameter;
+  stagedValues[parameter] = value;
+  if(inBatch) {
+    respond("ok");
+  } else {
+    executeCommit();
+  }
+}
+
+/*
+ * Apply all staged changes and save them in a single go.
+ */
+void Commands::executeCommit() {
+  if(!validate()) {
+    inBatch = false;
+    staged = 0;
+    respond("err range");
+    return;
+  }
+
+  byte count = 0;
+  for(byte i=0; i<COMMAND_PARAMETERS; ++i) {
+    if(staged & (1UL << i)) {
+      setValue(i, stagedValues[i]);
+      ++count;
+    }
+  }
+  if(count > 0) {
+    thermostat->save();
+  }
+  inBatch = false;
+  staged = 0;
+  respond("ok");
+}
+
+/*
+ * Checks that involve more than one parameter.
+ */
+bool Commands::validate() {
+  return getStagedValue(COMMAND_MIN_TEMPERATURE) < getStagedValue(COMMAND_MAX_TEMPERATURE)
+         && getStagedValue(COMMAND_PID_PULSE) * 2 <= getStagedValue(COMMAND_PID_WINDOW);
+}
+
+/*
+ * Look up a parameter by name, returns COMMAND_PARAMETERS if unknown.
+ */
+byte Commands::findParameter(const char * _name) {
+  for(byte i=0; i<COMMAND_PARAMETERS; ++i) {
+    if(strcmp_P(_name, commandParameters[i].name) == 0) {
+      return i;
+    }
+  }
+  return COMMAND_PARAMETERS;
+}
+
+/*
+ * Value of a parameter, in the units of the command channel.
+ */
+long Commands::getValue(byte _parameter) {
+  switch(_parameter) {
+    case COMMAND_SETPOINT:
+      return thermostat->getRequestedTemperature().raw();
+    case COMMAND_HYSTERESIS:
+      return thermostat->getHysteresis().raw();
+    case COMMAND_MIN_TEMPERATURE:
+      return thermostat->getMinTemperature().raw();
+    case COMMAND_MAX_TEMPERATURE:
+      return thermostat->getMaxTemperature().raw();
+    case COMMAND_MAX_HEAT_TIME:
+      return thermostat->getMaxHeatTime() / 1000;
+    case COMMAND_GRACE_TIME:
+      return thermostat->getGraceTime() / 1000;
+    case COMMAND_OFFSET:
+      return thermostat->getOffsetTemperature().raw();
+    case COMMAND_OVERSAMPLING:
+      return thermostat->getOversampling();
+    case COMMAND_SERIAL:
+      return thermostat->getSerialMode();
+    case COMMAND_TEMPERATURE:
+      return thermostat->getTemperature().raw();
+    case COMMAND_ALARM:
+      return thermostat->getAlarmCause();
+    case COMMAND_COMMITS:
+      return thermostat->getParameterCommits();
+    case COMMAND_EEPROM_BYTES:
+      return thermostat->getEepromBytesWritten();
+    case COMMAND_SLOPE:
+      return thermostat->getAnticipator()->getSlope() >> ANTICIPATOR_FRACTION_BITS;
+    case COMMAND_RISE:
+      return thermostat->getAnticipator()->getRise() >> ANTICIPATOR_FRACTION_BITS;
+    case COMMAND_CONTROL:
+      return thermostat->getControlMode();
+    case COMMAND_PID_GAIN:
+      return thermostat->getPidGain();
+    case COMMAND_PID_INTEGRAL:
+      return thermostat->getPidIntegralTime();
+    case COMMAND_PID_DERIVATIVE:
+      return thermostat->getPidDerivativeTime();
+    case COMMAND_PID_WINDOW:
+      return thermostat->getPidWindow();
+    case COMMAND_PID_PULSE:
+      return thermostat->getPidMinimumPulse();
+    case COMMAND_PID_OUTPUT:
+      return thermostat->getPid()->getOutput();
+    case COMMAND_OVERRUNS:
+      return scheduler != NULL ? scheduler->getTotalOverruns() : 0;
+    case COMMAND_ADC_OVERRUNS:
+      return sampler != NULL ? sampler->getOverruns() : 0;
+  }
+  return 0;
+}
+
+/*
+ * Value of a parameter after the staged changes.
+ */
+long Commands::getStagedValue(byte _parameter) {
+  return (staged & (1UL << _parameter)) ? stagedValues[_parameter] : getValue(_parameter);
+}
+
+/*
+ * Change a parameter (the value was checked already).
+ */
+void Commands::setValue(byte _parameter, long _value) {
+  switch(_parameter) {
+    case COMMAND_SETPOINT:
+      thermostat->setRequestedTemperature(Centidegrees::saturate(_value));
+      break;
+    case COMMAND_HYSTERESIS:
+      thermostat->setHysteresis(Centidegrees::saturate(_value));
+      break;
+    case COMMAND_MIN_TEMPERATURE:
+      thermostat->setMinTemperature(Centidegrees::saturate(_value));
+      break;
+    case COMMAND_MAX_TEMPERATURE:
+      thermostat->setMaxTemperature(Centidegrees::saturate(_value));
+      break;
+    case COMMAND_MAX_HEAT_TIME:
+      thermostat->setMaxHeatTime(_value * 1000);
+      break;
+    case COMMAND_GRACE_TIME:
+      thermostat->setGraceTime(_value * 1000);
+      break;
+    case COMMAND_OFFSET:
+      thermostat->setOffsetTemperature(Centidegrees::saturate(_value));
+      break;
+    case COMMAND_OVERSAMPLING:
+      thermostat->setOversampling(_value);
+      break;
+    case COMMAND_SERIAL:
+      thermostat->setSerialMode(_value);
+      break;
+    case COMMAND_CONTROL:
+      thermostat->setControlMode(_value);
+      break;
+    case COMMAND_PID_GAIN:
+      thermostat->setPidGain(_value);
+      break;
+    case COMMAND_PID_INTEGRAL:
+      thermostat->setPidIntegralTime(_value);
+      break;
+    case COMMAND_PID_DERIVATIVE:
+      thermostat->setPidDerivativeTime(_value);
+      break;
+    case COMMAND_PID_WINDOW:
+      thermostat->setPidWindow(_value);
+      break;
+    case COMMAND_PID_PULSE:
+      thermostat->setPidMinimumPulse(_value);
+      break;
+  }
+}
+
+/*
+ * Send an answer: the text, optionally followed by a parameter and its
+ * value.
+ */
+void Commands::respond(const char * _text, byte _parameter, long _value) {
+  char answer[COMMAND_LENGTH];
+  FieldWriter<sizeof(answer)> writer(answer);
+  writer.text(_text);
+  if(_parameter < COMMAND_PARAMETERS) {
+    char name[sizeof(commandParameters[0].name)];
+    strcpy_P(name, commandParameters[_parameter].name);
+    writer.character(' ').text(name).character(' ').number(_value);
+  }
+
+  if(thermostat->getSerialMode() == TELEMETRY_BINARY) {
+    telemetry->beginFrame(TELEMETRY_FRAME_RESPONSE);
+    for(byte i=0; i<writer.getLength(); ++i) {
+      telemetry->put8(answer[i]);
+    }
+    telemetry->endFrame();
+  } else if(telemetry->reserve(writer.getLength() + 2)) {
+    telemetry->write((const uint8_t *)answer, writer.getLength());
+    telemetry->println();
+  }
+}
@@ -0,0 +1,101 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+#ifndef _COMMANDS_H_
+#define _COMMANDS_H_
+
+#include <Arduino.h>
+#include "MagicNumbers.h"
+#include "Thermostat.h"
+#include "Telemetry.h"
+#include "Scheduler.h"
+#include "AnalogSampler.h"
+
+/*
+ * Command channel on the serial console, for configuring a unit from a
+ * script. Commands are lines of text (case insensitive):
+ *
+ *   get <name>          value of a parameter
+ *   set <name> <value>  change a parameter, saved (see Thermostat::save())
+ *   batch               start collecting changes
+ *   commit              apply the collected changes at once (one save)
+ *   abort               forget the collected changes
+ *
+ * Temperatures are in centi-degrees, times in seconds. Values are checked
+ * against the limits in the parameter table; a batch is only applied when
+ * all of its values (and the minimum/maximum temperature pair, and the
+ * PID pulse of at most half the window) are valid. The missed deadlines
+ * of the scheduler and the samples the readers of the ADC lost can be
+ * read as well ("overruns" and "adcoverruns", see setDiagnostics()).
+ * Every command is answered with "ok [...]" or "err <reason>", as a text
+ * line or as a TELEMETRY_FRAME_RESPONSE frame in binary mode.
+ *
+ * Input is parsed a few characters at a time, poll() never waits.
+ */
+typedef struct command_parameter {
+  char name[12];
+  long minimum;
+  long maximum;
+  bool writable;
+} command_parameter_t;
+
+class Commands {
+  public:
+    Commands(HardwareSerial * _port, Thermostat * _thermostat, Telemetry * _telemetry);
+    void setDiagnostics(Scheduler * _scheduler, AnalogSampler * _sampler);
+    void poll();
+
+  private:
+    HardwareSerial * port;
+    Thermostat * thermostat;
+    Telemetry * telemetry;
+    Scheduler * scheduler;
+    AnalogSampler * sampler;
+
+    char line[COMMAND_LENGTH + 1];
+    byte length;
+    bool overflow;
+
+    bool inBatch;
+    unsigned long staged;
+    long stagedValues[COMMAND_PARAMETERS];
+
+    void execute();
+    void executeGet(char * _name);
+    void executeSet(char * _name, char * _value);
+    void executeCommit();
+
+    byte findParameter(const char * _name);
+    long getValue(byte _parameter);
+    long getStagedValue(byte _parameter);
+    void setValue(byte _parameter, long _value);
+    bool validate();
+
+    void respond(const char * _text, byte _parameter = COMMAND_PARAMETERS, long _value = 0);
+};
+
+#endif
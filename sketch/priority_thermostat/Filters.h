@@ -0,0 +1,378 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+#ifndef _FILTERS_H_
+#define _FILTERS_H_
+
+#include <Arduino.h>
+
+/*
+ * Sample filter stages that can be chained at compile time, e.g.
+ *
+ *   FilterChain<Median<3>, Boxcar<16> > filter;
+ *   long smooth = filter.update(sample);
+ *
+ * Every stage updates in constant time. Each stage implements:
+ *  - long update(long): feed a sample, returns the filtered value
+ *  - bool ready(): true once the stage has seen enough samples
+ *  - void reset(): forget all history
+ */
+
+/*
+ * Compile time helpers for the window sizes.
+ */
+constexpr bool isPowerOfTwo(unsigned int _value) {
+  return _value != 0 && (_value & (_value - 1)) == 0;
+}
+
+constexpr byte log2Floor(unsigned int _value) {
+  return _value <= 1 ? 0 : 1 + log2Floor(_value / 2);
+}
+
+/*
+ * Moving average over the last N samples, using a running sum. When N is
+ * a power of two the division becomes a shift.
+ */
+template<byte N>
+class Boxcar {
+  static_assert(N > 0, "Boxcar needs at least one sample");
+
+  public:
+    Boxcar();
+    long update(long _value);
+    bool ready();
+    void reset();
+
+  private:
+    long window[N];
+    long sum;
+    byte index;
+    byte count;
+};
+
+/*
+ * Exponential moving average with alpha = 1 / 2^Shift. The accumulator
+ * keeps Shift extra bits, so small steps aren't lost to truncation.
+ */
+template<byte Shift>
+class Ema {
+  static_assert(Shift > 0 && Shift < 16, "Ema shift out of range");
+
+  public:
+    Ema();
+    long update(long _value);
+    bool ready();
+    void reset();
+
+  private:
+    long accumulator;
+    bool seeded;
+};
+
+/*
+ * Median of the last N samples, rejects spikes shorter than N / 2
+ * samples. N is small (3 or 5), so sorting a copy is cheap and constant.
+ */
+template<byte N>
+class Median {
+  static_assert(N % 2 == 1 && N <= 9, "Median needs a small, odd window");
+
+  public:
+    Median();
+    long update(long _value);
+    bool ready();
+    void reset();
+
+  private:
+    long window[N];
+    byte index;
+    byte count;
+};
+
+/*
+ * One dimensional Kalman filter for a slowly drifting value. Q is the
+ * process noise and R the measurement noise, both as variances in sample
+ * units. The gain is kept in 8 bit fixed point. This is the most
+ * expensive stage (one 32 bit division per update).
+ */
+template<long Q, long R>
+class Kalman {
+  static_assert(Q >= 0 && R > 0 && R < 0x400000L, "Kalman noise out of range");
+
+  public:
+    Kalman();
+    long update(long _value);
+    bool ready();
+    void reset();
+
+  private:
+    long estimate;
+    long error;
+    bool seeded;
+};
+
+/*
+ * A chain of stages, each one feeding the next.
+ */
+template<typename... Stages>
+class FilterChain;
+
+template<>
+class FilterChain<> {
+  public:
+    long update(long _value) { return _value; }
+    bool ready() { return true; }
+    void reset() {}
+};
+
+template<typename Stage, typename... Rest>
+class FilterChain<Stage, Rest...> {
+  public:
+    long update(long _value);
+    bool ready();
+    void reset();
+
+  private:
+    Stage stage;
+    FilterChain<Rest...> rest;
+};
+
+/*
+ * Constructor
+ */
+template<byte N>
+Boxcar<N>::Boxcar() {
+  reset();
+}
+
+/*
+ * Add a sample, returns the average of the window.
+ */
+template<byte N>
+long Boxcar<N>::update(long _value) {
+  sum += _value - window[index];
+  window[index] = _value;
+  if(++index >= N) {
+    index = 0;
+  }
+  if(count < N) {
+    ++count;
+  }
+
+  return isPowerOfTwo(N) ? sum >> log2Floor(N) : sum / N;
+}
+
+/*
+ * The average is only meaningful once the window is filled.
+ */
+template<byte N>
+bool Boxcar<N>::ready() {
+  return count >= N;
+}
+
+/*
+ * Clear the window
+ */
+template<byte N>
+void Boxcar<N>::reset() {
+  for(byte i=0; i<N; ++i) {
+    window[i] = 0;
+  }
+  sum = 0;
+  index = 0;
+  count = 0;
+}
+
+/*
+ * Constructor
+ */
+template<byte Shift>
+Ema<Shift>::Ema() {
+  reset();
+}
+
+/*
+ * Add a sample. The first sample seeds the average, so there's no
+ * ramp up from zero.
+ */
+template<byte Shift>
+long Ema<Shift>::update(long _value) {
+  if(!seeded) {
+    accumulator = _value << Shift;
+    seeded = true;
+  } else {
+    accumulator += _value - (accumulator >> Shift);
+  }
+  return accumulator >> Shift;
+}
+
+/*
+ * Ready as soon as it's seeded.
+ */
+template<byte Shift>
+bool Ema<Shift>::ready() {
+  return seeded;
+}
+
+/*
+ * Forget the average
+ */
+template<byte Shift>
+void Ema<Shift>::reset() {
+  accumulator = 0;
+  seeded = false;
+}
+
+/*
+ * Constructor
+ */
+template<byte N>
+Median<N>::Median() {
+  reset();
+}
+
+/*
+ * Add a sample, returns the median of the window (or the sample itself
+ * while the window is filling up).
+ */
+template<byte N>
+long Median<N>::update(long _value) {
+  window[index] = _value;
+  if(++index >= N) {
+    index = 0;
+  }
+  if(count < N) {
+    ++count;
+    return _value;
+  }
+
+  // Insertion sort on a copy.
+  long sorted[N];
+  for(byte i=0; i<N; ++i) {
+    long value = window[i];
+    byte j = i;
+    while(j > 0 && sorted[j - 1] > value) {
+      sorted[j] = sorted[j - 1];
+      --j;
+    }
+    sorted[j] = value;
+  }
+  return sorted[N / 2];
+}
+
+/*
+ * Ready once the window is filled.
+ */
+template<byte N>
+bool Median<N>::ready() {
+  return count >= N;
+}
+
+/*
+ * Clear the window
+ */
+template<byte N>
+void Median<N>::reset() {
+  index = 0;
+  count = 0;
+}
+
+/*
+ * Constructor
+ */
+template<long Q, long R>
+Kalman<Q, R>::Kalman() {
+  reset();
+}
+
+/*
+ * Predict (the value drifts with variance Q) and correct with the new
+ * measurement.
+ */
+template<long Q, long R>
+long Kalman<Q, R>::update(long _value) {
+  if(!seeded) {
+    estimate = _value;
+    error = R;
+    seeded = true;
+    return estimate;
+  }
+
+  error += Q;
+  if(error > 0x400000L) {
+    error = 0x400000L;
+  }
+  long gain = (error << 8) / (error + R);
+  estimate += (gain * (_value - estimate)) >> 8;
+  error = ((256L - gain) * error) >> 8;
+  return estimate;
+}
+
+/*
+ * Ready as soon as it's seeded.
+ */
+template<long Q, long R>
+bool Kalman<Q, R>::ready() {
+  return seeded;
+}
+
+/*
+ * Forget the estimate
+ */
+template<long Q, long R>
+void Kalman<Q, R>::reset() {
+  estimate = 0;
+  error = R;
+  seeded = false;
+}
+
+/*
+ * Run a sample through all stages.
+ */
+template<typename Stage, typename... Rest>
+long FilterChain<Stage, Rest...>::update(long _value) {
+  return rest.update(stage.update(_value));
+}
+
+/*
+ * The chain is ready when all its stages are.
+ */
+template<typename Stage, typename... Rest>
+bool FilterChain<Stage, Rest...>::ready() {
+  return stage.ready() && rest.ready();
+}
+
+/*
+ * Reset all stages
+ */
+template<typename Stage, typename... Rest>
+void FilterChain<Stage, Rest...>::reset() {
+  stage.reset();
+  rest.reset();
+}
+
+#endif
@@ -0,0 +1,236 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+
+#ifndef _FIXED_H_
+#define _FIXED_H_
+
+#include <Arduino.h>
+
+/*
+ * Fixed point values with the scale in the type, e.g. centi-degrees:
+ *
+ *   typedef Fixed<int16_t, 100> Centidegrees;
+ *   Centidegrees setpoint = Centidegrees::fromUnits(50);  // 50.00
+ *   Centidegrees upper = setpoint + Centidegrees::fromRaw(250);
+ *
+ * Values of different scales or widths don't mix: a conversion is
+ * spelled out with rescale<S>(), widen<W>() or narrow<N>(), so the
+ * arithmetic stays in the width of the operands (16 bit for
+ * temperatures) unless it's asked for.
+ *
+ * Arithmetic saturates at the limits of the type instead of wrapping.
+ * The most negative value of the type is reserved for an invalid value
+ * (e.g. no temperature yet), the default value: it's never the outcome
+ * of arithmetic on valid values and it propagates through it. Comparisons
+ * are on the raw values, check isValid() first where it matters.
+ */
+
+/*
+ * Limits per width, the next wider type holds sums and products.
+ */
+template<typename T>
+struct FixedLimits;
+
+template<>
+struct FixedLimits<int8_t> {
+  typedef int16_t Wider;
+  static constexpr int8_t invalid() { return -128; }
+  static constexpr int8_t minimum() { return -127; }
+  static constexpr int8_t maximum() { return 127; }
+};
+
+template<>
+struct FixedLimits<int16_t> {
+  typedef int32_t Wider;
+  static constexpr int16_t invalid() { return -32767 - 1; }
+  static constexpr int16_t minimum() { return -32767; }
+  static constexpr int16_t maximum() { return 32767; }
+};
+
+template<>
+struct FixedLimits<int32_t> {
+  typedef int64_t Wider;
+  static constexpr int32_t invalid() { return -2147483647L - 1; }
+  static constexpr int32_t minimum() { return -2147483647L; }
+  static constexpr int32_t maximum() { return 2147483647L; }
+};
+
+template<typename T, long Scale>
+class Fixed {
+  static_assert(Scale > 0, "Fixed needs a positive scale");
+
+  public:
+    typedef T Value;
+    typedef typename FixedLimits<T>::Wider Wider;
+
+    /*
+     * Invalid until a value is assigned.
+     */
+    constexpr Fixed() : value(FixedLimits<T>::invalid()) {}
+
+    /*
+     * From the raw representation (in 1 / Scale units), as stored.
+     */
+    static constexpr Fixed fromRaw(T _raw) {
+      return Fixed(_raw, true);
+    }
+
+    /*
+     * From a raw value in a wider type, clipped to the limits.
+     */
+    static constexpr Fixed saturate(Wider _raw) {
+      return Fixed(_raw < FixedLimits<T>::minimum() ? FixedLimits<T>::minimum()
+                   : (_raw > FixedLimits<T>::maximum() ? FixedLimits<T>::maximum() : (T)_raw), true);
+    }
+
+    /*
+     * From whole units (e.g. degrees).
+     */
+    static constexpr Fixed fromUnits(Wider _units) {
+      return saturate(_units * Scale);
+    }
+
+    static constexpr Fixed invalid() {
+      return Fixed();
+    }
+
+    static constexpr long scale() {
+      return Scale;
+    }
+
+    constexpr bool isValid() const {
+      return value != FixedLimits<T>::invalid();
+    }
+
+    constexpr T raw() const {
+      return value;
+    }
+
+    /*
+     * Saturating arithmetic, invalid if either operand is.
+     */
+    constexpr Fixed operator+(Fixed _other) const {
+      return isValid() && _other.isValid() ? saturate((Wider)value + _other.value) : invalid();
+    }
+
+    constexpr Fixed operator-(Fixed _other) const {
+      return isValid() && _other.isValid() ? saturate((Wider)value - _other.value) : invalid();
+    }
+
+    constexpr Fixed operator-() const {
+      return isValid() ? Fixed(-value, true) : invalid();
+    }
+
+    /*
+     * Divided by a positive integer, truncated towards zero.
+     */
+    constexpr Fixed operator/(T _divisor) const {
+      return isValid() ? Fixed(value / _divisor, true) : invalid();
+    }
+
+    Fixed & operator+=(Fixed _other) {
+      return *this = *this + _other;
+    }
+
+    Fixed & operator-=(Fixed _other) {
+      return *this = *this - _other;
+    }
+
+    constexpr bool operator==(Fixed _other) const { return value == _other.value; }
+    constexpr bool operator!=(Fixed _other) const { return value != _other.value; }
+    constexpr bool operator<(Fixed _other) const { return value < _other.value; }
+    constexpr bool operator>(Fixed _other) const { return value > _other.value; }
+    constexpr bool operator<=(Fixed _other) const { return value <= _other.value; }
+    constexpr bool operator>=(Fixed _other) const { return value >= _other.value; }
+
+    /*
+     * The same value in a wider type.
+     */
+    template<typename W>
+    constexpr Fixed<W, Scale> widen() const {
+      static_assert(sizeof(W) > sizeof(T), "widen() needs a wider type");
+      return isValid() ? Fixed<W, Scale>::fromRaw(value) : Fixed<W, Scale>::invalid();
+    }
+
+    /*
+     * The value in a narrower type, clipped to its limits.
+     */
+    template<typename N>
+    constexpr Fixed<N, Scale> narrow() const {
+      static_assert(sizeof(N) < sizeof(T), "narrow() needs a narrower type");
+      return isValid() ? Fixed<N, Scale>::saturate(value) : Fixed<N, Scale>::invalid();
+    }
+
+    /*
+     * The value in another scale, one scale must be a multiple of the
+     * other. Going down is a division in the width of the type, rounded
+     * half away from zero.
+     */
+    template<long S>
+    constexpr Fixed<T, S> rescale() const {
+      static_assert(Scale % S == 0 || S % Scale == 0, "Scales must be multiples");
+      return !isValid() ? Fixed<T, S>::invalid()
+        : (S <= Scale ? Fixed<T, S>::fromRaw(roundedQuotient(value / factor(S), value % factor(S), factor(S)))
+                      : Fixed<T, S>::saturate((Wider)value * factor(S)));
+    }
+
+  private:
+    T value;
+
+    constexpr Fixed(T _value, bool) : value(_value) {}
+
+    /*
+     * Ratio between this scale and another one (at least 1).
+     */
+    static constexpr T factor(long _scale) {
+      return _scale <= Scale ? Scale / _scale : _scale / Scale;
+    }
+
+    /*
+     * Round a quotient by its remainder, without overflowing.
+     */
+    static constexpr T roundedQuotient(T _quotient, T _remainder, T _divisor) {
+      return _remainder > 0 && _remainder >= _divisor - _remainder ? _quotient + 1
+        : (_remainder < 0 && -_remainder >= _divisor + _remainder ? _quotient - 1 : _quotient);
+    }
+};
+
+/*
+ * Product of two 16 bit values. Both are widened explicitly, so the AVR
+ * uses its 16 x 16 -> 32 bit multiply instead of a full 32 bit one.
+ */
+inline int32_t multiplyWide(int16_t _a, uint16_t _b) {
+  return (int32_t)_a * (int32_t)_b;
+}
+
+/*
+ * Temperatures and temperature differences
+ */
+typedef Fixed<int16_t, 100> Centidegrees;
+
+#endif
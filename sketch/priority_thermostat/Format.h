@@ -0,0 +1,228 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+#ifndef _FORMAT_H_
+#define _FORMAT_H_
+
+#include <Arduino.h>
+
+/*
+ * Number of trailing decimal zeros of a value (compile time).
+ */
+constexpr byte trailingZeros(unsigned long _value) {
+  return (_value != 0 && _value % 10 == 0) ? 1 + trailingZeros(_value / 10) : 0;
+}
+
+/*
+ * 10 to the power n (compile time).
+ */
+constexpr unsigned long powerOfTen(byte _n) {
+  return _n == 0 ? 1 : 10 * powerOfTen(_n - 1);
+}
+
+/*
+ * Formats text and numbers into a field of Width characters, without
+ * printf. Whatever doesn't fit in the field is dropped, the field is not
+ * terminated (the caller owns the layout, e.g. a line of the LCD that is
+ * filled with spaces). Calls can be chained:
+ *
+ *   FieldWriter<20> line(buffer);
+ *   line.text("Time: ").hoursMinutesSeconds(time);
+ */
+template<byte Width>
+class FieldWriter {
+  public:
+    FieldWriter(char * _field);
+    FieldWriter & text(const char * _text);
+    FieldWriter & character(char _character);
+    FieldWriter & column(byte _column);
+    FieldWriter & number(long _value, byte _digits = 1);
+    template<byte Decimals, unsigned int Step>
+    FieldWriter & fixed(long _value);
+    FieldWriter & hoursMinutes(unsigned long _millis);
+    FieldWriter & hoursMinutesSeconds(unsigned long _millis);
+    byte getLength();
+
+  private:
+    char * field;
+    byte position;
+
+    void digits(unsigned long _value, byte _digits);
+};
+
+/*
+ * Constructor, the field starts at the given position.
+ */
+template<byte Width>
+FieldWriter<Width>::FieldWriter(char * _field) {
+  field = _field;
+  position = 0;
+}
+
+/*
+ * Append a string.
+ */
+template<byte Width>
+FieldWriter<Width> & FieldWriter<Width>::text(const char * _text) {
+  while(*_text != '\0' && position < Width) {
+    field[position++] = *_text++;
+  }
+  return *this;
+}
+
+/*
+ * Append a single character.
+ */
+template<byte Width>
+FieldWriter<Width> & FieldWriter<Width>::character(char _character) {
+  if(position < Width) {
+    field[position++] = _character;
+  }
+  return *this;
+}
+
+/*
+ * Continue at a column, skipped positions are left as they are.
+ */
+template<byte Width>
+FieldWriter<Width> & FieldWriter<Width>::column(byte _column) {
+  position = _column < Width ? _column : Width;
+  return *this;
+}
+
+/*
+ * Append an integer, zero padded to at least the given number of digits.
+ */
+template<byte Width>
+FieldWriter<Width> & FieldWriter<Width>::number(long _value, byte _digits) {
+  if(_value < 0) {
+    character('-');
+    digits(-(unsigned long)_value, _digits);
+  } else {
+    digits(_value, _digits);
+  }
+  return *this;
+}
+
+/*
+ * Append a fixed point number with Decimals decimals (e.g. centi-degrees
+ * have 2), rounded to the nearest multiple of Step. The decimals that are
+ * always zero after rounding are not printed: fixed<2, 50> prints 4230 as
+ * 42.5 and fixed<1, 1> prints 123 as 12.3. Halfway values are rounded
+ * away from zero.
+ */
+template<byte Width>
+template<byte Decimals, unsigned int Step>
+FieldWriter<Width> & FieldWriter<Width>::fixed(long _value) {
+  static_assert(Step > 0, "Step must be positive");
+  static_assert(trailingZeros(Step) <= Decimals, "Step must be below 1");
+  const byte shown = Decimals - trailingZeros(Step);
+  const unsigned long unit = powerOfTen(Decimals - shown);
+  const unsigned long scale = powerOfTen(shown);
+
+  unsigned long magnitude = _value < 0 ? -(unsigned long)_value : _value;
+  if(magnitude <= 0xFFFFU - Step / 2) {
+    // 16 bit divisions for everything that fits (e.g. temperatures)
+    unsigned int small = magnitude;
+    magnitude = (small + Step / 2) / Step * Step / (unsigned int)unit;
+  } else {
+    magnitude = (magnitude + Step / 2) / Step * Step / unit;
+  }
+  if(_value < 0 && magnitude != 0) {
+    character('-');
+  }
+  digits(magnitude / scale, 1);
+  if(shown > 0) {
+    character('.');
+    digits(magnitude % scale, shown);
+  }
+  return *this;
+}
+
+/*
+ * Append a duration as hours and minutes: 2h05'
+ */
+template<byte Width>
+FieldWriter<Width> & FieldWriter<Width>::hoursMinutes(unsigned long _millis) {
+  unsigned long minutes = _millis / 60000UL;
+  digits(minutes / 60, 1);
+  character('h');
+  digits(minutes % 60, 2);
+  character('\'');
+  return *this;
+}
+
+/*
+ * Append a duration as hours, minutes and seconds: 2h05'09"
+ */
+template<byte Width>
+FieldWriter<Width> & FieldWriter<Width>::hoursMinutesSeconds(unsigned long _millis) {
+  unsigned long seconds = _millis / 1000UL;
+  unsigned int rest = seconds % 3600;
+  digits(seconds / 3600, 1);
+  character('h');
+  digits(rest / 60, 2);
+  character('\'');
+  digits(rest % 60, 2);
+  character('"');
+  return *this;
+}
+
+/*
+ * Number of characters written so far.
+ */
+template<byte Width>
+byte FieldWriter<Width>::getLength() {
+  return position;
+}
+
+/*
+ * Append the decimal digits of a value, zero padded. Values that fit in
+ * 16 bits use 16 bit divisions, which are a lot cheaper on the AVR.
+ */
+template<byte Width>
+void FieldWriter<Width>::digits(unsigned long _value, byte _digits) {
+  char reversed[10];
+  byte count = 0;
+  while(_value > 0xFFFFUL) {
+    reversed[count++] = '0' + _value % 10;
+    _value /= 10;
+  }
+  unsigned int small = _value;
+  while(small > 0 || count < _digits) {
+    reversed[count++] = '0' + small % 10;
+    small /= 10;
+    if(count == sizeof(reversed)) {
+      break;
+    }
+  }
+  while(count > 0) {
+    character(reversed[--count]);
+  }
+}
+
+#endif
@@ -27,6 +27,10 @@
 
 #include "Functions.h"
 
+#ifdef __AVR__
+#include <util/crc16.h>
+#endif
+
 /*
  * Helper function for calculating the difference between two unsigned longs
  * while taking a wrap around into account.
@@ -39,3 +43,25 @@ unsigned long diffUL(unsigned long _low, unsigned long _high) {
   return _high - _low;
 }
 
+/*
+ * Helper function for comparing two timestamps while taking a wrap around
+ * into account: true if _a comes before _b (less than 24 days apart).
+ */
+bool beforeUL(unsigned long _a, unsigned long _b) {
+  return (long)(_a - _b) < 0;
+}
+
+/*
+ * Add a byte to a CRC-16/CCITT-FALSE.
+ */
+uint16_t crc16Update(uint16_t _crc, byte _value) {
+#ifdef __AVR__
+  return _crc_xmodem_update(_crc, _value);
+#else
+  _crc ^= (uint16_t)_value << 8;
+  for(byte i=0; i<8; ++i) {
+    _crc = (_crc & 0x8000) ? (_crc << 1) ^ 0x1021 : _crc << 1;
+  }
+  return _crc;
+#endif
+}
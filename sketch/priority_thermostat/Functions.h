@@ -28,6 +28,10 @@
 #ifndef _FUNCTIONS_H_
 #define _FUNCTIONS_H_
 
+#include <Arduino.h>
+
 unsigned long diffUL(unsigned long, unsigned long);
+bool beforeUL(unsigned long, unsigned long);
+uint16_t crc16Update(uint16_t _crc, byte _value);
 
 #endif
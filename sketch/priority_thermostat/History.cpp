@@ -0,0 +1,281 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+
+#include "History.h"
+#include "Functions.h"
+
+// Capacity of the ring in nibbles
+#define HISTORY_NIBBLES (HISTORY_BYTES * 2)
+
+// Codes (see History.h)
+#define HISTORY_RUN_MAX      0x07
+#define HISTORY_STEP         0x08
+#define HISTORY_TOGGLE       0x0C
+#define HISTORY_DELTA        0x0D
+#define HISTORY_TOGGLE_DELTA 0x0E
+#define HISTORY_MORE         0x08
+
+/*
+ * Constructor
+ */
+History::History() {
+  head = 0;
+  used = 0;
+  samples = 0;
+  baseValue = 0;
+  baseRelay = false;
+  lastValue = 0;
+  lastRelay = false;
+  lastRun = 0;
+  runOpen = false;
+  generation = 0;
+
+  started = false;
+  lastSample = 0;
+  relayInPeriod = false;
+}
+
+/*
+ * Keep track of the relay and add a sample every HISTORY_PERIOD ms.
+ * (called by the control task). The sample holds the temperature at the
+ * end of the period and whether the relay was on at any time during it.
+ * Periods without a temperature (invalid) are skipped.
+ */
+void History::update(unsigned long _millis, Centidegrees _temperature, bool _relay) {
+  if(!started) {
+    started = true;
+    lastSample = _millis;
+    relayInPeriod = _relay;
+    return;
+  }
+
+  relayInPeriod = relayInPeriod || _relay;
+  if(diffUL(lastSample, _millis) < HISTORY_PERIOD) {
+    return;
+  }
+  lastSample += HISTORY_PERIOD;
+
+  if(_temperature.isValid()) {
+    add(_temperature.rescale<HistoryTemperature::scale()>().raw(), relayInPeriod);
+  }
+  relayInPeriod = _relay;
+}
+
+/*
+ * Encode a sample (temperature in steps of HISTORY_RESOLUTION).
+ */
+void History::add(int _value, bool _relay) {
+  // The first code after an empty ring is a run, the base is its sample
+  if(used == 0) {
+    baseValue = lastValue = _value;
+    baseRelay = lastRelay = _relay;
+    runOpen = false;
+  }
+
+  int delta = _value - lastValue;
+  bool toggle = _relay != lastRelay;
+  if(delta == 0 && !toggle) {
+    if(runOpen && read(lastRun) < HISTORY_RUN_MAX) {
+      write(lastRun, read(lastRun) + 1);
+    } else {
+      reserve(1);
+      lastRun = head;
+      runOpen = true;
+      append(0);
+    }
+  } else if(!toggle && delta >= -2 && delta <= 2) {
+    reserve(1);
+    runOpen = false;
+    append(HISTORY_STEP | (delta < 0 ? delta + 2 : delta + 1));
+  } else if(delta == 0) {
+    reserve(1);
+    runOpen = false;
+    append(HISTORY_TOGGLE);
+  } else {
+    unsigned int zigzag = delta < 0 ? ((unsigned int)-delta << 1) - 1 : (unsigned int)delta << 1;
+    byte length = 2;
+    for(unsigned int rest = zigzag >> 3; rest != 0; rest >>= 3) {
+      ++length;
+    }
+    reserve(length);
+    runOpen = false;
+    append(toggle ? HISTORY_TOGGLE_DELTA : HISTORY_DELTA);
+    do {
+      byte nibble = zigzag & 0x07;
+      zigzag >>= 3;
+      append(zigzag != 0 ? nibble | HISTORY_MORE : nibble);
+    } while(zigzag != 0);
+  }
+
+  lastValue = _value;
+  lastRelay = _relay;
+  ++samples;
+  ++generation;
+}
+
+/*
+ * Make room for a code of _nibbles nibbles, dropping the oldest codes into
+ * the base state.
+ */
+void History::reserve(byte _nibbles) {
+  while(HISTORY_NIBBLES - used < _nibbles) {
+    history_cursor_t cursor;
+    rewind(cursor);
+    samples -= decode(cursor);
+    baseValue = cursor.value;
+    baseRelay = cursor.relay;
+    used = cursor.left;
+  }
+  if(used == 0) {
+    runOpen = false;
+  }
+}
+
+/*
+ * Start reading at the oldest sample.
+ */
+void History::rewind(history_cursor_t & _cursor) {
+  _cursor.position = (head + HISTORY_NIBBLES - used) % HISTORY_NIBBLES;
+  _cursor.left = used;
+  _cursor.value = baseValue;
+  _cursor.relay = baseRelay;
+  _cursor.repeats = 0;
+}
+
+/*
+ * Move the cursor to the next sample, returns false at the end. The
+ * sample is in the value (see toTemperature()) and relay of the cursor.
+ */
+bool History::next(history_cursor_t & _cursor) {
+  if(_cursor.repeats > 0) {
+    --_cursor.repeats;
+    return true;
+  }
+  if(_cursor.left == 0) {
+    return false;
+  }
+  _cursor.repeats = decode(_cursor) - 1;
+  return true;
+}
+
+/*
+ * Apply the code at the cursor to its state, returns the number of
+ * samples in the code.
+ */
+byte History::decode(history_cursor_t & _cursor) {
+  byte code = take(_cursor);
+  if(code <= HISTORY_RUN_MAX) {
+    return code + 1;
+  }
+  if(code < HISTORY_TOGGLE) {
+    byte step = code & 0x03;
+    _cursor.value += step < 2 ? (int)step - 2 : (int)step - 1;
+    return 1;
+  }
+  if(code == HISTORY_TOGGLE || code == HISTORY_TOGGLE_DELTA) {
+    _cursor.relay = !_cursor.relay;
+  }
+  if(code == HISTORY_DELTA || code == HISTORY_TOGGLE_DELTA) {
+    unsigned int zigzag = 0;
+    byte shift = 0;
+    byte nibble;
+    do {
+      nibble = take(_cursor);
+      zigzag |= (unsigned int)(nibble & 0x07) << shift;
+      shift += 3;
+    } while((nibble & HISTORY_MORE) && _cursor.left > 0);
+    int magnitude = zigzag >> 1;
+    _cursor.value += (zigzag & 1) ? -magnitude - 1 : magnitude;
+  }
+  return 1;
+}
+
+/*
+ * Read the nibble at the cursor and move on.
+ */
+byte History::take(history_cursor_t & _cursor) {
+  byte nibble = read(_cursor.position);
+  _cursor.position = (_cursor.position + 1) % HISTORY_NIBBLES;
+  --_cursor.left;
+  return nibble;
+}
+
+/*
+ * Convert the value of a sample to centi-degrees.
+ */
+Centidegrees History::toTemperature(int _value) {
+  return HistoryTemperature::fromRaw(_value).rescale<Centidegrees::scale()>();
+}
+
+/*
+ * Number of samples in the ring.
+ */
+unsigned int History::getSamples() {
+  return samples;
+}
+
+/*
+ * Number of nibbles in use.
+ */
+unsigned int History::getUsed() {
+  return used;
+}
+
+/*
+ * Generation counter: changes whenever a sample is added, cursors have to
+ * be rewound then.
+ */
+byte History::getGeneration() {
+  return generation;
+}
+
+/*
+ * Add a nibble at the head.
+ */
+void History::append(byte _nibble) {
+  write(head, _nibble);
+  head = (head + 1) % HISTORY_NIBBLES;
+  ++used;
+}
+
+/*
+ * Nibble access, the high nibble of a byte comes first.
+ */
+byte History::read(unsigned int _position) {
+  byte value = data[_position >> 1];
+  return (_position & 1) ? value & 0x0F : value >> 4;
+}
+
+void History::write(unsigned int _position, byte _nibble) {
+  byte & value = data[_position >> 1];
+  if(_position & 1) {
+    value = (value & 0xF0) | _nibble;
+  } else {
+    value = (value & 0x0F) | (_nibble << 4);
+  }
+}
@@ -0,0 +1,114 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+
+#ifndef _HISTORY_H_
+#define _HISTORY_H_
+
+#include <Arduino.h>
+#include "MagicNumbers.h"
+#include "Fixed.h"
+
+/*
+ * Temperature and relay history in a ring of HISTORY_BYTES bytes: every
+ * HISTORY_PERIOD ms. the temperature (in steps of HISTORY_RESOLUTION
+ * centi-degrees) and whether the relay was on during the period are
+ * added. Samples are delta encoded in nibbles, the tank temperature
+ * hardly moves from one minute to the next, so most samples take half a
+ * byte or less:
+ *
+ *   0nnn           n + 1 samples without change (runs grow in place)
+ *   10dd           temperature -2, -1, +1 or +2 steps
+ *   1100           relay toggled, same temperature
+ *   1101 varint    temperature changed by more
+ *   1110 varint    relay toggled and temperature changed
+ *
+ * The varint is the zigzag encoded change, 3 bits per nibble, least
+ * significant first, the high bit is set when more nibbles follow.
+ *
+ * When the ring is full the oldest codes are dropped; they are decoded
+ * into the base state (the sample before the oldest code), so the
+ * remaining codes can still be decoded from the start.
+ *
+ * Readers keep their position in a history_cursor_t and decode one
+ * sample at a time, so the history can be read in small steps. A cursor
+ * becomes invalid when samples are added, see getGeneration().
+ */
+/*
+ * The samples, in steps of HISTORY_RESOLUTION centi-degrees
+ */
+static_assert(100 % HISTORY_RESOLUTION == 0, "HISTORY_RESOLUTION must divide a degree");
+typedef Fixed<int16_t, 100 / HISTORY_RESOLUTION> HistoryTemperature;
+
+typedef struct history_cursor {
+  unsigned int position;
+  unsigned int left;
+  int value;
+  bool relay;
+  byte repeats;
+} history_cursor_t;
+
+class History {
+  public:
+    History();
+    void update(unsigned long _millis, Centidegrees _temperature, bool _relay);
+
+    void rewind(history_cursor_t & _cursor);
+    bool next(history_cursor_t & _cursor);
+    Centidegrees toTemperature(int _value);
+
+    unsigned int getSamples();
+    unsigned int getUsed();
+    byte getGeneration();
+
+  private:
+    byte data[HISTORY_BYTES];
+    unsigned int head;
+    unsigned int used;
+    unsigned int samples;
+    int baseValue;
+    bool baseRelay;
+    int lastValue;
+    bool lastRelay;
+    unsigned int lastRun;
+    bool runOpen;
+    byte generation;
+
+    bool started;
+    unsigned long lastSample;
+    bool relayInPeriod;
+
+    void add(int _value, bool _relay);
+    void append(byte _nibble);
+    void reserve(byte _nibbles);
+    byte decode(history_cursor_t & _cursor);
+    byte take(history_cursor_t & _cursor);
+    byte read(unsigned int _position);
+    void write(unsigned int _position, byte _nibble);
+};
+
+#endif
@@ -26,72 +26,62 @@
  */
 
 #include "Interface.h"
-#include <stdlib.h>
 #include "Functions.h"
 
+// Increments per repeat stage of a held button (see REPEAT_STEP_TABLE)
+static const byte repeatSteps[][BUTTON_REPEAT_STAGES] PROGMEM = REPEAT_STEP_TABLE;
+static_assert(sizeof(repeatSteps) / sizeof(repeatSteps[0]) == NUMBER_MENU_ITEMS + 1,
+              "One row of repeat steps per menu item and the requested temperature");
+
 /*
- * Helper function for formating and rouding temperatures
+ * Helper function for formating and rounding temperatures
  */
-char * formatTemperature(char * _buffer, long _temperature) {
-  if(_temperature == UNDEF) {
-    sprintf(_buffer, "-");
-    return _buffer;
-  }
-  
-  // Do the math
-  int integer = _temperature / 100;
-  int decimal = _temperature % 100;
-  if(decimal < 25) {
-    decimal = 0;
-  } else if(decimal >= 25 && decimal < 50) {
-    decimal = 5;
-  } else if(decimal >= 50 && decimal < 75) {
-    decimal = 5;
-  } else {
-    ++integer;
-    decimal = 0;
+void formatTemperature(LineWriter & _line, Centidegrees _temperature) {
+  if(!_temperature.isValid()) {
+    _line.character('-');
+    return;
   }
-
-  // Format
-  sprintf(_buffer, "%d.%d%cC", integer, decimal, (char)223);
-  return _buffer;
+  _line.fixed<2, TEMPERATURE_DISPLAY_STEP>(_temperature.raw()).character((char)223).character('C');
 }
 
 /*
- * Helper function for formatting time (limited to minutes)
+ * Helper functions for the accounting counters: burner hours and heat
+ * cycles, energy (kWh) and alarms
  */
-char * formatTimeM(char * _buffer, unsigned long _time) {
-  // Do the math
-  _time /= 1000; // convert milliseconds to seconds
-  int hours = _time / 3600;
-  int minutes = (_time % 3600) / 60;
+void formatUsage(LineWriter & _line, const accounting_counters_t * _counters) {
+  _line.number(_counters->heatSeconds / 3600).text("h ").number(_counters->cycles).character('c');
+}
 
-  // Format
-  sprintf(_buffer, "%dh%02d'", hours, minutes);
-  return _buffer;
+void formatEnergy(LineWriter & _line, const accounting_counters_t * _counters, unsigned int _alarms) {
+  _line.number(_counters->energy / 1000).text("kWh ").number(_alarms).text("al");
 }
 
 /*
- * Helper function for formatting time (limited to seconds)
+ * Helper function for stepping a parameter within its limits
  */
-char * formatTimeS(char * _buffer, unsigned long _time) {
-  // Do the math
-  _time /= 1000; // convert milliseconds to seconds
-  int hours = _time / 3600;
-  int rest = _time % 3600;
-  int minutes = rest / 60;
-  int seconds = rest % 60;
+long stepValue(long _value, long _step, long _minimum, long _maximum) {
+  _value += _step;
+  if(_value < _minimum) {
+    return _minimum;
+  }
+  if(_value > _maximum) {
+    return _maximum;
+  }
+  return _value;
+}
 
-  // Format
-  sprintf(_buffer, "%dh%02d'%02d\"", hours, minutes, seconds);
-  return _buffer;
+/*
+ * Helper function for stepping a temperature parameter within its limits
+ */
+Centidegrees stepTemperature(Centidegrees _value, long _step, long _minimum, long _maximum) {
+  return Centidegrees::saturate(stepValue(_value.raw(), _step, _minimum, _maximum));
 }
 
 /*
- * Helper function for getting a pointer to the end of a string
+ * Helper function for combining the inputs of a line into a single key
  */
-char * appendPtr(char * _str) {
-  return &_str[strlen(_str)];
+unsigned long lineKey(byte _a, byte _b, byte _c, byte _d) {
+  return ((unsigned long)_a << 24) | ((unsigned long)_b << 16) | ((unsigned int)_c << 8) | _d;
 }
 
 /*
@@ -99,15 +89,47 @@ char * appendPtr(char * _str) {
  */
 Interface::Interface(LiquidCrystal * _lcd, 
                      AnalogButtons<NUMBER_OF_BUTTONS> * _buttons,
-                     Thermostat * _thermostat) {
+                     Thermostat * _thermostat,
+                     Power * _power,
+                     Accounting * _accounting,
+                     History * _history)
+  : sparkline(_history) {
   lcd = _lcd;
   buttons = _buttons;
   thermostat = _thermostat;
+  power = _power;
+  accounting = _accounting;
 
   inMenu = false;
+  inHistory = false;
+  inSetMode = false;
   menuPosition = 0;
+  calibrationTemperature = Centidegrees::fromRaw(DEFAULT_REQUESTED_TEMPERATURE);
+  calibrationResult = CALIBRATION_RESULT_NONE;
+  tripReset = false;
+#if PROFILING
+  inDiagnostics = false;
+  diagnosticStage = 0;
+#endif
   resetMode = RESET_NO;
-  lastLcdReset = 0;
+  zoneAlarms = 0;
+  frameTransactions = 0;
+  busTransactions = 0;
+  screen = SCREEN_STATUS;
+  linesValid = 0;
+  linesDirty = 0;
+  recomposedLines = 0;
+  recomposedPerSecond = 0;
+  recomposeWindowStart = 0;
+  windowTransactions = 0;
+  peakTransactions = 0;
+  statisticsGeneration = 0;
+  setpointGeneration = 0;
+  menuGeneration = 0;
+  setModeGeneration = 0;
+  parameterGeneration = 0;
+  thermostatGeneration = thermostat->getParameterGeneration();
+  clearShadow();
   loadParameters();
 }
 
@@ -121,11 +143,41 @@ void Interface::interact() {
  * Manage interaction (menu's and thermostat)
  */
 void Interface::interact(unsigned long _millis) {
-  if(inMenu) {
+  bool previousMenu = inMenu;
+  byte previousPosition = menuPosition;
+  bool previousSetMode = inSetMode;
+  Centidegrees previousRequested = requestedTemperature;
+
+  // Pick up parameters that were changed elsewhere (command channel),
+  // unless they are being edited here
+  if(thermostat->getParameterGeneration() != thermostatGeneration && !inSetMode) {
+    thermostatGeneration = thermostat->getParameterGeneration();
+    loadParameters();
+  }
+
+#if PROFILING
+  if(inDiagnostics) {
+    interactDiagnosticsScreen(_millis);
+  } else
+#endif
+  if(inHistory) {
+    interactHistoryScreen(_millis);
+  } else if(inMenu) {
     interactMenuScreen(_millis);
   } else {
     interactStatusScreen(_millis);
   }
+
+  // Keep track of what changed
+  if(inMenu != previousMenu || menuPosition != previousPosition) {
+    ++menuGeneration;
+  }
+  if(inSetMode != previousSetMode) {
+    ++setModeGeneration;
+  }
+  if(requestedTemperature != previousRequested) {
+    ++setpointGeneration;
+  }
 }
 
 /*
@@ -139,13 +191,49 @@ void Interface::render() {
  * Render content on LCD.
  */
 void Interface::render(unsigned long _millis) {
-   if(inMenu) {
+  // Recomposed lines per second and the largest frame
+  unsigned long elapsed = diffUL(recomposeWindowStart, _millis);
+  if(elapsed >= 1000) {
+    recomposedPerSecond = recomposedLines * 1000UL / elapsed;
+    recomposedLines = 0;
+    peakTransactions = windowTransactions;
+    windowTransactions = 0;
+    recomposeWindowStart = _millis;
+    ++statisticsGeneration;
+  }
+
+#if PROFILING
+  if(inDiagnostics) {
+    selectScreen(SCREEN_DIAGNOSTICS);
+    renderDiagnosticsScreen(_millis);
+    return;
+  }
+#endif
+  if(inMenu && inSetMode && menuPosition == MENU_CALIBRATION) {
+    selectScreen(SCREEN_CALIBRATION);
+    renderCalibrationScreen(_millis);
+  } else if(inHistory) {
+    selectScreen(SCREEN_HISTORY);
+    renderHistoryScreen(_millis);
+  } else if(inMenu) {
+    selectScreen(SCREEN_MENU);
     renderMenuScreen(_millis);
   } else {
+    selectScreen(SCREEN_STATUS);
     renderStatusScreen(_millis);
   }
 }
 
+/*
+ * Reinitialize the LCD (recovers from glitches on the bus), called every
+ * LCD_RESET ms. by the scheduler.
+ */
+void Interface::resetLcd(unsigned long _millis) {
+  lcd->begin(LCD_COLUMNS, LCD_ROWS);
+  clearShadow();
+  sparkline.invalidate();
+}
+
 /*
  * Return the selected reset mode
  */
@@ -153,6 +241,55 @@ int Interface::getResetMode() {
   return inSetMode ? RESET_NO : resetMode;
 }
 
+/*
+ * Zones in alarm (one bit per zone, see Zones.h), shown on the status
+ * screen unless the thermostat is in alarm itself.
+ */
+void Interface::setZoneAlarms(byte _zones) {
+  zoneAlarms = _zones;
+}
+
+/*
+ * Number of LCD bus transactions (cursor moves and characters) of the
+ * last frame.
+ */
+unsigned int Interface::getFrameTransactions() {
+  return frameTransactions;
+}
+
+/*
+ * Total number of LCD bus transactions.
+ */
+unsigned long Interface::getBusTransactions() {
+  return busTransactions;
+}
+
+/*
+ * Number of screen lines recomposed per second.
+ */
+unsigned int Interface::getRecomposedLines() {
+  return recomposedPerSecond;
+}
+
+/*
+ * Generation counters of the interface state
+ */
+byte Interface::getSetpointGeneration() {
+  return setpointGeneration;
+}
+
+byte Interface::getMenuGeneration() {
+  return menuGeneration;
+}
+
+byte Interface::getSetModeGeneration() {
+  return setModeGeneration;
+}
+
+byte Interface::getParameterGeneration() {
+  return parameterGeneration;
+}
+
 /*
  * Load all thermostat parameters (thermostat -> interface)
  */
@@ -164,7 +301,17 @@ void Interface::loadParameters() {
     maximumHeatTime = thermostat->getMaxHeatTime();
     graceTime = thermostat->getGraceTime();
     offsetTemperature = thermostat->getOffsetTemperature();
-    serialEnabled = thermostat->getSerialEnabled();
+    oversampling = thermostat->getOversampling();
+    serialMode = thermostat->getSerialMode();
+    burnerPower = accounting->getBurnerPower();
+    controlMode = thermostat->getControlMode();
+    pidGain = thermostat->getPidGain();
+    pidIntegralTime = thermostat->getPidIntegralTime();
+    pidDerivativeTime = thermostat->getPidDerivativeTime();
+    pidWindow = thermostat->getPidWindow();
+    pidMinimumPulse = thermostat->getPidMinimumPulse();
+    tripReset = false;
+    ++parameterGeneration;
   } else {
     requestedTemperature = thermostat->getRequestedTemperature();
   }
@@ -181,7 +328,19 @@ void Interface::saveParameters() {
     thermostat->setMaxHeatTime(maximumHeatTime);
     thermostat->setGraceTime(graceTime);
     thermostat->setOffsetTemperature(offsetTemperature);
-    thermostat->setSerialEnabled(serialEnabled);
+    thermostat->setOversampling(oversampling);
+    thermostat->setSerialMode(serialMode);
+    accounting->setBurnerPower(burnerPower);
+    thermostat->setControlMode(controlMode);
+    thermostat->setPidGain(pidGain);
+    thermostat->setPidIntegralTime(pidIntegralTime);
+    thermostat->setPidDerivativeTime(pidDerivativeTime);
+    thermostat->setPidWindow(pidWindow);
+    thermostat->setPidMinimumPulse(pidMinimumPulse);
+    if(tripReset) {
+      accounting->resetTrip();
+      tripReset = false;
+    }
   } else {
     thermostat->setRequestedTemperature(requestedTemperature);
   }
@@ -196,22 +355,26 @@ void Interface::processParameterIncrement(int _multiplier) {
   if(inMenu) {
     switch(menuPosition) {
       case 0:
-        hysteresis += INCR_HYSTERESIS * _multiplier;
+        hysteresis = stepTemperature(hysteresis, INCR_HYSTERESIS * _multiplier, 0, MAX_HYSTERESIS);
         break;
       case 1:
-        minimumTemperature += INCR_MIN_TEMPERATURE * _multiplier;
+        minimumTemperature = stepTemperature(minimumTemperature, INCR_MIN_TEMPERATURE * _multiplier,
+                                             MIN_MIN_TEMPERATURE, MAX_MIN_TEMPERATURE);
         break;
       case 2:
-        maximumTemperature += INCR_MAX_TEMPERATURE * _multiplier;
+        maximumTemperature = stepTemperature(maximumTemperature, INCR_MAX_TEMPERATURE * _multiplier,
+                                             0, MAX_MAX_TEMPERATURE);
         break;
       case 3:
-        maximumHeatTime += INCR_MAX_HEAT_TIME * _multiplier;
+        maximumHeatTime = stepValue(maximumHeatTime, INCR_MAX_HEAT_TIME * _multiplier,
+                                    MIN_HEAT_TIME, MAX_HEAT_TIME);
         break;
       case 4:
-        graceTime += INCR_GRACE_TIME * _multiplier;
+        graceTime = stepValue(graceTime, INCR_GRACE_TIME * _multiplier, 0, MAX_GRACE_TIME);
         break;
       case 5:
-        offsetTemperature += INCR_OFFSET_TEMPERATURE * _multiplier;
+        offsetTemperature = stepTemperature(offsetTemperature, INCR_OFFSET_TEMPERATURE * _multiplier,
+                                            MIN_OFFSET_TEMPERATURE, MAX_OFFSET_TEMPERATURE);
         break;
       case 6:
         resetMode = (resetMode + _multiplier) % 3;
@@ -220,11 +383,64 @@ void Interface::processParameterIncrement(int _multiplier) {
         }
         break;
       case 7:
-        serialEnabled = !serialEnabled;
+        serialMode = (serialMode + TELEMETRY_MODES + _multiplier) % TELEMETRY_MODES;
+        break;
+      case 9:
+        oversampling = (oversampling + MAX_OVERSAMPLING + 1 + _multiplier) % (MAX_OVERSAMPLING + 1);
+        break;
+      case MENU_TRIP:
+        tripReset = !tripReset;
+        break;
+      case MENU_BURNER_POWER: {
+        long value = (long)burnerPower + (long)INCR_BURNER_POWER * _multiplier;
+        if(value < 0) {
+          value = 0;
+        } else if(value > MAX_BURNER_POWER) {
+          value = MAX_BURNER_POWER;
+        }
+        burnerPower = value;
+        break;
+      }
+      case MENU_CONTROL:
+        controlMode = (controlMode + CONTROL_MODES + _multiplier) % CONTROL_MODES;
+        break;
+      case MENU_PID_GAIN:
+        pidGain = stepValue(pidGain, INCR_PID_GAIN * _multiplier, 0, MAX_PID_GAIN);
+        break;
+      case MENU_PID_INTEGRAL:
+        pidIntegralTime = stepValue(pidIntegralTime, INCR_PID_INTEGRAL_TIME * _multiplier,
+                                    0, MAX_PID_INTEGRAL_TIME);
+        break;
+      case MENU_PID_DERIVATIVE:
+        pidDerivativeTime = stepValue(pidDerivativeTime, INCR_PID_DERIVATIVE_TIME * _multiplier,
+                                      0, MAX_PID_DERIVATIVE_TIME);
+        break;
+      case MENU_PID_WINDOW:
+        // The pulse follows, it can be half the window at most
+        pidWindow = stepValue(pidWindow, INCR_PID_WINDOW * _multiplier, MIN_PID_WINDOW, MAX_PID_WINDOW);
+        pidMinimumPulse = stepValue(pidMinimumPulse, 0, 0, pidWindow / 2);
+        break;
+      case MENU_PID_PULSE:
+        pidMinimumPulse = stepValue(pidMinimumPulse, INCR_PID_MINIMUM_PULSE * _multiplier,
+                                    0, pidWindow / 2);
         break;
     }
+    ++parameterGeneration;
   } else {
-    requestedTemperature += INCR_REQUESTED_TEMPERATURE * _multiplier;
+    requestedTemperature = stepTemperature(requestedTemperature, INCR_REQUESTED_TEMPERATURE * _multiplier,
+                                           MIN_REQUESTED_TEMPERATURE, MAX_REQUESTED_TEMPERATURE);
+  }
+}
+
+/*
+ * Process a repeat of a held increase or decrease button, the step grows
+ * with the repeat stage (see REPEAT_STEP_TABLE).
+ */
+void Interface::processParameterRepeat(int _direction) {
+  byte item = inMenu ? menuPosition : NUMBER_MENU_ITEMS;
+  byte steps = pgm_read_byte(&repeatSteps[item][buttons->getRepeatStage()]);
+  if(steps > 0) {
+    processParameterIncrement(_direction * steps);
   }
 }
 
@@ -252,14 +468,38 @@ void Interface::interactStatusScreen(unsigned long _millis) {
       processParameterIncrement(1);
     } else if(buttons->getPressed() == BUTTON_DECREASE && inSetMode) {
       processParameterIncrement(-1);
+    } else if(buttons->getPressed() == BUTTON_DECREASE) {
+      inHistory = true;
+    }
+  }
+
+  if(buttons->isRepeat() && inSetMode) {
+    if(buttons->getPressed() == BUTTON_INCREASE) {
+      processParameterRepeat(1);
+    } else if(buttons->getPressed() == BUTTON_DECREASE) {
+      processParameterRepeat(-1);
     }
   }
 }
 
+/*
+ * Manage interaction on the history screen
+ */
+void Interface::interactHistoryScreen(unsigned long _millis) {
+  if(buttons->isShortPress() && buttons->getPressed() == BUTTON_MENU) {
+    inHistory = false;
+  }
+}
+
 /*
  * Manage interaction on the menu screen
  */
 void Interface::interactMenuScreen(unsigned long _millis) {
+  if(inSetMode && menuPosition == MENU_CALIBRATION) {
+    interactCalibrationScreen(_millis);
+    return;
+  }
+
   if(buttons->isShortPress()) {
     // Menu navigation
     if(buttons->getPressed() == BUTTON_MENU) {
@@ -293,33 +533,124 @@ void Interface::interactMenuScreen(unsigned long _millis) {
       saveParameters();
     }
   }
+
+  if(buttons->isRepeat() && inSetMode) {
+    if(buttons->getPressed() == BUTTON_INCREASE) {
+      processParameterRepeat(1);
+    } else if(buttons->getPressed() == BUTTON_DECREASE) {
+      processParameterRepeat(-1);
+    }
+  }
   
   if(buttons->isLongPress() && buttons->getPressed() == BUTTON_SET && !inSetMode) {
     inSetMode = true;
+    if(menuPosition == MENU_CALIBRATION) {
+      // Start from the current temperature, rounded to the increment
+      Centidegrees temperature = thermostat->getTemperature();
+      if(temperature.isValid()) {
+        calibrationTemperature = temperature - Centidegrees::fromRaw(temperature.raw() % INCR_CALIBRATION_TEMPERATURE);
+      }
+      calibrationResult = CALIBRATION_RESULT_NONE;
+      ++parameterGeneration;
+    }
+  }
+
+#if PROFILING
+  if(buttons->isLongPress() && buttons->getPressed() == BUTTON_MENU && !inSetMode) {
+    inDiagnostics = true;
   }
+#endif
 }
 
+/*
+ * Manage interaction on the calibration screen
+ */
+void Interface::interactCalibrationScreen(unsigned long _millis) {
+  Calibration * calibration = thermostat->getCalibration();
+
+  if(buttons->isShortPress()) {
+    if(buttons->getPressed() == BUTTON_MENU) {
+      inSetMode = false;
+    } else if(buttons->getPressed() == BUTTON_INCREASE) {
+      calibrationTemperature += Centidegrees::fromRaw(INCR_CALIBRATION_TEMPERATURE);
+    } else if(buttons->getPressed() == BUTTON_DECREASE) {
+      calibrationTemperature -= Centidegrees::fromRaw(INCR_CALIBRATION_TEMPERATURE);
+    } else if(buttons->getPressed() == BUTTON_SET) {
+      // Capture the current raw value at the reference temperature
+      if(thermostat->getTemperature().isValid()
+         && calibration->addPoint(thermostat->getRawAverage(), calibrationTemperature)) {
+        calibration->save();
+        calibrationResult = CALIBRATION_RESULT_STORED;
+      } else {
+        calibrationResult = CALIBRATION_RESULT_REJECTED;
+      }
+    }
+    ++parameterGeneration;
+  }
+
+  if(buttons->isLongPress() && buttons->getPressed() == BUTTON_DECREASE
+     && calibration->getCount() > 0) {
+    calibration->clear();
+    calibration->save();
+    calibrationResult = CALIBRATION_RESULT_CLEARED;
+    ++parameterGeneration;
+  }
+}
+
+#if PROFILING
+/*
+ * Manage interaction on the diagnostics screen
+ */
+void Interface::interactDiagnosticsScreen(unsigned long _millis) {
+  if(buttons->isShortPress()) {
+    if(buttons->getPressed() == BUTTON_MENU) {
+      inDiagnostics = false;
+    } else if(buttons->getPressed() == BUTTON_DECREASE) {
+      diagnosticStage = (diagnosticStage + 1) % PROFILE_STAGES;
+    } else if(buttons->getPressed() == BUTTON_INCREASE) {
+      diagnosticStage = (diagnosticStage + PROFILE_STAGES - 1) % PROFILE_STAGES;
+    } else if(buttons->getPressed() == BUTTON_SET) {
+      profiler.reset();
+    }
+  }
+}
+#endif
+
 /*
  * Render the status screen
  */
 void Interface::renderStatusScreen(unsigned long _millis) {
-  clearBuffer();
-  
-  strcpy(buffer[0], "Cur.:  ");
-  formatTemperature(appendPtr(buffer[0]), thermostat->getTemperature());
-  strcpy(buffer[1], "Req.:  ");
-  formatTemperature(appendPtr(buffer[1]), requestedTemperature);
-  if(inSetMode) {
-    strcpy(&buffer[1][15], "(set)");
-  }
-  strcpy(buffer[2], "Stat.: ");
-  if(resetMode != RESET_NO) {
-    strcpy(appendPtr(buffer[2]), "resetting");
-  } else {
-    strcpy(appendPtr(buffer[2]), thermostat->getStatus());
+  if(recompose(0, thermostat->getTemperatureGeneration())) {
+    LineWriter line(buffer[0]);
+    formatTemperature(line.text("Cur.:  "), thermostat->getTemperature());
+  }
+  if(recompose(1, lineKey(0, 0, setpointGeneration, setModeGeneration))) {
+    LineWriter line(buffer[1]);
+    formatTemperature(line.text("Req.:  "), requestedTemperature);
+    if(inSetMode) {
+      line.column(15).text("(set)");
+    }
+  }
+  if(recompose(2, lineKey(0, zoneAlarms, thermostat->getStatusGeneration(), parameterGeneration))) {
+    LineWriter line(buffer[2]);
+    line.text("Stat.: ");
+    if(resetMode != RESET_NO) {
+      line.text("resetting");
+    } else if(zoneAlarms != 0 && !thermostat->inAlarm()) {
+      byte zone = 0;
+      while(!(zoneAlarms & (1 << zone))) {
+        ++zone;
+      }
+      line.text("zone ").number(zone).text(" alarm");
+    } else {
+      line.text(thermostat->getStatus());
+    }
+  }
+  unsigned long timeSinceStatusChange = thermostat->getTimeSinceStatusChange();
+  if(recompose(3, ((timeSinceStatusChange / 1000) << 8) | thermostat->getStatusGeneration())) {
+    LineWriter line(buffer[3]);
+    line.text("Time:  ").hoursMinutesSeconds(timeSinceStatusChange);
   }
-  strcpy(buffer[3], "Time:  ");
-  formatTimeS(appendPtr(buffer[3]), thermostat->getTimeSinceStatusChange());
   
   writeToLcd(_millis);
 }
@@ -328,56 +659,326 @@ void Interface::renderStatusScreen(unsigned long _millis) {
  * Render the menu screen
  */
 void Interface::renderMenuScreen(unsigned long _millis) {
-  clearBuffer();
+  // Every line shows the cursor, both generations only count up so their
+  // sum changes whenever the cursor moves.
+  byte menuScreen = menuPosition / 3;
+  byte cursorGeneration = menuGeneration + setModeGeneration;
+  unsigned long key = lineKey(0, 0, cursorGeneration, parameterGeneration);
 
   // Populate the menu
-  byte menuScreen = menuPosition / 3;
+  if(recompose(0, menuScreen)) {
+    LineWriter line(buffer[0]);
+    if(menuScreen < (NUMBER_MENU_ITEMS + 2) / 3) {
+      line.text("---- MENU (").number(menuScreen + 1).character('/')
+          .number((NUMBER_MENU_ITEMS + 2) / 3).text(") ----");
+    } else {
+      line.text("# ERROR #");
+    }
+  }
   if(menuScreen == 0) {
-    strcpy(buffer[0], "---- MENU (1/3) ----");
-    strcpy(buffer[1], " Hyst.:     ");
-    formatTemperature(appendPtr(buffer[1]), hysteresis);
-    strcpy(buffer[2], " Min. tmp.: ");
-    formatTemperature(appendPtr(buffer[2]), minimumTemperature);
-    strcpy(buffer[3], " Max. tmp.: ");
-    formatTemperature(appendPtr(buffer[3]), maximumTemperature);
+    if(recompose(1, key)) {
+      LineWriter line(buffer[1]);
+      formatTemperature(line.text(" Hyst.:     "), hysteresis);
+    }
+    if(recompose(2, key)) {
+      LineWriter line(buffer[2]);
+      formatTemperature(line.text(" Min. tmp.: "), minimumTemperature);
+    }
+    if(recompose(3, key)) {
+      LineWriter line(buffer[3]);
+      formatTemperature(line.text(" Max. tmp.: "), maximumTemperature);
+    }
   } else if (menuScreen == 1) {
-    strcpy(buffer[0], "---- MENU (2/3) ----");
-    strcpy(buffer[1], " Max. heat: ");
-    formatTimeM(appendPtr(buffer[1]), maximumHeatTime);
-    strcpy(buffer[2], " Grace tm.: ");
-    formatTimeM(appendPtr(buffer[2]), graceTime);
-    strcpy(buffer[3], " Offset:    ");
-    formatTemperature(appendPtr(buffer[3]), offsetTemperature);
+    if(recompose(1, key)) {
+      LineWriter line(buffer[1]);
+      line.text(" Max. heat: ").hoursMinutes(maximumHeatTime);
+    }
+    if(recompose(2, key)) {
+      LineWriter line(buffer[2]);
+      line.text(" Grace tm.: ").hoursMinutes(graceTime);
+    }
+    if(recompose(3, key)) {
+      LineWriter line(buffer[3]);
+      formatTemperature(line.text(" Offset:    "), offsetTemperature);
+    }
   } else if (menuScreen == 2) {
-    strcpy(buffer[0], "---- MENU (3/3) ----");
-    strcpy(buffer[1], " Reset md.: ");
-    switch(resetMode) {
-      case RESET_NO:
-        strcpy(appendPtr(buffer[1]), "no");
-        break;
-      case RESET_NORMAL:
-        strcpy(appendPtr(buffer[1]), "normal");
+    if(recompose(1, key)) {
+      LineWriter line(buffer[1]);
+      line.text(" Reset md.: ");
+      switch(resetMode) {
+        case RESET_NO:
+          line.text("no");
+          break;
+        case RESET_NORMAL:
+          line.text("normal");
+          break;
+        case RESET_FACTORY:
+          line.text("factory");
+          break;
+        default:
+          line.text("error");
+          break;
+      }
+    }
+    if(recompose(2, key)) {
+      LineWriter line(buffer[2]);
+      line.text(" Serial C.: ");
+      switch(serialMode) {
+        case TELEMETRY_CSV:
+          line.text("csv");
+          break;
+        case TELEMETRY_BINARY:
+          line.text("binary");
+          break;
+        default:
+          line.text("off");
+          break;
+      }
+    }
+    if(recompose(3, key)) {
+      LineWriter line(buffer[3]);
+      line.text(" Calibrate: ");
+      Calibration * calibration = thermostat->getCalibration();
+      if(calibration->isActive()) {
+        line.number(calibration->getCount()).text(" pts");
+      } else {
+        line.text("table");
+      }
+    }
+  } else if (menuScreen == 3) {
+    if(recompose(1, key)) {
+      LineWriter line(buffer[1]);
+      line.text(" Oversample: x").number(1 << (2 * oversampling));
+    }
+    unsigned int dutyCycle = power->getDutyCycle();
+    if(recompose(2, lineKey(dutyCycle >> 8, dutyCycle, cursorGeneration, parameterGeneration))) {
+      LineWriter line(buffer[2]);
+      line.text(" Duty cyc.: ").fixed<1, 1>(dutyCycle).character('%');
+    }
+    if(recompose(3, lineKey(0, statisticsGeneration, cursorGeneration, parameterGeneration))) {
+      LineWriter line(buffer[3]);
+      line.text(" LCD ").number(peakTransactions).text("tx ")
+          .number(recomposedPerSecond).text("ln/s");
+    }
+  } else if (menuScreen == 4) {
+    const accounting_counters_t * trip = accounting->getTrip();
+    unsigned long accountingKey = lineKey(0, accounting->getGeneration(), cursorGeneration, parameterGeneration);
+    if(recompose(1, accountingKey)) {
+      LineWriter line(buffer[1]);
+      if(inSetMode && menuPosition == MENU_TRIP) {
+        line.text(" Trip reset? ").text(tripReset ? "yes" : "no");
+      } else {
+        formatUsage(line.text(" Trip "), trip);
+      }
+    }
+    if(recompose(2, accountingKey)) {
+      LineWriter line(buffer[2]);
+      formatEnergy(line.text(" Trip "), trip, accounting->getAlarms(trip));
+    }
+    if(recompose(3, key)) {
+      LineWriter line(buffer[3]);
+      line.text(" Burner:    ").fixed<1, 1>(burnerPower / 100).text("kW");
+    }
+  } else if (menuScreen == 5) {
+    const accounting_counters_t * lifetime = accounting->getLifetime();
+    unsigned long accountingKey = lineKey(0, accounting->getGeneration(), cursorGeneration, parameterGeneration);
+    if(recompose(1, accountingKey)) {
+      LineWriter line(buffer[1]);
+      formatUsage(line.text(" Life "), lifetime);
+    }
+    if(recompose(2, accountingKey)) {
+      LineWriter line(buffer[2]);
+      formatEnergy(line.text(" Life "), lifetime, accounting->getAlarms(lifetime));
+    }
+    if(recompose(3, accountingKey)) {
+      LineWriter line(buffer[3]);
+      line.text(" Grace blk: ").number(accounting->getTrip()->graceBlocks)
+          .character('/').number(lifetime->graceBlocks);
+    }
+  } else if (menuScreen == 6) {
+    if(recompose(1, key)) {
+      LineWriter line(buffer[1]);
+      line.text(" Control:   ").text(controlMode == CONTROL_PID ? "PID" : "hyst.");
+    }
+    if(recompose(2, key)) {
+      LineWriter line(buffer[2]);
+      line.text(" Gain:      ").fixed<1, 1>(pidGain).text("%/").character((char)223);
+    }
+    if(recompose(3, key)) {
+      LineWriter line(buffer[3]);
+      line.text(" Int. time: ").hoursMinutes(pidIntegralTime * 1000UL);
+    }
+  } else if (menuScreen == 7) {
+    if(recompose(1, key)) {
+      LineWriter line(buffer[1]);
+      line.text(" Der. time: ").number(pidDerivativeTime).character('s');
+    }
+    if(recompose(2, key)) {
+      LineWriter line(buffer[2]);
+      line.text(" Window:    ").hoursMinutes(pidWindow * 1000UL);
+    }
+    if(recompose(3, key)) {
+      LineWriter line(buffer[3]);
+      line.text(" Min. pulse: ").number(pidMinimumPulse).character('s');
+    }
+  }
+
+  // Set the cursor
+  buffer[(menuPosition % 3) + 1][0] = inSetMode ? '*' : '>';
+
+  writeToLcd(_millis);
+}
+
+/*
+ * Render the history screen: the graph takes the first 8 characters of
+ * the third line. It's built a bit on every pass.
+ */
+void Interface::renderHistoryScreen(unsigned long _millis) {
+  if(sparkline.step(lcd)) {
+    // Defining a glyph leaves the LCD pointing at the CGRAM
+    cursorRow = LCD_ROWS;
+    busTransactions += 9;
+  }
+
+  byte graphGeneration = sparkline.getGeneration();
+  bool empty = !sparkline.isReady() || sparkline.getSamples() == 0;
+  if(recompose(0, graphGeneration)) {
+    LineWriter line(buffer[0]);
+    line.text("--- HISTORY ");
+    if(!empty) {
+      line.number((unsigned long)sparkline.getSamples() * HISTORY_PERIOD / 3600000UL).text("h ");
+    }
+    line.text("----");
+  }
+  if(recompose(1, graphGeneration)) {
+    LineWriter line(buffer[1]);
+    formatTemperature(line.text("Max.:  "), empty ? Centidegrees::invalid() : sparkline.getMaximum());
+  }
+  if(recompose(2, lineKey(0, 0, graphGeneration, thermostat->getTemperatureGeneration()))) {
+    LineWriter line(buffer[2]);
+    if(sparkline.isReady()) {
+      for(byte i=0; i<SPARKLINE_COLUMNS / 5; ++i) {
+        line.character(SPARKLINE_FIRST_CHAR + i);
+      }
+    } else {
+      line.text("...");
+    }
+    formatTemperature(line.column(9).text("Cur. "), thermostat->getTemperature());
+  }
+  if(recompose(3, graphGeneration)) {
+    LineWriter line(buffer[3]);
+    formatTemperature(line.text("Min.:  "), empty ? Centidegrees::invalid() : sparkline.getMinimum());
+  }
+
+  writeToLcd(_millis);
+}
+
+/*
+ * Render the calibration screen
+ */
+void Interface::renderCalibrationScreen(unsigned long _millis) {
+  if(recompose(0, 0)) {
+    LineWriter line(buffer[0]);
+    line.text("--- CALIBRATION ----");
+  }
+
+  // Raw value as ADC units with one decimal
+  uint16_t raw = thermostat->getRawAverage();
+  if(recompose(1, raw)) {
+    LineWriter line(buffer[1]);
+    line.text("Raw:   ").fixed<1, 1>(((unsigned long)raw * 10) >> ADC_RAW_SHIFT);
+  }
+
+  if(recompose(2, parameterGeneration)) {
+    LineWriter line(buffer[2]);
+    formatTemperature(line.text("Ref.:  "), calibrationTemperature);
+  }
+
+  if(recompose(3, parameterGeneration)) {
+    LineWriter line(buffer[3]);
+    line.text("Points: ").number(thermostat->getCalibration()->getCount())
+        .character('/').number(CALIBRATION_MAX_POINTS).column(14);
+    switch(calibrationResult) {
+      case CALIBRATION_RESULT_STORED:
+        line.text("stored");
         break;
-      case RESET_FACTORY:
-        strcpy(appendPtr(buffer[1]), "factory");
+      case CALIBRATION_RESULT_REJECTED:
+        line.text("error");
         break;
-      default:
-        strcpy(appendPtr(buffer[1]), "error");
+      case CALIBRATION_RESULT_CLEARED:
+        line.text("clear");
         break;
     }
-    sprintf(buffer[2], " Serial C.: %s", serialEnabled ? "on" : "off");
-  } else {
-    sprintf(buffer[0], "# ERROR #");
   }
 
-  // Set the cursor
-  buffer[(menuPosition % 3) + 1][0] = inSetMode ? '*' : '>';
+  writeToLcd(_millis);
+}
+
+#if PROFILING
+/*
+ * Render the diagnostics screen: timing statistics of one stage (us.),
+ * the histogram shows the order of magnitude of each bucket count.
+ */
+void Interface::renderDiagnosticsScreen(unsigned long _millis) {
+  clearBuffer();
+
+  byte stage = diagnosticStage;
+  LineWriter header(buffer[0]);
+  header.text("DIAG ").text(profiler.getName(stage))
+        .column(16).number(stage + 1).character('/').number(PROFILE_STAGES);
+  LineWriter extremes(buffer[1]);
+  extremes.text("Min ").number(profiler.getMinimum(stage))
+          .text(" Max ").number(profiler.getMaximum(stage));
+  LineWriter mean(buffer[2]);
+  mean.text("Avg ").number(profiler.getMean(stage))
+      .text(" n ").number(profiler.getCount(stage));
+  LineWriter histogram(buffer[3]);
+  histogram.text("Hist ");
+  for(byte i=0; i<PROFILE_BUCKETS; ++i) {
+    uint16_t count = profiler.getBucket(stage, i);
+    byte magnitude = 0;
+    while(count > 0 && magnitude < 9) {
+      count >>= 1;
+      ++magnitude;
+    }
+    histogram.character(magnitude == 0 ? '.' : '0' + magnitude);
+  }
 
   writeToLcd(_millis);
 }
+#endif
 
 /*
- * Clear the buffer for the LCD
+ * Switch to another screen, all lines have to be recomposed
+ */
+void Interface::selectScreen(byte _screen) {
+  if(screen != _screen) {
+    screen = _screen;
+    linesValid = 0;
+  }
+}
+
+/*
+ * Check if a line has to be recomposed, the key summarizes the inputs of
+ * the line. If so, the line is cleared and marked for the LCD.
+ */
+bool Interface::recompose(byte _row, unsigned long _key) {
+  byte mask = 1 << _row;
+  if((linesValid & mask) && lineKeys[_row] == _key) {
+    return false;
+  }
+  linesValid |= mask;
+  linesDirty |= mask;
+  lineKeys[_row] = _key;
+  for(int j=0; j<LCD_COLUMNS; ++j) {
+    buffer[_row][j] = ' ';
+  }
+  ++recomposedLines;
+  return true;
+}
+
+/*
+ * Clear the buffer for the LCD (for screens that are always recomposed)
  */
 void Interface::clearBuffer() {
   for(int i=0; i<LCD_ROWS; ++i) {
@@ -385,30 +986,78 @@ void Interface::clearBuffer() {
       buffer[i][j] = ' ';
     }
   } 
+  linesValid = 0;
+  linesDirty = (1 << LCD_ROWS) - 1;
+  recomposedLines += LCD_ROWS;
 }
 
 /*
- * Dump the buffer to the LCD. '\0' characters in the
- * middle of a line are replaced by space.
+ * The display is cleared by LiquidCrystal::begin(), the cursor position
+ * is unknown.
  */
-void Interface::writeToLcd(unsigned long _millis) {
+void Interface::clearShadow() {
   for(int i=0; i<LCD_ROWS; ++i) {
     for(int j=0; j<LCD_COLUMNS; ++j) {
+      shadow[i][j] = ' ';
+    }
+  }
+  cursorRow = LCD_ROWS;
+  linesDirty = (1 << LCD_ROWS) - 1;
+}
+
+/*
+ * Send the changes in the buffer to the LCD. '\0' characters in the
+ * middle of a line are replaced by space.
+ *
+ * Only the characters that differ from the shadow copy are written, the
+ * cursor is only moved when a run of changes doesn't continue where the
+ * last write left it. The cursor doesn't wrap to the next row, so its
+ * position is forgotten at the end of a row. Lines that weren't
+ * recomposed are skipped altogether.
+ */
+void Interface::writeToLcd(unsigned long _millis) {
+  if(linesDirty == 0) {
+    frameTransactions = 0;
+    return;
+  }
+
+  PROFILE_START(PROFILE_LCD);
+  unsigned int transactions = 0;
+  for(byte i=0; i<LCD_ROWS; ++i) {
+    if(!(linesDirty & (1 << i))) {
+      continue;
+    }
+    for(byte j=0; j<LCD_COLUMNS; ++j) {
       if(buffer[i][j] == '\0') {
         buffer[i][j] = ' ';
       }
     }
     buffer[i][LCD_COLUMNS] = '\0';
-  }
 
-  if(diffUL(lastLcdReset, _millis) >= LCD_RESET) {
-    lcd->begin(20, 4);
-    lastLcdReset = _millis;
+    for(byte j=0; j<LCD_COLUMNS; ++j) {
+      if(buffer[i][j] == shadow[i][j]) {
+        continue;
+      }
+      if(cursorRow != i || cursorColumn != j) {
+        lcd->setCursor(j, i);
+        ++transactions;
+      }
+      lcd->write(buffer[i][j]);
+      ++transactions;
+      shadow[i][j] = buffer[i][j];
+      cursorRow = i;
+      cursorColumn = j + 1;
+    }
+    if(cursorColumn >= LCD_COLUMNS) {
+      cursorRow = LCD_ROWS;
+    }
   }
-  for(int i=0; i<LCD_ROWS; ++i) {
-    lcd->setCursor(0, i);
-    char * ptr = buffer[i];
-    lcd->print(ptr);
+  linesDirty = 0;
+  frameTransactions = transactions;
+  if(transactions > windowTransactions) {
+    windowTransactions = transactions;
   }
+  busTransactions += transactions;
+  PROFILE_STOP(PROFILE_LCD);
 }
 
@@ -33,6 +33,14 @@
 #include "MagicNumbers.h"
 #include "Thermostat.h"
 #include "AnalogButtons.h"
+#include "Power.h"
+#include "Accounting.h"
+#include "History.h"
+#include "Sparkline.h"
+#include "Profiler.h"
+#include "Format.h"
+
+typedef FieldWriter<LCD_COLUMNS> LineWriter;
 
 /*
  * Implements and interface with:
@@ -45,50 +53,150 @@
  *    - 1: minimum temperature (alarms)
  *    - 2: maximum temperature (alarms)
  *    - 3: maximum run time (alarms)
+ *    - ...
+ *    - 8: calibration of the thermistor: the raw value is captured at
+ *         reference temperatures set with the increase/decrease buttons
+ *         (SET stores a point, holding DECREASE clears the set, MENU
+ *         returns to the menu).
+ *    - 9: oversampling of the thermistor (x1, x4, x16 or x64)
+ *    - 10: duty cycle of the MCU (read only)
+ *    - 11: LCD bus transactions of the largest frame and lines recomposed
+ *          in the last second (read only)
+ *    - 12: trip burner hours and heat cycles, SET asks to reset the trip
+ *          counters
+ *    - 13: trip energy (kWh) and alarms (read only)
+ *    - 14: burner power, for the energy estimate
+ *    - 15, 16: lifetime counters, as 12 and 13 (read only)
+ *    - 17: grace period blocks, trip/lifetime (read only)
+ *    - 18: control mode, hysteresis loop or PID (see Pid.h)
+ *    - 19 - 23: gain, integral and derivative time of the PID, period of
+ *          the relay window and the shortest pulse
+ *  - A history screen with a graph of the temperature and the relay (see
+ *    Sparkline.h) and the extremes, opened with DECREASE on the status
+ *    screen, MENU returns.
+ *  - A hidden diagnostics screen with the timing statistics (when
+ *    PROFILING is enabled), opened by holding MENU in the menu.
+ *
+ * Holding INCREASE or DECREASE while changing a value repeats the step,
+ * faster and in bigger steps the longer it's held (see
+ * REPEAT_STEP_TABLE).
+ *
+ * A line of the screen is only recomposed when one of its inputs changed,
+ * the inputs are tracked with generation counters (here and in the
+ * Thermostat) that are incremented on every change.
  */
 class Interface {
   public:
-    Interface(LiquidCrystal *, AnalogButtons<NUMBER_OF_BUTTONS> *, Thermostat *);
+    Interface(LiquidCrystal *, AnalogButtons<NUMBER_OF_BUTTONS> *, Thermostat *, Power *,
+              Accounting *, History *);
     void interact();
     void interact(unsigned long _millis);
     void render();
     void render(unsigned long _millis);
+    void resetLcd(unsigned long _millis);
     int getResetMode();
+    void setZoneAlarms(byte _zones);
+    unsigned int getFrameTransactions();
+    unsigned long getBusTransactions();
+    unsigned int getRecomposedLines();
+
+    // Generation counters, incremented when the value changes
+    byte getSetpointGeneration();
+    byte getMenuGeneration();
+    byte getSetModeGeneration();
+    byte getParameterGeneration();
 
   private:
     LiquidCrystal * lcd;
     AnalogButtons<NUMBER_OF_BUTTONS> * buttons;
     Thermostat * thermostat;
+    Power * power;
+    Accounting * accounting;
+    Sparkline sparkline;
 
     char buffer[LCD_ROWS][LCD_COLUMNS + 1];
-    byte padding[16]; //just in case
+
+    // What is on the display, only changed characters are sent
+    char shadow[LCD_ROWS][LCD_COLUMNS];
+    byte cursorRow;
+    byte cursorColumn;
+    unsigned int frameTransactions;
+    unsigned long busTransactions;
+
+    // The inputs each line was composed from
+    byte screen;
+    byte linesValid;
+    byte linesDirty;
+    unsigned long lineKeys[LCD_ROWS];
+    unsigned int recomposedLines;
+    unsigned int recomposedPerSecond;
+    unsigned long recomposeWindowStart;
+
+    // Largest frame of the running and of the last second, the menu shows
+    // the statistics of the last second so its own line doesn't feed back
+    unsigned int windowTransactions;
+    unsigned int peakTransactions;
+    byte statisticsGeneration;
+
+    byte setpointGeneration;
+    byte menuGeneration;
+    byte setModeGeneration;
+    byte parameterGeneration;
+    byte thermostatGeneration;
     
     bool inSetMode;
     bool inMenu;
+    bool inHistory;
     byte menuPosition;
     int resetMode;
+    byte zoneAlarms;
 
-    int requestedTemperature;
-    int hysteresis;
-    int minimumTemperature;
-    int maximumTemperature;
+    Centidegrees requestedTemperature;
+    Centidegrees hysteresis;
+    Centidegrees minimumTemperature;
+    Centidegrees maximumTemperature;
     unsigned long maximumHeatTime;
     unsigned long graceTime;
-    int offsetTemperature;
-    bool serialEnabled;
-
-    unsigned long lastLcdReset;
+    Centidegrees offsetTemperature;
+    byte serialMode;
+    byte oversampling;
+    unsigned int burnerPower;
+    byte controlMode;
+    int pidGain;
+    unsigned int pidIntegralTime;
+    unsigned int pidDerivativeTime;
+    unsigned int pidWindow;
+    unsigned int pidMinimumPulse;
+    bool tripReset;
+    Centidegrees calibrationTemperature;
+    byte calibrationResult;
+#if PROFILING
+    bool inDiagnostics;
+    byte diagnosticStage;
+#endif
     
     void loadParameters();
     void saveParameters();
     void processParameterIncrement(int);
+    void processParameterRepeat(int);
 
     void interactStatusScreen(unsigned long _millis);
     void interactMenuScreen(unsigned long _millis);
     void renderStatusScreen(unsigned long _millis);
     void renderMenuScreen(unsigned long _millis);
+    void interactCalibrationScreen(unsigned long _millis);
+    void renderCalibrationScreen(unsigned long _millis);
+    void interactHistoryScreen(unsigned long _millis);
+    void renderHistoryScreen(unsigned long _millis);
+#if PROFILING
+    void interactDiagnosticsScreen(unsigned long _millis);
+    void renderDiagnosticsScreen(unsigned long _millis);
+#endif
 
+    void selectScreen(byte _screen);
+    bool recompose(byte _row, unsigned long _key);
     void clearBuffer();
+    void clearShadow();
     void writeToLcd(unsigned long);
 };
 
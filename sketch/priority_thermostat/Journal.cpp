@@ -0,0 +1,189 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+
+#include <EEPROM.h>
+#include "Journal.h"
+#include "Functions.h"
+
+// Sequence number of an erased slot
+#define JOURNAL_ERASED 0xFFFFFFFFUL
+
+// Outcome of checking a slot
+#define JOURNAL_CORRUPT  0
+#define JOURNAL_VALID    1
+#define JOURNAL_OUTDATED 2
+
+/*
+ * Constructor, the journal takes _size bytes from _start for records of
+ * _length bytes. Records with another version are ignored.
+ */
+Journal::Journal(int _start, int _size, byte _length, byte _version) {
+  start = _start;
+  length = _length;
+  version = _version;
+  slotSize = sizeof(uint32_t) + 1 + _length + sizeof(uint16_t);
+  slots = _size / slotSize;
+  head = slots - 1;
+  sequence = 0;
+  bytesWritten = 0;
+}
+
+/*
+ * Find the newest valid record and copy it into _record. Returns false
+ * (and leaves _record alone) when there's none.
+ */
+bool Journal::load(void * _record) {
+  // Pass 1: the highest sequence number
+  byte newest = 0;
+  uint32_t newestSequence = JOURNAL_ERASED;
+  for(byte i=0; i<slots; ++i) {
+    uint32_t value = readSequence(i);
+    if(value != JOURNAL_ERASED && (newestSequence == JOURNAL_ERASED || value > newestSequence)) {
+      newest = i;
+      newestSequence = value;
+    }
+  }
+  if(newestSequence == JOURNAL_ERASED) {
+    return false;
+  }
+
+  // Pass 2: walk back until the CRC matches
+  bool outdated = false;
+  for(byte i=0; i<slots; ++i) {
+    byte slot = newest >= i ? newest - i : newest + slots - i;
+    byte state = verify(slot, _record);
+    if(state == JOURNAL_VALID) {
+      head = slot;
+      sequence = readSequence(slot);
+      return true;
+    }
+
+    // Records of another version: carry on after them (the sequence
+    // numbers keep counting), there's nothing to load though.
+    if(state == JOURNAL_OUTDATED && !outdated) {
+      outdated = true;
+      head = slot;
+      sequence = readSequence(slot);
+    }
+  }
+  return false;
+}
+
+/*
+ * Append a record, in the slot after the newest one.
+ */
+void Journal::commit(const void * _record) {
+  head = head + 1 < slots ? head + 1 : 0;
+  ++sequence;
+
+  int address = start + head * slotSize;
+  uint16_t crc = 0xFFFF;
+  for(byte i=0; i<sizeof(uint32_t); ++i) {
+    byte value = sequence >> (8 * i);
+    crc = crc16Update(crc, value);
+    writeByte(address++, value);
+  }
+  crc = crc16Update(crc, version);
+  writeByte(address++, version);
+  const byte * record = (const byte *)_record;
+  for(byte i=0; i<length; ++i) {
+    crc = crc16Update(crc, record[i]);
+    writeByte(address++, record[i]);
+  }
+  writeByte(address++, crc & 0xFF);
+  writeByte(address, crc >> 8);
+}
+
+/*
+ * Number of commits over the lifetime of the EEPROM (the sequence number
+ * of the newest record).
+ */
+unsigned long Journal::getCommits() {
+  return sequence;
+}
+
+/*
+ * Number of bytes written since the start.
+ */
+unsigned long Journal::getBytesWritten() {
+  return bytesWritten;
+}
+
+/*
+ * Check the CRC and the version of a slot (JOURNAL_*), copying the record
+ * when it's valid.
+ */
+byte Journal::verify(byte _slot, void * _record) {
+  int address = start + _slot * slotSize;
+  uint16_t crc = 0xFFFF;
+  for(byte i=0; i<sizeof(uint32_t); ++i) {
+    crc = crc16Update(crc, EEPROM.read(address++));
+  }
+  byte storedVersion = EEPROM.read(address++);
+  crc = crc16Update(crc, storedVersion);
+
+  // Only copy the record once it checks out
+  int recordAddress = address;
+  for(byte i=0; i<length; ++i) {
+    crc = crc16Update(crc, EEPROM.read(address++));
+  }
+  uint16_t storedCrc = EEPROM.read(address) | (EEPROM.read(address + 1) << 8);
+  if(storedCrc != crc) {
+    return JOURNAL_CORRUPT;
+  }
+  if(storedVersion != version) {
+    return JOURNAL_OUTDATED;
+  }
+  byte * record = (byte *)_record;
+  for(byte i=0; i<length; ++i) {
+    record[i] = EEPROM.read(recordAddress + i);
+  }
+  return JOURNAL_VALID;
+}
+
+/*
+ * Sequence number of a slot (little endian).
+ */
+uint32_t Journal::readSequence(byte _slot) {
+  int address = start + _slot * slotSize;
+  uint32_t value = 0;
+  for(byte i=0; i<sizeof(uint32_t); ++i) {
+    value |= (uint32_t)EEPROM.read(address + i) << (8 * i);
+  }
+  return value;
+}
+
+/*
+ * Write a byte of the EEPROM if it changes.
+ */
+void Journal::writeByte(int _address, byte _value) {
+  if(EEPROM.read(_address) != _value) {
+    EEPROM.write(_address, _value);
+    ++bytesWritten;
+  }
+}
@@ -0,0 +1,76 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+
+#ifndef _JOURNAL_H_
+#define _JOURNAL_H_
+
+#include <Arduino.h>
+#include "MagicNumbers.h"
+
+/*
+ * Append-only journal of fixed size records in a region of the EEPROM.
+ * The region is divided in slots, every commit goes into the slot after
+ * the newest record, so the writes wear out the whole region evenly
+ * instead of the same few cells. A slot holds:
+ *
+ *   sequence (32 bit) | version | record | CRC-16
+ *
+ * The sequence number counts the commits over the lifetime of the EEPROM,
+ * the CRC (CRC-16/CCITT-FALSE over the sequence, version and record)
+ * catches records that were only partly written, e.g. on a brown-out.
+ *
+ * load() finds the newest record in two passes: the sequence numbers of
+ * all slots are read to pick the candidate with the highest one, then the
+ * CRC is checked, walking back to the previous slot as long as it
+ * doesn't match. Erased slots (sequence 0xFFFFFFFF) are skipped. Only the
+ * bytes that change are written.
+ */
+class Journal {
+  public:
+    Journal(int _start, int _size, byte _length, byte _version);
+    bool load(void * _record);
+    void commit(const void * _record);
+    unsigned long getCommits();
+    unsigned long getBytesWritten();
+
+  private:
+    int start;
+    byte length;
+    byte version;
+    byte slotSize;
+    byte slots;
+    byte head;
+    uint32_t sequence;
+    unsigned long bytesWritten;
+
+    byte verify(byte _slot, void * _record);
+    uint32_t readSequence(byte _slot);
+    void writeByte(int _address, byte _value);
+};
+
+#endif
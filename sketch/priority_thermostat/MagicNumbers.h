@@ -47,6 +47,33 @@
 #define RELAY_PIN      9
 #define ENABLE_PIN     10
 
+// Interrupt driven sampling of the analog pins. The sample rate is the
+// total number of conversions per second, shared by all channels.
+#define ADC_CHANNELS    (1 + ZONE_COUNT)
+#define ADC_BUFFER_SIZE 16
+#define ADC_SAMPLE_RATE 200
+
+// Samples are left aligned to 16 bits before filtering, the extra bits
+// keep the precision gained by averaging and oversampling.
+#define ADC_RAW_SHIFT 6
+
+// Oversampling takes 4^n conversions for n extra bits (at most 3).
+#define MAX_OVERSAMPLING  3
+
+// Zones sharing the boiler (see Zones.h). Zone 0 is the hot water tank
+// managed by the thermostat and has the highest priority. Extra zones
+// need a thermistor, an enable input and an output (valve or pump) each,
+// in priority order. For example, for one space heating loop:
+//   #define ZONE_COUNT           2
+//   #define ZONE_THERMISTOR_PINS {A2}
+//   #define ZONE_ENABLE_PINS     {11}
+//   #define ZONE_OUTPUT_PINS     {12}
+#define ZONE_COUNT        1
+#define ZONE_NONE         0xFF
+#define ZONE_NO_PIN       0xFF
+#define ZONE_MIN_RUN_TIME 0
+#define ZONE_LOCKOUT_TIME 0
+
 // Tolerance on the analog value for the buttons.
 #define ANALOG_TOLERANCE 15
 
@@ -60,14 +87,65 @@
 #define BUTTON_DECREASE 1
 #define BUTTON_SET      2
 #define BUTTON_MENU     3
+#define BUTTON_NONE     0xFF
+
+// Button decoding in the conversion interrupt (see AnalogButtons.h). A
+// button has to be seen (or gone) in this many samples of the button
+// line before it counts, each ADC_CHANNELS / ADC_SAMPLE_RATE s. apart.
+// The queue holds the events until the input task gets to them (power of
+// two).
+#define BUTTON_DEBOUNCE_SAMPLES 3
+#define BUTTON_QUEUE_SIZE       8
+
+// Button events
+#define BUTTON_EVENT_PRESS     0
+#define BUTTON_EVENT_LONGPRESS 1
+#define BUTTON_EVENT_RELEASE   2
+#define BUTTON_EVENT_REPEAT    3
+
+// Hold to repeat (see AnalogButtons.h): a held button that repeats posts
+// its first repeat after BUTTON_REPEAT_DELAY ms., then one every period
+// of its stage. Every BUTTON_REPEAT_STAGE repeats the next stage starts.
+#define BUTTON_REPEAT_DELAY   500
+#define BUTTON_REPEAT_STAGE   8
+#define BUTTON_REPEAT_STAGES  3
+#define BUTTON_REPEAT_PERIODS {250, 150, 100}
 
-// Some magic variables for the thermostat logic
-#define UNDEF           -9999
-#define FIXEDPOINT_MLT1 1000L
+// Filter chain for the thermistor samples (see Filters.h). Stages are
+// applied from left to right, power of two windows are cheapest.
+#define THERMOSTAT_FILTER FilterChain<Median<3>, Boxcar<16> >
 
-// Sizes for the arrays
-#define SAMPLE_SET_SIZE 10
-#define CALIBRATION_SET_SIZE 5
+// Calibration set for the thermistor (see other/values.txt), ADC values
+// multiplied by 100 and temperatures in centi-degrees.
+#define CALIBRATION_SET_SIZE    5
+#define CALIBRATION_RAW         {43500L, 47600L, 51500L, 55300L, 58700L}
+#define CALIBRATION_TEMPERATURE {1000L, 3000L, 5000L, 7000L, 9000L}
+
+// Temperature lookup table (see TemperatureTable.h). 10 bits uses 2 KB of
+// flash, 12 bits uses 8 KB but resolves the extra bits gained by
+// filtering and oversampling.
+#define CURVE_LINEAR           0
+#define CURVE_POLYNOMIAL       1
+#define THERMISTOR_CURVE       CURVE_LINEAR
+#define TEMPERATURE_TABLE_BITS 10
+
+// Least squares fit of the calibration set: centi-degrees as a function
+// of (ADC value - 512), coefficients from a0 to a3.
+#define THERMISTOR_POLYNOMIAL  {4824.502, 51.45553, 0.03930018, 0.0002156489}
+#define CALIBRATION_TOLERANCE  50
+
+// Calibration set captured on the device (see Calibration.h). Slopes are
+// in centi-degrees per raw unit, in fixed point. Points closer than the
+// minimum distance (in raw units) replace each other.
+#define CALIBRATION_MAX_POINTS   16
+#define CALIBRATION_MIN_DISTANCE 128
+#define CALIBRATION_SLOPE_SHIFT  12
+
+// Feedback on the calibration screen
+#define CALIBRATION_RESULT_NONE     0
+#define CALIBRATION_RESULT_STORED   1
+#define CALIBRATION_RESULT_REJECTED 2
+#define CALIBRATION_RESULT_CLEARED  3
 
 // Defaults
 #define DEFAULT_REQUESTED_TEMPERATURE 5000
@@ -77,6 +155,7 @@
 #define DEFAULT_MAX_HEAT_TIME         7200000L
 #define DEFAULT_GRACE_TIME            120000L
 #define DEFAULT_OFFSET_TEMPERATURE    0
+#define DEFAULT_OVERSAMPLING          0
 #define INCR_REQUESTED_TEMPERATURE 50
 #define INCR_HYSTERESIS            50
 #define INCR_MIN_TEMPERATURE       100
@@ -84,18 +163,134 @@
 #define INCR_MAX_HEAT_TIME         60000L 
 #define INCR_GRACE_TIME            60000L 
 #define INCR_OFFSET_TEMPERATURE    50
+#define INCR_CALIBRATION_TEMPERATURE 50
+// Limits of the parameters, for the menu and the command channel alike
+// (centi-degrees and milliseconds)
+#define MIN_REQUESTED_TEMPERATURE     0
+#define MAX_REQUESTED_TEMPERATURE     9500
+#define MAX_HYSTERESIS                2000
+#define MIN_MIN_TEMPERATURE           -2000
+#define MAX_MIN_TEMPERATURE           10000
+#define MAX_MAX_TEMPERATURE           12000
+#define MIN_HEAT_TIME                 60000L
+#define MAX_HEAT_TIME                 86400000L
+#define MAX_GRACE_TIME                86400000L
+#define MIN_OFFSET_TEMPERATURE        -2000
+#define MAX_OFFSET_TEMPERATURE        2000
+#define DEFAULT_BURNER_POWER          24000
+#define INCR_BURNER_POWER             500
+#define MAX_BURNER_POWER              60000
+#define DEFAULT_CONTROL_MODE          CONTROL_HYSTERESIS
+#define DEFAULT_PID_GAIN              50
+#define DEFAULT_PID_INTEGRAL_TIME     1800
+#define DEFAULT_PID_DERIVATIVE_TIME   240
+#define DEFAULT_PID_WINDOW            600
+#define DEFAULT_PID_MINIMUM_PULSE     120
+#define INCR_PID_GAIN                 10
+#define INCR_PID_INTEGRAL_TIME        60
+#define INCR_PID_DERIVATIVE_TIME      30
+#define INCR_PID_WINDOW               60
+#define INCR_PID_MINIMUM_PULSE        10
+#define MAX_PID_GAIN                  2000
+#define MAX_PID_INTEGRAL_TIME         7200
+#define MAX_PID_DERIVATIVE_TIME       600
+#define MIN_PID_WINDOW                60
+#define MAX_PID_WINDOW                3600
+
+// Temperatures are shown rounded to this step (centi-degrees)
+#define TEMPERATURE_DISPLAY_STEP 50
 
 // Number of menu items
-#define NUMBER_MENU_ITEMS 8
+#define NUMBER_MENU_ITEMS   24
+#define MENU_CALIBRATION    8
+#define MENU_TRIP           12
+#define MENU_BURNER_POWER   14
+#define MENU_CONTROL        18
+#define MENU_PID_GAIN       19
+#define MENU_PID_INTEGRAL   20
+#define MENU_PID_DERIVATIVE 21
+#define MENU_PID_WINDOW     22
+#define MENU_PID_PULSE      23
+
+// Increments per repeat while INCREASE or DECREASE is held in set mode,
+// for every repeat stage. One row per menu item, the requested
+// temperature on the status screen last. Items with 0 don't repeat.
+#define REPEAT_STEPS_NONE {0, 0, 0}
+#define REPEAT_STEPS_SLOW {1, 2, 5}
+#define REPEAT_STEPS_FAST {1, 5, 20}
+#define REPEAT_STEP_TABLE {                                                 \
+  REPEAT_STEPS_SLOW,  /* hysteresis */                                      \
+  REPEAT_STEPS_FAST,  /* min. temperature */                                \
+  REPEAT_STEPS_FAST,  /* max. temperature */                                \
+  REPEAT_STEPS_FAST,  /* max. heat time */                                  \
+  REPEAT_STEPS_FAST,  /* grace time */                                      \
+  REPEAT_STEPS_SLOW,  /* offset */                                          \
+  REPEAT_STEPS_NONE,  /* reset mode */                                      \
+  REPEAT_STEPS_NONE,  /* serial mode */                                     \
+  REPEAT_STEPS_NONE,  /* calibration */                                     \
+  REPEAT_STEPS_NONE,  /* oversampling */                                    \
+  REPEAT_STEPS_NONE,  /* duty cycle */                                      \
+  REPEAT_STEPS_NONE,  /* LCD */                                             \
+  REPEAT_STEPS_NONE,  /* trip reset */                                      \
+  REPEAT_STEPS_NONE,  /* trip energy */                                     \
+  REPEAT_STEPS_FAST,  /* burner power */                                    \
+  REPEAT_STEPS_NONE,  /* lifetime usage */                                  \
+  REPEAT_STEPS_NONE,  /* lifetime energy */                                 \
+  REPEAT_STEPS_NONE,  /* grace blocks */                                    \
+  REPEAT_STEPS_NONE,  /* control mode */                                    \
+  REPEAT_STEPS_FAST,  /* PID gain */                                        \
+  REPEAT_STEPS_FAST,  /* PID integral time */                               \
+  REPEAT_STEPS_SLOW,  /* PID derivative time */                             \
+  REPEAT_STEPS_FAST,  /* PID window */                                      \
+  REPEAT_STEPS_SLOW,  /* PID min. pulse */                                  \
+  REPEAT_STEPS_SLOW   /* requested temperature */                           \
+}
+
+// Screens
+#define SCREEN_STATUS      0
+#define SCREEN_MENU        1
+#define SCREEN_CALIBRATION 2
+#define SCREEN_DIAGNOSTICS 3
+#define SCREEN_HISTORY     4
 
 // Reset modes
 #define RESET_NO      0
 #define RESET_NORMAL  1
 #define RESET_FACTORY 2
 
-// EEPROM
-#define EEPROM_TAG     {'P', 'T'}
-#define EEPROM_VERSION 1
+// EEPROM: the parameters are kept in a journal (see Journal.h) at the
+// start, changes are committed after EEPROM_COMMIT_DELAY ms. without
+// further changes. The tag and version are those of the fixed
+// layout used before the journal, which is still read once, as are
+// records of the previous version (without the control mode and the PID
+// tuning). Version 1 of the fixed layout is version 2 without the
+// oversampling.
+#define EEPROM_JOURNAL_ADDR 0
+#define EEPROM_JOURNAL_SIZE 576
+#define PARAMETER_VERSION   4
+#define PREVIOUS_PARAMETER_VERSION 3
+#define EEPROM_COMMIT_DELAY 5000
+#define EEPROM_TAG          {'P', 'T'}
+#define EEPROM_VERSION      2
+#define EEPROM_FIRST_VERSION 1
+
+// EEPROM: what the anticipator learned (see Anticipator.h) has a small
+// journal of its own behind the parameters.
+#define EEPROM_ANTICIPATOR_ADDR 576
+#define EEPROM_ANTICIPATOR_SIZE 64
+#define ANTICIPATOR_VERSION     1
+
+// EEPROM: the accounting counters have a journal of their own between
+// the parameters and the calibration set (see Accounting.h), a factory
+// reset leaves them alone.
+#define EEPROM_ACCOUNTING_ADDR 640
+#define EEPROM_ACCOUNTING_SIZE 256
+#define ACCOUNTING_VERSION     1
+
+// EEPROM location of the calibration set (last 128 bytes of 1 KB)
+#define EEPROM_CALIBRATION_ADDR 896
+#define CALIBRATION_TAG         {'C', 'T'}
+#define CALIBRATION_VERSION     1
 
 // Status
 #define STATUS_STR         {"ready", "heating", "disabled", "grace period" }
@@ -103,14 +298,185 @@
 #define STATUS_HEATING     1
 #define STATUS_DISABLED    2
 #define STATUS_GRACEPERIOD 3
+#define STATUS_NONE        0xFF
+
+// Scheduler tasks: index in the task table, period and deadline (ms.)
+#define TASK_INPUT             0
+#define TASK_CONTROL           1
+#define TASK_RENDER            2
+#define TASK_TELEMETRY         3
+#define TASK_LCD_RESET         4
+#define INPUT_PERIOD           25
+#define INPUT_DEADLINE         25
+#define CONTROL_PERIOD         100
+#define CONTROL_DEADLINE       50
+#define RENDER_PERIOD          200
+#define RENDER_DEADLINE        200
+#define TELEMETRY_DEADLINE     1000
+#define LCD_RESET_DEADLINE     1000
+
+// Timing instrumentation (see Profiler.h), set PROFILING to 1 to compile
+// it in (about 200 bytes of RAM). Stages are timed in us., the histogram
+// has power of two buckets. The "prof" command on the serial console (text
+// telemetry only) prints the statistics, a long press on MENU in the menu
+// shows them.
+#define PROFILING          0
+#define PROFILE_BUTTONS    0
+#define PROFILE_THERMOSTAT 1
+#define PROFILE_INTERACT   2
+#define PROFILE_RENDER     3
+#define PROFILE_LCD        4
+#define PROFILE_JITTER     5
+#define PROFILE_STAGES     6
+#define PROFILE_NAMES      {"buttons", "thermostat", "interact", "render", "lcd", "jitter"}
+#define PROFILE_BUCKETS    12
+
+// Temperature history (see History.h): a sample every HISTORY_PERIOD ms.
+// in steps of HISTORY_RESOLUTION centi-degrees. A day at the tank takes
+// about 150 bytes, so the ring holds well over a day.
+#define HISTORY_BYTES      256
+#define HISTORY_PERIOD     60000UL
+#define HISTORY_RESOLUTION 50
+
+// History graph (see Sparkline.h): 8 glyphs of 5 columns, shown as the
+// characters 8-15 (the HD44780 maps them on 0-7, 0 can't be in a line).
+// Samples decoded per render pass.
+#define SPARKLINE_COLUMNS     40
+#define SPARKLINE_FIRST_CHAR  8
+#define SPARKLINE_DECODE_STEP 256
+
+// Duty cycle measurement window (us.)
+#define DUTY_WINDOW 10000000UL
 
 // LCD backlight timeout (in ms.)
 #define LCD_LED_TIMEOUT    120000
 // LCD reset time
 #define LCD_RESET          10000
 
-// Frequency for serial console
+// Overshoot anticipation (see Anticipator.h): the slope is measured over
+// one to two windows (ms.), the peak after a cutoff is awaited for the
+// peak window (ms.) or until the temperature dropped (centi-degrees).
+// Estimates move 1/4 of the way per cycle, have 4 fractional bits and
+// are stored at most every 6 hours.
+#define ANTICIPATOR_SLOPE_WINDOW    120000UL
+#define ANTICIPATOR_WINDOW          1800000UL
+#define ANTICIPATOR_DROP            50
+#define ANTICIPATOR_SHIFT           2
+#define ANTICIPATOR_FRACTION_BITS   4
+#define ANTICIPATOR_COMMIT_INTERVAL 21600000UL
+#define ANTICIPATOR_REPORT_PERIOD   60000UL
+
+// Control modes (see Thermostat.h): the hysteresis loop or a PID
+// controller on a time proportioned relay (see Pid.h). The PID runs every
+// PID_PERIOD ms. (whole seconds), the output is in permille, the integral
+// has PID_FRACTION_BITS fractional bits and the derivative moves 1 /
+// 2^PID_DERIVATIVE_SHIFT of the way per period. The temperature change
+// per period is limited to PID_MAX_CHANGE centi-degrees, the integral
+// only runs within PID_INTEGRAL_BAND centi-degrees of the setpoint.
+#define CONTROL_HYSTERESIS   0
+#define CONTROL_PID          1
+#define CONTROL_MODES        2
+#define PID_PERIOD           10000L
+#define PID_OUTPUT_MAX       1000
+#define PID_FRACTION_BITS    8
+#define PID_DERIVATIVE_SHIFT 2
+#define PID_MAX_CHANGE       100
+#define PID_INTEGRAL_BAND    200
+
+// Accounting (see Accounting.h): the counters are stored at most once an
+// hour (ms.) and reported every minute in binary mode. Sets of counters
+// and the number of alarm causes (ALARM_* without ALARM_NONE).
+#define ACCOUNTING_FLUSH_INTERVAL 3600000UL
+#define ACCOUNTING_REPORT_PERIOD  60000UL
+#define ACCOUNTING_LIFETIME       0
+#define ACCOUNTING_TRIP           1
+#define ACCOUNTING_ALARM_CAUSES   3
+
+// Frequency for serial console (period of the reports, in ms.)
 #define SERIAL_FREQUENCY 10000
 
+// Telemetry on the serial console (see Telemetry.h): off, CSV lines or
+// binary frames. Reports that don't fit in the transmit buffer are
+// dropped instead of blocking the loop.
+#define TELEMETRY_OFF          0
+#define TELEMETRY_CSV          1
+#define TELEMETRY_BINARY       2
+#define TELEMETRY_MODES        3
+#define TELEMETRY_BAUD         9600
+#define TELEMETRY_BUFFER_SIZE  128
+#define TELEMETRY_MAX_FRAME    32
+#define TELEMETRY_CSV_LENGTH   96
+#define TELEMETRY_FRAME_STATUS 0x01
+#define TELEMETRY_FRAME_RESPONSE 0x02
+#define TELEMETRY_FRAME_ACCOUNTING 0x03
+#define TELEMETRY_FRAME_ANTICIPATOR 0x04
+#define TELEMETRY_FLAG_HEATING 0x01
+#define TELEMETRY_FLAG_ENABLED 0x02
+#define TELEMETRY_FLAG_GRACE   0x04
+#define TELEMETRY_FLAG_ALARM   0x08
+
+// Command channel on the serial console (see Commands.h): line length,
+// characters handled per loop pass and the parameters with their limits
+// (centi-degrees and seconds).
+#define COMMAND_LENGTH          32
+#define COMMAND_READ_LIMIT      16
+#define COMMAND_SETPOINT        0
+#define COMMAND_HYSTERESIS      1
+#define COMMAND_MIN_TEMPERATURE 2
+#define COMMAND_MAX_TEMPERATURE 3
+#define COMMAND_MAX_HEAT_TIME   4
+#define COMMAND_GRACE_TIME      5
+#define COMMAND_OFFSET          6
+#define COMMAND_OVERSAMPLING    7
+#define COMMAND_SERIAL          8
+#define COMMAND_TEMPERATURE     9
+#define COMMAND_ALARM           10
+#define COMMAND_COMMITS         11
+#define COMMAND_EEPROM_BYTES    12
+#define COMMAND_SLOPE           13
+#define COMMAND_RISE            14
+#define COMMAND_CONTROL         15
+#define COMMAND_PID_GAIN        16
+#define COMMAND_PID_INTEGRAL    17
+#define COMMAND_PID_DERIVATIVE  18
+#define COMMAND_PID_WINDOW      19
+#define COMMAND_PID_PULSE       20
+#define COMMAND_PID_OUTPUT      21
+#define COMMAND_OVERRUNS        22
+#define COMMAND_ADC_OVERRUNS    23
+#define COMMAND_PARAMETERS      24
+#define COMMAND_PARAMETER_TABLE {                                               \
+  {"setpoint",    MIN_REQUESTED_TEMPERATURE, MAX_REQUESTED_TEMPERATURE, true},  \
+  {"hysteresis",  0,                         MAX_HYSTERESIS,            true},  \
+  {"min",         MIN_MIN_TEMPERATURE,       MAX_MIN_TEMPERATURE,       true},  \
+  {"max",         0,                         MAX_MAX_TEMPERATURE,       true},  \
+  {"maxheat",     MIN_HEAT_TIME / 1000,      MAX_HEAT_TIME / 1000,      true},  \
+  {"grace",       0,                         MAX_GRACE_TIME / 1000,     true},  \
+  {"offset",      MIN_OFFSET_TEMPERATURE,    MAX_OFFSET_TEMPERATURE,    true},  \
+  {"oversample",  0,                         MAX_OVERSAMPLING,          true},  \
+  {"serial",      0,                         TELEMETRY_MODES - 1,       true},  \
+  {"temperature", 0,                         0,                         false}, \
+  {"alarm",       0,                         0,                         false}, \
+  {"commits",     0,                         0,                         false}, \
+  {"eebytes",     0,                         0,                         false}, \
+  {"slope",       0,                         0,                         false}, \
+  {"rise",        0,                         0,                         false}, \
+  {"control",     0,                         CONTROL_MODES - 1,         true},  \
+  {"gain",        0,                         MAX_PID_GAIN,              true},  \
+  {"integral",    0,                         MAX_PID_INTEGRAL_TIME,     true},  \
+  {"derivative",  0,                         MAX_PID_DERIVATIVE_TIME,   true},  \
+  {"window",      MIN_PID_WINDOW,            MAX_PID_WINDOW,            true},  \
+  {"pulse",       0,                         MAX_PID_WINDOW / 2,        true},  \
+  {"output",      0,                         0,                         false}, \
+  {"overruns",    0,                         0,                         false}, \
+  {"adcoverruns", 0,                         0,                         false}  \
+}
+
+// Alarm causes
+#define ALARM_NONE            0
+#define ALARM_MIN_TEMPERATURE 1
+#define ALARM_MAX_TEMPERATURE 2
+#define ALARM_MAX_HEAT_TIME   3
+
 #endif
 
@@ -0,0 +1,193 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+
+#include "Pid.h"
+#include "Functions.h"
+
+/*
+ * Clamp a value to a range
+ */
+static long limit(long _value, long _minimum, long _maximum) {
+  if(_value < _minimum) {
+    return _minimum;
+  }
+  if(_value > _maximum) {
+    return _maximum;
+  }
+  return _value;
+}
+
+/*
+ * Constructor, the tuning is owned by the caller (it's stored with the
+ * parameters) and read on every update.
+ */
+Pid::Pid(const pid_tuning_t * _tuning) {
+  tuning = _tuning;
+  reset();
+}
+
+/*
+ * Start over: no integral, a new window on the next update (e.g. when
+ * the control mode changes).
+ */
+void Pid::reset() {
+  started = false;
+  lastUpdate = 0;
+  lastTemperature = Centidegrees::fromRaw(0);
+  integral = 0;
+  proportional = 0;
+  derivative = 0;
+  output = 0;
+  windowStart = 0;
+  onTime = 0;
+  carry = 0;
+}
+
+/*
+ * Follow the temperature (called after every temperature sample), returns
+ * whether the relay should be on. _active is false while the heat can't
+ * reach the tank.
+ */
+bool Pid::update(unsigned long _millis, Centidegrees _temperature, Centidegrees _setpoint, bool _active) {
+  unsigned long window = (unsigned long)tuning->windowPeriod * 1000UL;
+  if(!started) {
+    started = true;
+    lastUpdate = _millis;
+    lastTemperature = _temperature;
+    compute(_temperature, _setpoint, _active);
+    windowStart = _millis;
+    startWindow(window);
+  }
+
+  if(diffUL(windowStart, _millis) >= window) {
+    windowStart = _millis;
+    startWindow(window);
+  }
+  if(diffUL(lastUpdate, _millis) >= PID_PERIOD) {
+    lastUpdate = _millis;
+    compute(_temperature, _setpoint, _active);
+    extendWindow(window, diffUL(windowStart, _millis));
+  }
+  return diffUL(windowStart, _millis) < onTime;
+}
+
+/*
+ * Compute the output from a new sample (every PID_PERIOD ms.).
+ */
+void Pid::compute(Centidegrees _temperature, Centidegrees _setpoint, bool _active) {
+  int error = (_setpoint - _temperature).raw();
+  long p = (long)tuning->gain * error / 100;
+
+  // The change per period is limited so the product can't overflow
+  long d = 0;
+  if(tuning->derivativeTime > 0) {
+    long change = limit((_temperature - lastTemperature).raw(), -PID_MAX_CHANGE, PID_MAX_CHANGE);
+    d = -((long)tuning->gain * change / 100) * tuning->derivativeTime / (PID_PERIOD / 1000);
+  }
+  d = limit(d, -32767, 32767);
+  derivative += (d - derivative) / (1 << PID_DERIVATIVE_SHIFT);
+  lastTemperature = _temperature;
+
+  // Anti-windup: only integrate while the output can still follow
+  long out = p + (integral >> PID_FRACTION_BITS) + derivative;
+  if(tuning->integralTime == 0) {
+    integral = 0;
+  } else if(_active && error <= PID_INTEGRAL_BAND && error >= -PID_INTEGRAL_BAND
+            && !(out >= PID_OUTPUT_MAX && error > 0) && !(out <= 0 && error < 0)) {
+    long step = limit(p, -PID_OUTPUT_MAX, PID_OUTPUT_MAX) << PID_FRACTION_BITS;
+    integral += step * (PID_PERIOD / 1000) / tuning->integralTime;
+    integral = limit(integral, 0, (long)PID_OUTPUT_MAX << PID_FRACTION_BITS);
+    out = p + (integral >> PID_FRACTION_BITS) + derivative;
+  }
+
+  proportional = limit(p, -32767, 32767);
+  output = limit(out, 0, PID_OUTPUT_MAX);
+}
+
+/*
+ * Fix the on time of a new window. A pulse that's too short is carried
+ * over to the next window instead of being lost, so a small output still
+ * adds up to a pulse every few windows. An off pulse that's too short
+ * leaves the relay on.
+ */
+void Pid::startWindow(unsigned long _window) {
+  unsigned long pulse = (unsigned long)tuning->minimumPulse * 1000UL;
+  onTime = (unsigned long)output * (_window / PID_OUTPUT_MAX) + carry;
+  carry = 0;
+  if(onTime >= _window || _window - onTime < pulse) {
+    onTime = _window;
+  } else if(onTime < pulse) {
+    carry = onTime;
+    onTime = 0;
+  }
+}
+
+/*
+ * Give the current window more on time when the output went up (e.g.
+ * hot water was drawn), without waiting for the next window. It never
+ * gets less, so a pulse that started runs its course. A new pulse has to
+ * last the minimum pulse, an off pulse that would be too short leaves
+ * the relay on.
+ */
+void Pid::extendWindow(unsigned long _window, unsigned long _elapsed) {
+  unsigned long pulse = (unsigned long)tuning->minimumPulse * 1000UL;
+  unsigned long wanted = (unsigned long)output * (_window / PID_OUTPUT_MAX);
+  if(wanted <= onTime || (onTime <= _elapsed && wanted < _elapsed + pulse)) {
+    return;
+  }
+  onTime = _window - wanted < pulse ? _window : wanted;
+}
+
+/*
+ * Output of the last period (permille of full power)
+ */
+int Pid::getOutput() {
+  return output;
+}
+
+/*
+ * Terms of the output (permille)
+ */
+int Pid::getProportional() {
+  return proportional;
+}
+
+int Pid::getIntegral() {
+  return integral >> PID_FRACTION_BITS;
+}
+
+int Pid::getDerivative() {
+  return derivative;
+}
+
+/*
+ * On time of the current window (ms.)
+ */
+unsigned long Pid::getOnTime() {
+  return onTime;
+}
@@ -0,0 +1,109 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+
+#ifndef _PID_H_
+#define _PID_H_
+
+#include <Arduino.h>
+#include "MagicNumbers.h"
+#include "Fixed.h"
+
+/*
+ * PID controller driving the relay with time proportioning, for loads
+ * that respond too slowly for the hysteresis loop to hold the setpoint
+ * (CONTROL_PID, see Thermostat.h).
+ *
+ * Every PID_PERIOD ms. the output (permille of full power) is computed
+ * in integer arithmetic from the error e = setpoint - temperature
+ * (centi-degrees):
+ *
+ *   output = Kp * (e + 1 / Ti * integral(e) - Td * d(temperature) / dt)
+ *
+ * The gain Kp is in permille per degree, the integral and derivative
+ * times Ti and Td in seconds (0 turns the term off). The integral is kept
+ * in permille with PID_FRACTION_BITS fractional bits, so a change of the
+ * gain doesn't bump the output. Against windup it only runs close to the
+ * setpoint (within PID_INTEGRAL_BAND, the recovery from a draw-off is
+ * left to the other terms) and while the output isn't saturated in the
+ * direction of the error. It's limited to the output range and held
+ * while _active is false (no heat demand, the relay can't act). The
+ * derivative is taken on the temperature instead of the error, so a new
+ * setpoint doesn't kick the output, and smoothed by 1 /
+ * 2^PID_DERIVATIVE_SHIFT per period.
+ *
+ * The relay is switched in windows of the window period: on for the
+ * output times the window from the start of the window, off for the
+ * rest. The on time is set at the start of the window and only extended
+ * after that, when the output went up. Pulses (on or off) shorter than
+ * the minimum pulse are avoided, so the relay doesn't chatter and the
+ * boiler isn't started for a few seconds: a short on pulse is carried
+ * over to the next window, a short off pulse leaves the relay on.
+ */
+
+/*
+ * The tuning as stored with the parameters (fixed widths, no padding).
+ */
+typedef struct pid_tuning {
+  int16_t gain;            // permille per degree
+  uint16_t integralTime;   // s.
+  uint16_t derivativeTime; // s.
+  uint16_t windowPeriod;   // s.
+  uint16_t minimumPulse;   // s.
+} pid_tuning_t;
+
+class Pid {
+  public:
+    Pid(const pid_tuning_t *);
+    void reset();
+    bool update(unsigned long _millis, Centidegrees _temperature, Centidegrees _setpoint, bool _active);
+
+    int getOutput();
+    int getProportional();
+    int getIntegral();
+    int getDerivative();
+    unsigned long getOnTime();
+
+  private:
+    const pid_tuning_t * tuning;
+    bool started;
+    unsigned long lastUpdate;
+    Centidegrees lastTemperature;
+    long integral;
+    int proportional;
+    int derivative;
+    int output;
+    unsigned long windowStart;
+    unsigned long onTime;
+    unsigned long carry;
+
+    void compute(Centidegrees _temperature, Centidegrees _setpoint, bool _active);
+    void startWindow(unsigned long _window);
+    void extendWindow(unsigned long _window, unsigned long _elapsed);
+};
+
+#endif
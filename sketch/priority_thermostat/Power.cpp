@@ -0,0 +1,152 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+#include "Power.h"
+
+#ifdef __AVR__
+#include <avr/interrupt.h>
+#include <avr/power.h>
+#include <avr/sleep.h>
+#endif
+
+volatile bool Power::pinChanged = false;
+
+/*
+ * Constructor
+ */
+Power::Power() {
+  windowStart = 0;
+  sleepMicros = 0;
+  lastWindow = 0;
+  lastSleep = 0;
+}
+
+/*
+ * Switch off what we don't use: the analog comparator, TWI, SPI and
+ * timer2.
+ */
+void Power::begin() {
+#ifdef __AVR__
+  ACSR |= _BV(ACD);
+  power_twi_disable();
+  power_spi_disable();
+  power_timer2_disable();
+#endif
+  windowStart = micros();
+}
+
+/*
+ * Wake up (and flag) on any change of a digital pin.
+ */
+void Power::watchPin(byte _pin) {
+#ifdef __AVR__
+  *digitalPinToPCMSK(_pin) |= _BV(digitalPinToPCMSKbit(_pin));
+  PCIFR = _BV(digitalPinToPCICRbit(_pin));
+  PCICR |= _BV(digitalPinToPCICRbit(_pin));
+#endif
+}
+
+/*
+ * Check (and clear) the pin change flag.
+ */
+bool Power::takePinChange() {
+  if(!pinChanged) {
+    return false;
+  }
+  pinChanged = false;
+  return true;
+}
+
+/*
+ * Sleep until the next interrupt (at most a timer0 tick). _idleMillis is
+ * the time until the next task is due: the AVR doesn't need it, elsewhere
+ * there are no interrupts to wait for and the clock is moved on by that
+ * much (a millisecond if it's unknown).
+ */
+void Power::sleep(unsigned long _idleMillis) {
+  unsigned long start = micros();
+
+#ifdef __AVR__
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  noInterrupts();
+  if(!pinChanged) {
+    sleep_enable();
+    interrupts();
+    sleep_cpu();
+    sleep_disable();
+  }
+  interrupts();
+#else
+  delay(_idleMillis > 0 ? _idleMillis : 1);
+#endif
+
+  unsigned long end = micros();
+  sleepMicros += end - start;
+  if(end - windowStart >= DUTY_WINDOW) {
+    lastWindow = end - windowStart;
+    lastSleep = sleepMicros;
+    windowStart = end;
+    sleepMicros = 0;
+  }
+}
+
+/*
+ * Active time in permille of the last window. A window only closes while
+ * sleeping, so a busy MCU is reported at 100%.
+ */
+unsigned int Power::getDutyCycle() {
+  if(lastWindow == 0 || micros() - windowStart >= 2 * DUTY_WINDOW) {
+    return 1000;
+  }
+  unsigned long sleeping = lastSleep / (lastWindow / 1000);
+  return sleeping >= 1000 ? 0 : 1000 - (unsigned int)sleeping;
+}
+
+/*
+ * Time spent active during the last window (us.)
+ */
+unsigned long Power::getActiveMicros() {
+  return lastWindow - lastSleep;
+}
+
+/*
+ * Time spent sleeping during the last window (us.)
+ */
+unsigned long Power::getSleepMicros() {
+  return lastSleep;
+}
+
+#ifdef __AVR__
+/*
+ * Pin change interrupts only flag the change, the main loop picks it up.
+ */
+ISR(PCINT0_vect) {
+  Power::pinChanged = true;
+}
+ISR(PCINT1_vect, ISR_ALIASOF(PCINT0_vect));
+ISR(PCINT2_vect, ISR_ALIASOF(PCINT0_vect));
+#endif
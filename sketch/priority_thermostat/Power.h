@@ -0,0 +1,65 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+#ifndef _POWER_H_
+#define _POWER_H_
+
+#include <Arduino.h>
+#include "MagicNumbers.h"
+
+/*
+ * Idle handling between scheduler ticks. The MCU sleeps in idle mode,
+ * the deepest mode that keeps timer0 (millis), timer1 (ADC trigger), the
+ * ADC and the UART running. Any interrupt wakes it up again: the timer0
+ * tick, a conversion, serial traffic or a change on a watched pin. Unused
+ * peripherals are switched off.
+ *
+ * The time spent sleeping is measured with micros(), the duty cycle is
+ * calculated over windows of DUTY_WINDOW us.
+ */
+class Power {
+  public:
+    Power();
+    void begin();
+    void watchPin(byte _pin);
+    bool takePinChange();
+    void sleep(unsigned long _idleMillis = 0);
+
+    unsigned int getDutyCycle();
+    unsigned long getActiveMicros();
+    unsigned long getSleepMicros();
+
+    static volatile bool pinChanged;
+
+  private:
+    unsigned long windowStart;
+    unsigned long sleepMicros;
+    unsigned long lastWindow;
+    unsigned long lastSleep;
+};
+
+#endif
@@ -0,0 +1,162 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+#include "Profiler.h"
+
+#if PROFILING
+
+Profiler profiler;
+
+static const char profileNames[PROFILE_STAGES][11] PROGMEM = PROFILE_NAMES;
+
+/*
+ * Constructor
+ */
+Profiler::Profiler() {
+  reset();
+}
+
+/*
+ * Record the duration of a stage.
+ */
+void Profiler::record(byte _stage, unsigned long _micros) {
+  profile_stats_t * stat = &stats[_stage];
+  uint16_t duration = _micros > 0xFFFFUL ? 0xFFFF : (uint16_t)_micros;
+
+  if(duration < stat->minimum) {
+    stat->minimum = duration;
+  }
+  if(duration > stat->maximum) {
+    stat->maximum = duration;
+  }
+
+  // Bucket: position of the highest bit
+  byte bucket = 0;
+  uint16_t value = duration;
+  if(value & 0xFF00) {
+    bucket = 8;
+    value >>= 8;
+  }
+  if(value & 0xF0) {
+    bucket += 4;
+    value >>= 4;
+  }
+  if(value & 0x0C) {
+    bucket += 2;
+    value >>= 2;
+  }
+  if(value & 0x02) {
+    bucket += 1;
+  }
+  if(bucket >= PROFILE_BUCKETS) {
+    bucket = PROFILE_BUCKETS - 1;
+  }
+
+  // Decay before anything overflows
+  if(stat->count == 0xFFFF || stat->histogram[bucket] == 0xFFFF) {
+    stat->count >>= 1;
+    stat->total >>= 1;
+    for(byte i=0; i<PROFILE_BUCKETS; ++i) {
+      stat->histogram[i] >>= 1;
+    }
+  }
+  ++stat->count;
+  stat->total += duration;
+  ++stat->histogram[bucket];
+}
+
+/*
+ * Clear all statistics.
+ */
+void Profiler::reset() {
+  for(byte i=0; i<PROFILE_STAGES; ++i) {
+    stats[i].minimum = 0xFFFF;
+    stats[i].maximum = 0;
+    stats[i].total = 0;
+    stats[i].count = 0;
+    for(byte j=0; j<PROFILE_BUCKETS; ++j) {
+      stats[i].histogram[j] = 0;
+    }
+  }
+}
+
+/*
+ * Print all statistics, one line per stage:
+ *   name;count;min;mean;max;bucket 0;...;bucket n
+ */
+void Profiler::dump(Print * _out) {
+  for(byte i=0; i<PROFILE_STAGES; ++i) {
+    _out->print(getName(i));
+    _out->print(";");
+    _out->print(stats[i].count);
+    _out->print(";");
+    _out->print(getMinimum(i));
+    _out->print(";");
+    _out->print(getMean(i));
+    _out->print(";");
+    _out->print(stats[i].maximum);
+    for(byte j=0; j<PROFILE_BUCKETS; ++j) {
+      _out->print(";");
+      _out->print(stats[i].histogram[j]);
+    }
+    _out->println();
+  }
+}
+
+/*
+ * Name of a stage (copied from flash into a static buffer).
+ */
+const char * Profiler::getName(byte _stage) {
+  static char name[11];
+  strcpy_P(name, profileNames[_stage]);
+  return name;
+}
+
+/*
+ * Retrieve statistics
+ */
+uint16_t Profiler::getMinimum(byte _stage) {
+  return stats[_stage].count == 0 ? 0 : stats[_stage].minimum;
+}
+
+uint16_t Profiler::getMaximum(byte _stage) {
+  return stats[_stage].maximum;
+}
+
+uint16_t Profiler::getMean(byte _stage) {
+  return stats[_stage].count == 0 ? 0 : stats[_stage].total / stats[_stage].count;
+}
+
+uint16_t Profiler::getCount(byte _stage) {
+  return stats[_stage].count;
+}
+
+uint16_t Profiler::getBucket(byte _stage, byte _bucket) {
+  return stats[_stage].histogram[_bucket];
+}
+
+#endif
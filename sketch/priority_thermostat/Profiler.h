@@ -0,0 +1,83 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <Arduino.h>
+#include "MagicNumbers.h"
+
+/*
+ * Timing instrumentation of the main stages (enable with PROFILING in
+ * MagicNumbers.h). Every stage keeps its minimum, maximum, mean and a
+ * histogram with power of two buckets (bucket n counts durations from
+ * 2^n up to 2^(n+1) us., the last one everything above). Durations are
+ * in us. and saturate at 65535.
+ *
+ * The mean and the histogram decay: when a counter is about to overflow,
+ * the counters of that stage are halved.
+ *
+ * When PROFILING is 0 the macros expand to nothing.
+ */
+typedef struct profile_stats {
+  uint16_t minimum;
+  uint16_t maximum;
+  unsigned long total;
+  uint16_t count;
+  uint16_t histogram[PROFILE_BUCKETS];
+} profile_stats_t;
+
+class Profiler {
+  public:
+    Profiler();
+    void record(byte _stage, unsigned long _micros);
+    void reset();
+    void dump(Print * _out);
+
+    const char * getName(byte _stage);
+    uint16_t getMinimum(byte _stage);
+    uint16_t getMaximum(byte _stage);
+    uint16_t getMean(byte _stage);
+    uint16_t getCount(byte _stage);
+    uint16_t getBucket(byte _stage, byte _bucket);
+
+  private:
+    profile_stats_t stats[PROFILE_STAGES];
+};
+
+#if PROFILING
+extern Profiler profiler;
+#define PROFILE_START(_stage) unsigned long profileStart##_stage = micros()
+#define PROFILE_STOP(_stage)  profiler.record(_stage, micros() - profileStart##_stage)
+#define PROFILE_RECORD(_stage, _micros) profiler.record(_stage, _micros)
+#else
+#define PROFILE_START(_stage)
+#define PROFILE_STOP(_stage)
+#define PROFILE_RECORD(_stage, _micros)
+#endif
+
+#endif
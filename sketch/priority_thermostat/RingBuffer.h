@@ -0,0 +1,143 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+#ifndef _RINGBUFFER_H_
+#define _RINGBUFFER_H_
+
+#include <Arduino.h>
+
+// Keeps the compiler from moving buffer accesses across index updates.
+#define RING_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+/*
+ * Single producer, single consumer ring buffer. The producer is typically
+ * an interrupt routine and the consumer the main loop. Both sides only
+ * write their own index, and byte sized indexes are read atomically on
+ * the AVR, so no locking is required.
+ *
+ * N must be a power of two (at most 128) so the free running indexes can
+ * wrap around naturally.
+ */
+template<typename T, byte N>
+class RingBuffer {
+  static_assert(N > 0 && N <= 128 && (N & (N - 1)) == 0,
+                "RingBuffer size must be a power of two, at most 128");
+
+  public:
+    RingBuffer();
+    bool push(const T & _value);
+    bool pop(T & _value);
+    bool peek(T & _value);
+    byte available();
+    byte space();
+    void clear();
+
+  private:
+    T items[N];
+    volatile byte head;
+    volatile byte tail;
+};
+
+/*
+ * Constructor
+ */
+template<typename T, byte N>
+RingBuffer<T, N>::RingBuffer() {
+  head = 0;
+  tail = 0;
+}
+
+/*
+ * Add a value (producer side). Returns false if the buffer is full, the
+ * value is dropped in that case.
+ */
+template<typename T, byte N>
+bool RingBuffer<T, N>::push(const T & _value) {
+  byte index = head;
+  if((byte)(index - tail) >= N) {
+    return false;
+  }
+  items[index & (N - 1)] = _value;
+  RING_BARRIER();
+  head = index + 1;
+  return true;
+}
+
+/*
+ * Take the oldest value (consumer side). Returns false if the buffer
+ * is empty.
+ */
+template<typename T, byte N>
+bool RingBuffer<T, N>::pop(T & _value) {
+  byte index = tail;
+  if(index == head) {
+    return false;
+  }
+  _value = items[index & (N - 1)];
+  RING_BARRIER();
+  tail = index + 1;
+  return true;
+}
+
+/*
+ * Look at the oldest value without removing it (consumer side).
+ */
+template<typename T, byte N>
+bool RingBuffer<T, N>::peek(T & _value) {
+  byte index = tail;
+  if(index == head) {
+    return false;
+  }
+  _value = items[index & (N - 1)];
+  return true;
+}
+
+/*
+ * Number of values waiting in the buffer.
+ */
+template<typename T, byte N>
+byte RingBuffer<T, N>::available() {
+  return head - tail;
+}
+
+/*
+ * Number of values that can still be pushed.
+ */
+template<typename T, byte N>
+byte RingBuffer<T, N>::space() {
+  return N - (byte)(head - tail);
+}
+
+/*
+ * Drop all waiting values (consumer side).
+ */
+template<typename T, byte N>
+void RingBuffer<T, N>::clear() {
+  tail = head;
+}
+
+#endif
@@ -0,0 +1,113 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+#include "Scheduler.h"
+#include "Functions.h"
+
+/*
+ * Constructor
+ */
+Scheduler::Scheduler(task_t * _tasks, byte _count) {
+  tasks = _tasks;
+  count = _count;
+}
+
+/*
+ * Make all tasks due right away.
+ */
+void Scheduler::begin(unsigned long _millis) {
+  for(byte i=0; i<count; ++i) {
+    tasks[i].nextDue = _millis;
+    tasks[i].overruns = 0;
+  }
+}
+
+/*
+ * Run the most urgent task that is due. Returns false if no task was due.
+ */
+bool Scheduler::dispatch(unsigned long _millis) {
+  task_t * selected = NULL;
+  for(byte i=0; i<count; ++i) {
+    task_t * task = &tasks[i];
+    if(beforeUL(_millis, task->nextDue)) {
+      continue;
+    }
+    if(selected == NULL || beforeUL(task->nextDue + task->deadline, selected->nextDue + selected->deadline)) {
+      selected = task;
+    }
+  }
+  if(selected == NULL) {
+    return false;
+  }
+
+  selected->run(_millis);
+
+  unsigned long finished = millis();
+  if(beforeUL(selected->nextDue + selected->deadline, finished)) {
+    ++selected->overruns;
+  }
+  selected->nextDue += selected->period;
+  if(!beforeUL(finished, selected->nextDue)) {
+    selected->nextDue = finished + selected->period;
+  }
+  return true;
+}
+
+/*
+ * Make a task due right away (e.g. after an external event).
+ */
+void Scheduler::trigger(byte _task) {
+  tasks[_task].nextDue = millis();
+}
+
+/*
+ * Time until the next task is due (0 if one is due already).
+ */
+unsigned long Scheduler::timeUntilNext(unsigned long _millis) {
+  unsigned long shortest = 0xFFFFFFFFUL;
+  for(byte i=0; i<count; ++i) {
+    if(!beforeUL(_millis, tasks[i].nextDue)) {
+      return 0;
+    }
+    unsigned long remaining = tasks[i].nextDue - _millis;
+    if(remaining < shortest) {
+      shortest = remaining;
+    }
+  }
+  return shortest;
+}
+
+/*
+ * Number of missed deadlines over all tasks.
+ */
+unsigned long Scheduler::getTotalOverruns() {
+  unsigned long total = 0;
+  for(byte i=0; i<count; ++i) {
+    total += tasks[i].overruns;
+  }
+  return total;
+}
@@ -0,0 +1,68 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+#include <Arduino.h>
+#include "MagicNumbers.h"
+
+typedef void (*task_function_t)(unsigned long);
+
+/*
+ * A periodic task. The deadline is relative to the time the task was due:
+ * a run that finishes later than that counts as an overrun.
+ */
+typedef struct task {
+  task_function_t run;
+  unsigned long period;
+  unsigned long deadline;
+  unsigned long nextDue;
+  unsigned int overruns;
+} task_t;
+
+/*
+ * Cooperative scheduler on a static task table. dispatch() runs the due
+ * task with the earliest deadline, tasks never preempt each other. A task
+ * that falls behind more than a period skips the missed runs instead of
+ * running in a burst.
+ */
+class Scheduler {
+  public:
+    Scheduler(task_t * _tasks, byte _count);
+    void begin(unsigned long _millis);
+    bool dispatch(unsigned long _millis);
+    void trigger(byte _task);
+    unsigned long timeUntilNext(unsigned long _millis);
+    unsigned long getTotalOverruns();
+
+  private:
+    task_t * tasks;
+    byte count;
+};
+
+#endif
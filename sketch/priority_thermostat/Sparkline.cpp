@@ -0,0 +1,232 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+
+#include "Sparkline.h"
+
+/*
+ * Constructor
+ */
+Sparkline::Sparkline(History * _history) {
+  history = _history;
+  historyGeneration = 0;
+  decoding = false;
+  ready = false;
+  pendingGlyphs = 0;
+  generation = 0;
+
+  sample = 0;
+  samples = 0;
+  column = 0;
+  columnSum = 0;
+  columnCount = 0;
+  minimum = HistoryTemperature::fromRaw(0);
+  maximum = HistoryTemperature::fromRaw(0);
+  shownSamples = 0;
+}
+
+/*
+ * Do a bit of work on the graph (called on every render pass while the
+ * graph is shown). Returns true if a glyph was defined, which moves the
+ * LCD cursor.
+ */
+bool Sparkline::step(LiquidCrystal * _lcd) {
+  if(pendingGlyphs != 0) {
+    byte glyph = 0;
+    while(!(pendingGlyphs & (1 << glyph))) {
+      ++glyph;
+    }
+    pendingGlyphs &= ~(1 << glyph);
+    drawGlyph(_lcd, glyph);
+    return true;
+  }
+
+  if(decoding && history->getGeneration() != historyGeneration) {
+    decoding = false;
+  }
+  if(!decoding) {
+    if(ready && history->getGeneration() == historyGeneration) {
+      return false;
+    }
+    start();
+  }
+  decode();
+  return false;
+}
+
+/*
+ * The glyphs have to be defined again (e.g. after an LCD reset). While a
+ * graph is decoded they are sent once it's complete anyway.
+ */
+void Sparkline::invalidate() {
+  if(ready && !decoding) {
+    pendingGlyphs = 0xFF;
+  }
+}
+
+/*
+ * Check if there's a graph on the display.
+ */
+bool Sparkline::isReady() {
+  return ready;
+}
+
+/*
+ * Lowest and highest column of the graph on the display (centi-degrees).
+ */
+Centidegrees Sparkline::getMinimum() {
+  return history->toTemperature(minimum.raw());
+}
+
+Centidegrees Sparkline::getMaximum() {
+  return history->toTemperature(maximum.raw());
+}
+
+/*
+ * Number of samples in the graph on the display.
+ */
+unsigned int Sparkline::getSamples() {
+  return shownSamples;
+}
+
+/*
+ * Generation counter: changes whenever a graph is complete.
+ */
+byte Sparkline::getGeneration() {
+  return generation;
+}
+
+/*
+ * Start a new graph from the oldest sample.
+ */
+void Sparkline::start() {
+  history->rewind(cursor);
+  historyGeneration = history->getGeneration();
+  samples = history->getSamples();
+  sample = 0;
+  column = 0;
+  columnSum = 0;
+  columnCount = 0;
+  for(byte i=0; i<SPARKLINE_COLUMNS; ++i) {
+    columns[i] = HistoryTemperature::invalid();
+  }
+  memset(relays, 0, sizeof(relays));
+  decoding = true;
+}
+
+/*
+ * Decode the next SPARKLINE_DECODE_STEP samples into their columns. With
+ * fewer samples than columns, the graph is aligned to the right.
+ */
+void Sparkline::decode() {
+  for(unsigned int i=0; i<SPARKLINE_DECODE_STEP; ++i) {
+    if(sample >= samples || !history->next(cursor)) {
+      finish();
+      return;
+    }
+
+    byte target;
+    if(samples >= SPARKLINE_COLUMNS) {
+      target = (unsigned long)sample * SPARKLINE_COLUMNS / samples;
+    } else {
+      target = SPARKLINE_COLUMNS - samples + sample;
+    }
+    if(target != column) {
+      closeColumn();
+      column = target;
+    }
+    columnSum += cursor.value;
+    ++columnCount;
+    if(cursor.relay) {
+      relays[column >> 3] |= 1 << (column & 0x07);
+    }
+    ++sample;
+  }
+}
+
+/*
+ * Store the mean of the column that is complete.
+ */
+void Sparkline::closeColumn() {
+  if(columnCount > 0) {
+    long half = columnSum < 0 ? -(long)(columnCount / 2) : columnCount / 2;
+    columns[column] = HistoryTemperature::saturate((columnSum + half) / (long)columnCount);
+  }
+  columnSum = 0;
+  columnCount = 0;
+}
+
+/*
+ * The graph is decoded: find the scale and send all glyphs.
+ */
+void Sparkline::finish() {
+  closeColumn();
+  decoding = false;
+
+  bool first = true;
+  for(byte i=0; i<SPARKLINE_COLUMNS; ++i) {
+    if(!columns[i].isValid()) {
+      continue;
+    }
+    if(first || columns[i] < minimum) {
+      minimum = columns[i];
+    }
+    if(first || columns[i] > maximum) {
+      maximum = columns[i];
+    }
+    first = false;
+  }
+
+  shownSamples = sample;
+  ready = true;
+  pendingGlyphs = 0xFF;
+  ++generation;
+}
+
+/*
+ * Define a glyph from its five columns: a bar of 1 to 7 pixels from the
+ * bottom up, and the relay in the bottom row.
+ */
+void Sparkline::drawGlyph(LiquidCrystal * _lcd, byte _glyph) {
+  byte rows[8];
+  memset(rows, 0, sizeof(rows));
+  int range = (maximum - minimum).raw();
+  for(byte x=0; x<5; ++x) {
+    byte index = _glyph * 5 + x;
+    byte bit = 0x10 >> x;
+    if(columns[index].isValid()) {
+      byte height = range == 0 ? 4 : 1 + multiplyWide((columns[index] - minimum).raw(), 6) / range;
+      for(byte y=7 - height; y<7; ++y) {
+        rows[y] |= bit;
+      }
+    }
+    if(relays[index >> 3] & (1 << (index & 0x07))) {
+      rows[7] |= bit;
+    }
+  }
+  _lcd->createChar(_glyph, rows);
+}
@@ -0,0 +1,94 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+
+#ifndef _SPARKLINE_H_
+#define _SPARKLINE_H_
+
+#include <Arduino.h>
+#include <LiquidCrystal.h>
+#include "MagicNumbers.h"
+#include "History.h"
+
+/*
+ * Draws the history (see History.h) as a bar graph in the eight custom
+ * characters of the HD44780, shown side by side as SPARKLINE_FIRST_CHAR
+ * and up: 40 columns of 5 x 8 pixels. Each column is the mean
+ * temperature of its share of the history, scaled between the minimum
+ * and the maximum in 1 to 7 pixels; the bottom pixel row shows when the
+ * relay was on.
+ *
+ * The work is spread over the render passes, step() decodes at most
+ * SPARKLINE_DECODE_STEP samples or defines a single glyph, so drawing
+ * never stalls the control loop. The glyphs of the previous graph stay
+ * on the display until the new one is complete. A new graph is started
+ * when samples were added to the history.
+ */
+class Sparkline {
+  public:
+    Sparkline(History * _history);
+    bool step(LiquidCrystal * _lcd);
+    void invalidate();
+    bool isReady();
+    Centidegrees getMinimum();
+    Centidegrees getMaximum();
+    unsigned int getSamples();
+
+    // Generation counter, incremented when a graph is complete
+    byte getGeneration();
+
+  private:
+    History * history;
+    history_cursor_t cursor;
+    byte historyGeneration;
+    bool decoding;
+    bool ready;
+    byte pendingGlyphs;
+    byte generation;
+
+    // the graph being decoded
+    unsigned int sample;
+    unsigned int samples;
+    byte column;
+    long columnSum;
+    unsigned int columnCount;
+    HistoryTemperature columns[SPARKLINE_COLUMNS];
+    byte relays[(SPARKLINE_COLUMNS + 7) / 8];
+
+    // the graph on the display
+    HistoryTemperature minimum;
+    HistoryTemperature maximum;
+    unsigned int shownSamples;
+
+    void start();
+    void decode();
+    void closeColumn();
+    void finish();
+    void drawGlyph(LiquidCrystal * _lcd, byte _glyph);
+};
+
+#endif
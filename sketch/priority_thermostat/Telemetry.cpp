@@ -0,0 +1,186 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+#include "Telemetry.h"
+#include "Functions.h"
+
+/*
+ * Constructor
+ */
+Telemetry::Telemetry(HardwareSerial * _port) {
+  port = _port;
+  active = false;
+  frameLength = 0;
+  frameOverflow = false;
+  drops = 0;
+  frames = 0;
+}
+
+/*
+ * Open the serial port.
+ */
+void Telemetry::begin(unsigned long _baud) {
+  port->begin(_baud);
+  active = true;
+}
+
+/*
+ * Close the serial port, whatever is still waiting is dropped.
+ */
+void Telemetry::end() {
+  port->end();
+  active = false;
+  buffer.clear();
+}
+
+/*
+ * Check if the serial port is open.
+ */
+bool Telemetry::isActive() {
+  return active;
+}
+
+/*
+ * Make sure a line of text of at most the given length fits in the
+ * buffer. If not, the line has to be skipped (it is counted as dropped).
+ */
+bool Telemetry::reserve(byte _length) {
+  if(!active || buffer.space() < _length) {
+    ++drops;
+    return false;
+  }
+  return true;
+}
+
+/*
+ * Write a single character (Print interface).
+ */
+size_t Telemetry::write(uint8_t _value) {
+  return active && buffer.push(_value) ? 1 : 0;
+}
+
+/*
+ * Start a binary frame of the given type.
+ */
+void Telemetry::beginFrame(byte _type) {
+  frame[0] = _type;
+  frameLength = 1;
+  frameOverflow = false;
+}
+
+/*
+ * Add little endian values to the frame.
+ */
+void Telemetry::put8(uint8_t _value) {
+  if(frameLength < TELEMETRY_MAX_FRAME - 2) {
+    frame[frameLength++] = _value;
+  } else {
+    frameOverflow = true;
+  }
+}
+
+void Telemetry::put16(uint16_t _value) {
+  put8(_value);
+  put8(_value >> 8);
+}
+
+void Telemetry::put32(uint32_t _value) {
+  put16(_value);
+  put16(_value >> 16);
+}
+
+/*
+ * Add the CRC and queue the COBS encoded frame. Returns false if the
+ * frame was dropped (no room in the buffer).
+ */
+bool Telemetry::endFrame() {
+  if(!active || frameOverflow) {
+    ++drops;
+    return false;
+  }
+
+  uint16_t crc = 0xFFFF;
+  for(byte i=0; i<frameLength; ++i) {
+    crc = crc16Update(crc, frame[i]);
+  }
+  frame[frameLength++] = crc;
+  frame[frameLength++] = crc >> 8;
+
+  // One code byte per 254 bytes at most, and the delimiter
+  if(buffer.space() < frameLength + frameLength / 254 + 2) {
+    ++drops;
+    return false;
+  }
+
+  // Each run of non-zero bytes is preceded by its length + 1, the zero
+  // that ends the run is implied.
+  byte start = 0;
+  while(start <= frameLength) {
+    byte end = start;
+    while(end < frameLength && frame[end] != 0 && end - start < 254) {
+      ++end;
+    }
+    buffer.push(end - start + 1);
+    for(byte i=start; i<end; ++i) {
+      buffer.push(frame[i]);
+    }
+    if(end - start == 254 && end < frameLength) {
+      start = end;
+    } else {
+      start = end + 1;
+    }
+  }
+  buffer.push(0);
+
+  ++frames;
+  return true;
+}
+
+/*
+ * Move as much as the UART can take without blocking.
+ */
+void Telemetry::drain() {
+  byte value;
+  while(port->availableForWrite() > 0 && buffer.peek(value)) {
+    port->write(value);
+    buffer.pop(value);
+  }
+}
+
+/*
+ * Number of frames or lines dropped because the buffer was full.
+ */
+unsigned int Telemetry::getDrops() {
+  return drops;
+}
+
+/*
+ * Number of frames queued.
+ */
+unsigned int Telemetry::getFrames() {
+  return frames;
+}
@@ -0,0 +1,84 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+#include <Arduino.h>
+#include "MagicNumbers.h"
+#include "RingBuffer.h"
+
+/*
+ * Non-blocking output on the serial port. Everything that is written goes
+ * into a ring buffer first, drain() moves it to the UART only as far as
+ * the UART has room, so reporting never stalls the loop. Output that
+ * doesn't fit is dropped as a whole (a frame or a reserved line) and
+ * counted.
+ *
+ * Text can be written with the usual Print functions after reserve().
+ * Binary frames are built with beginFrame(), put8/16/32() (little endian)
+ * and endFrame(), and are sent as:
+ *
+ *   COBS(type, payload, CRC-16 little endian) 0x00
+ *
+ * The CRC-16 is CRC-16/CCITT-FALSE (polynomial 0x1021, initial value
+ * 0xFFFF) over the type and the payload. COBS encoding removes all zero
+ * bytes from the frame, so a zero always marks the end of a frame.
+ */
+class Telemetry : public Print {
+  public:
+    Telemetry(HardwareSerial * _port);
+    void begin(unsigned long _baud);
+    void end();
+    bool isActive();
+
+    bool reserve(byte _length);
+    virtual size_t write(uint8_t _value);
+    using Print::write;
+
+    void beginFrame(byte _type);
+    void put8(uint8_t _value);
+    void put16(uint16_t _value);
+    void put32(uint32_t _value);
+    bool endFrame();
+
+    void drain();
+    unsigned int getDrops();
+    unsigned int getFrames();
+
+  private:
+    HardwareSerial * port;
+    bool active;
+    RingBuffer<byte, TELEMETRY_BUFFER_SIZE> buffer;
+    byte frame[TELEMETRY_MAX_FRAME];
+    byte frameLength;
+    bool frameOverflow;
+    unsigned int drops;
+    unsigned int frames;
+};
+
+#endif
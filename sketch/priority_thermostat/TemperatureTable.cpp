@@ -0,0 +1,160 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+#include "TemperatureTable.h"
+
+/*
+ * Everything below is evaluated by the compiler, only the table itself
+ * ends up in flash.
+ */
+
+constexpr long calX[CALIBRATION_SET_SIZE] = CALIBRATION_RAW;
+constexpr long calY[CALIBRATION_SET_SIZE] = CALIBRATION_TEMPERATURE;
+constexpr double polynomial[4] = THERMISTOR_POLYNOMIAL;
+
+// Position within a segment of the calibration set
+typedef Fixed<int32_t, 1000> Fraction;
+
+/*
+ * Determine reference frame (when going out of bounds, take the closest)
+ */
+constexpr byte calibrationSegment(long _value, byte _i) {
+  return (_i == 0 || _value >= calX[_i]) ? _i : calibrationSegment(_value, _i - 1);
+}
+
+/*
+ * Position within a segment (below 0 or above 1 outside of it).
+ */
+constexpr Fraction segmentPart(long _value, byte _i0) {
+  return Fraction::saturate((_value - calX[_i0]) * Fraction::scale() / (calX[_i0 + 1] - calX[_i0]));
+}
+
+/*
+ * Interpolate within a segment.
+ */
+constexpr long interpolateSegment(long _value, byte _i0) {
+  return (calY[_i0] * (Fraction::fromUnits(1) - segmentPart(_value, _i0)).raw()
+          + calY[_i0 + 1] * segmentPart(_value, _i0).raw()) / Fraction::scale();
+}
+
+/*
+ * Linear interpolation on the calibration set, _value is the ADC value
+ * multiplied by 100 (like the calibration set).
+ */
+constexpr long interpolateTemperature(long _value) {
+  return interpolateSegment(_value, calibrationSegment(_value, CALIBRATION_SET_SIZE - 2));
+}
+
+/*
+ * Evaluate the polynomial (Horner) and round to centi-degrees.
+ */
+constexpr long roundTemperature(double _value) {
+  return (long)(_value >= 0 ? _value + 0.5 : _value - 0.5);
+}
+
+constexpr long polynomialTemperature(double _x) {
+  return roundTemperature(((polynomial[3] * _x + polynomial[2]) * _x + polynomial[1]) * _x + polynomial[0]);
+}
+
+/*
+ * Temperatures outside of the int16_t range are clipped (those are
+ * shorted or disconnected thermistors anyway), never to the invalid
+ * value.
+ */
+constexpr int16_t clampTemperature(long _value) {
+  return Centidegrees::saturate(_value).raw();
+}
+
+/*
+ * Table entry for an index.
+ */
+constexpr int16_t tableEntry(unsigned int _index) {
+  return clampTemperature(THERMISTOR_CURVE == CURVE_POLYNOMIAL
+    ? polynomialTemperature((double)_index / (1 << (TEMPERATURE_TABLE_BITS - 10)) - 512.0)
+    : interpolateTemperature(((long)_index * 100L) >> (TEMPERATURE_TABLE_BITS - 10)));
+}
+
+/*
+ * Compile time list 0, 1, ..., N-1 to expand the table initializer.
+ * Built by halving, so the template depth stays logarithmic.
+ */
+template<unsigned int... I>
+struct IndexList {};
+
+template<typename A, typename B>
+struct ConcatIndexList;
+
+template<unsigned int... A, unsigned int... B>
+struct ConcatIndexList<IndexList<A...>, IndexList<B...> > {
+  typedef IndexList<A..., (sizeof...(A) + B)...> type;
+};
+
+template<unsigned int N>
+struct MakeIndexList {
+  typedef typename ConcatIndexList<typename MakeIndexList<N / 2>::type,
+                                   typename MakeIndexList<N - N / 2>::type>::type type;
+};
+
+template<>
+struct MakeIndexList<0> {
+  typedef IndexList<> type;
+};
+
+template<>
+struct MakeIndexList<1> {
+  typedef IndexList<0> type;
+};
+
+template<unsigned int... I>
+constexpr temperature_table_t buildTable(IndexList<I...>) {
+  return temperature_table_t {{ tableEntry(I)... }};
+}
+
+constexpr temperature_table_t temperatureTable PROGMEM =
+  buildTable(MakeIndexList<TEMPERATURE_TABLE_SIZE>::type());
+
+/*
+ * Compile time check of the table against the calibration set: exact for
+ * the linear curve, within CALIBRATION_TOLERANCE for the polynomial.
+ */
+constexpr long tableAt(long _raw) {
+  return temperatureTable.values[(_raw / 100L) << (TEMPERATURE_TABLE_BITS - 10)];
+}
+
+constexpr long absolute(long _value) {
+  return _value < 0 ? -_value : _value;
+}
+
+constexpr bool matchesCalibration(byte _i) {
+  return _i >= CALIBRATION_SET_SIZE
+    || (absolute(tableAt(calX[_i]) - calY[_i]) <= (THERMISTOR_CURVE == CURVE_POLYNOMIAL ? CALIBRATION_TOLERANCE : 0)
+        && matchesCalibration(_i + 1));
+}
+
+static_assert(matchesCalibration(0), "Temperature table doesn't match the calibration set");
+static_assert(THERMISTOR_CURVE != CURVE_LINEAR || tableAt(50000L) == 4230,
+              "Temperature table doesn't match the interpolation");
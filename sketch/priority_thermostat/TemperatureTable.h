@@ -0,0 +1,70 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+#ifndef _TEMPERATURETABLE_H_
+#define _TEMPERATURETABLE_H_
+
+#include <Arduino.h>
+#include "MagicNumbers.h"
+#include "Fixed.h"
+
+/*
+ * ADC value to temperature conversion through a lookup table in flash.
+ * The table is generated by the compiler from the calibration set, so
+ * the conversion at run time is a single pgm_read_word.
+ *
+ * Raw values are left aligned to 16 bits (see ADC_RAW_SHIFT), the table
+ * is indexed by the TEMPERATURE_TABLE_BITS most significant bits. The
+ * entries are in centi-degrees (see Centidegrees in Fixed.h), the
+ * calibration set holds the ADC values multiplied by 100.
+ *
+ * Two generators are available (THERMISTOR_CURVE):
+ *  - CURVE_LINEAR: linear interpolation between the calibration points
+ *    (identical to the original run time interpolation).
+ *  - CURVE_POLYNOMIAL: a third degree polynomial in (ADC value - 512),
+ *    see THERMISTOR_POLYNOMIAL.
+ */
+
+#define TEMPERATURE_TABLE_SIZE (1U << TEMPERATURE_TABLE_BITS)
+
+static_assert(TEMPERATURE_TABLE_BITS >= 10 && TEMPERATURE_TABLE_BITS <= 12,
+              "TEMPERATURE_TABLE_BITS must be between 10 and 12");
+
+typedef struct temperature_table {
+  int16_t values[TEMPERATURE_TABLE_SIZE];
+} temperature_table_t;
+
+extern const temperature_table_t temperatureTable PROGMEM;
+
+/*
+ * Convert a raw (16 bit, left aligned) value to a temperature.
+ */
+inline Centidegrees lookupTemperature(uint16_t _raw) {
+  return Centidegrees::fromRaw(pgm_read_word(&temperatureTable.values[_raw >> (16 - TEMPERATURE_TABLE_BITS)]));
+}
+
+#endif
@@ -26,9 +26,12 @@
  */
 
 #include "Thermostat.h"
+#include "Format.h"
 #include "stdlib.h"
+#include "stddef.h"
 #include <EEPROM.h>
 #include "Functions.h"
+#include "TemperatureTable.h"
 
 typedef union ul_convert {
   unsigned long value;
@@ -38,13 +41,21 @@ typedef union ul_convert {
 /*
  * Constructor
  */
-Thermostat::Thermostat(byte _pinThermistor, byte _pinEnable) {
+Thermostat::Thermostat(AnalogSampler * _sampler, Telemetry * _telemetry,
+                       byte _pinThermistor, byte _pinEnable)
+  : pid(&tuning), journal(EEPROM_JOURNAL_ADDR, EEPROM_JOURNAL_SIZE, sizeof(parameter_record_t), PARAMETER_VERSION) {
+  sampler = _sampler;
+  telemetry = _telemetry;
   pinThermistor = _pinThermistor;
+  channel = sampler->attach(pinThermistor);
   pinEnable = _pinEnable;
-  rawIndex = 0;
-  temperature = UNDEF;
+  average = 0;
+  temperature = Centidegrees::invalid();
 
-  loadParameters();
+  // The stored parameters are loaded by begin()
+  defaultParameters();
+  parametersDirty = false;
+  dirtySince = 0;
   strcpy(status, "initializing");
   
   heating = false;
@@ -53,10 +64,28 @@ Thermostat::Thermostat(byte _pinThermistor, byte _pinEnable) {
   lastHeatStart = 0;
   lastHeat = 0;
   lastStatusChange = 0;
-  lastSerialOutput = 0;
+  lastAnticipatorReport = 0;
   memset(status, '\0', 14);
-  statusid = 0;
+  statusid = STATUS_NONE;
   alarm = false;
+  alarmCause = ALARM_NONE;
+  temperatureGeneration = 0;
+  statusGeneration = 0;
+  parameterGeneration = 0;
+}
+
+/*
+ * Load the parameters and the calibration from EEPROM and start reporting
+ * on the serial port, if enabled (called from setup()). The constructor
+ * leaves the EEPROM alone, so a Thermostat can be declared before there's
+ * a board to read from (see host/sim).
+ */
+void Thermostat::begin() {
+  loadParameters();
+  calibration.load();
+  anticipator.begin();
+  ++parameterGeneration;
+  setSerialMode(serialMode);
 }
 
 /*
@@ -70,42 +99,64 @@ void Thermostat::sample() {
  * Sample temperature
  */
 void Thermostat::sample(unsigned long _millis) {
+  // Commit the parameters once the changes have settled
+  if(parametersDirty && diffUL(dirtySince, _millis) >= EEPROM_COMMIT_DELAY) {
+    flush();
+  }
+
   if(alarm) {
     return;
   }
   
-  // Pull value from our analog pin
-  raw[rawIndex++] = (long)analogRead(pinThermistor) * 100L;
-  delay(10);
-
-  // Round robin
-  if(rawIndex >= SAMPLE_SET_SIZE) {
-    rawIndex = 0;
-    if(temperature == UNDEF) {
-      temperature = 0;
+  // Pull the values collected since the last call through the filter, or
+  // take a single oversampled reading.
+  if(oversampling > 0) {
+    sampler->discard(channel);
+    average = filter.update(sampler->acquire(channel, oversampling));
+  } else {
+    uint16_t value;
+    while(sampler->read(channel, value)) {
+      average = filter.update(value);
     }
   }
 
-  if(temperature == UNDEF) {
+  if(!filter.ready()) {
     return;
   }
   
   // Determine the actual temperature
-  long average = calculateAverage();
-  interpolateTemperature(average); 
-  temperature += offsetTemperature;
+  Centidegrees previousTemperature = temperature;
+  temperature = convert(average) + offsetTemperature;
+  if(temperature != previousTemperature) {
+    ++temperatureGeneration;
+  }
 
   // Check if hot water is enabled by the heatlink (Nest).
   enabled = (digitalRead(ENABLE_PIN) == HIGH);
   inGracePeriod = diffUL(lastHeat, _millis) <= graceTime;
 
-  // Boiler heating
-  int halfRange = hysteresis / 2;
-  if(!heating && temperature < requestedTemperature - halfRange) {
+  // Boiler heating: the pulses of the PID or the hysteresis loop, where
+  // the relay opens early by the predicted rise
+  bool start;
+  bool stop;
+  if(controlMode == CONTROL_PID) {
+    bool on = pid.update(_millis, temperature, requestedTemperature, enabled);
+    start = on;
+    stop = !on;
+  } else {
+    Centidegrees halfRange = hysteresis / 2;
+    Centidegrees anticipation = anticipator.predict(_millis, temperature);
+    if(anticipation > halfRange) {
+      anticipation = halfRange;
+    }
+    start = temperature < requestedTemperature - halfRange;
+    stop = temperature > requestedTemperature + halfRange - anticipation;
+  }
+  if(!heating && start) {
     heating = true; 
     lastHeatStart = _millis;
   }
-  if(heating && temperature > requestedTemperature + halfRange) {
+  if(heating && stop) {
     heating = false;
     if(!inGracePeriod) {
       lastHeat = _millis;
@@ -121,27 +172,28 @@ void Thermostat::sample(unsigned long _millis) {
   // Alarms
   if(temperature < minimumTemperature) {
     alarm = true;
+    alarmCause = ALARM_MIN_TEMPERATURE;
     heating = false;
-    sprintf(status, "alarm (min %c)", (char)223);
+    strcpy(status, "alarm (min \337)");
   } else if(temperature > maximumTemperature) {
     alarm = true;
+    alarmCause = ALARM_MAX_TEMPERATURE;
     heating = false;
-    sprintf(status, "alarm (max %c)", (char)223);
+    strcpy(status, "alarm (max \337)");
   }
   if(heating && diffUL(lastHeatStart, _millis) > maximumHeatTime) {
     alarm = true;
+    alarmCause = ALARM_MAX_HEAT_TIME;
     heating = false;
-    sprintf(status, "alarm (max t)");
+    strcpy(status, "alarm (max t)");
   }
 
-  // Reporting on serial console
-  if(serialEnabled && diffUL(lastSerialOutput, _millis) >= SERIAL_FREQUENCY) {
-    updateSerial(_millis);
-    lastSerialOutput = _millis;
-  }
+  // The pulses of the PID would teach the anticipator the wrong rise
+  anticipator.update(_millis, temperature, controlMode == CONTROL_HYSTERESIS && shouldHeat());
 
   // Prevent any further status changes if an alarm was set
   if(alarm) {
+    ++statusGeneration;
     return;
   }
 
@@ -161,16 +213,57 @@ void Thermostat::sample(unsigned long _millis) {
   strcpy(status, statusPrompts[statusid]);
   if(previousStatusid != statusid) {
     lastStatusChange = _millis;
+    ++statusGeneration;
   }
 }
 
 /*
  * Retrieve temperature
  */
-int Thermostat::getTemperature() {
+Centidegrees Thermostat::getTemperature() {
   return temperature;
 }
 
+/*
+ * Retrieve the filtered raw value (left aligned, before conversion)
+ */
+uint16_t Thermostat::getRawAverage() {
+  return average;
+}
+
+/*
+ * Temperature of a filtered (left aligned) value of a thermistor: from
+ * the calibration set if one was captured, from the table otherwise. The
+ * offset isn't applied.
+ */
+Centidegrees Thermostat::convert(uint16_t _raw) {
+  if(calibration.isActive()) {
+    return calibration.convert(_raw);
+  }
+  return lookupTemperature(_raw);
+}
+
+/*
+ * Access the calibration set (required for Interface).
+ */
+Calibration * Thermostat::getCalibration() {
+  return &calibration;
+}
+
+/*
+ * Access the anticipator (required for Commands).
+ */
+Anticipator * Thermostat::getAnticipator() {
+  return &anticipator;
+}
+
+/*
+ * Access the PID controller (required for Commands).
+ */
+Pid * Thermostat::getPid() {
+  return &pid;
+}
+
 /*
  * Check the heat condition
  */
@@ -178,6 +271,20 @@ bool Thermostat::shouldHeat() {
   return heating && enabled && !inGracePeriod && !alarm;
 }
 
+/*
+ * Check if heat is held back by the grace period
+ */
+bool Thermostat::isWaitingForGrace() {
+  return heating && enabled && inGracePeriod && !alarm;
+}
+
+/*
+ * Cause of the alarm (ALARM_*)
+ */
+byte Thermostat::getAlarmCause() {
+  return alarmCause;
+}
+
 /*
  * Check if the system has generated an alarm
  */
@@ -188,14 +295,14 @@ bool Thermostat::inAlarm() {
 /*
  * Retrieve requested temperature
  */
-int Thermostat::getRequestedTemperature() {
+Centidegrees Thermostat::getRequestedTemperature() {
   return requestedTemperature;
 }
 
 /*
  * Retrieve hysteresis value
  */
-int Thermostat::getHysteresis() {
+Centidegrees Thermostat::getHysteresis() {
   return hysteresis;
 }
 
@@ -209,14 +316,14 @@ unsigned long Thermostat::getMaxHeatTime() {
 /*
  * Retrieve maximum temperature, until going in alarm.
  */
-int Thermostat::getMaxTemperature() {
+Centidegrees Thermostat::getMaxTemperature() {
   return maximumTemperature;
 }
 
 /*
  * Retrieve minimum temperature, until going in alarm.
  */
-int Thermostat::getMinTemperature() {
+Centidegrees Thermostat::getMinTemperature() {
   return minimumTemperature;
 }
 
@@ -230,10 +337,59 @@ unsigned long Thermostat::getGraceTime() {
 /*
  * Retrieve the temperature offset
  */
-int Thermostat::getOffsetTemperature() {
+Centidegrees Thermostat::getOffsetTemperature() {
   return offsetTemperature;
 }
 
+/*
+ * Retrieve the oversampling factor (4^n conversions per reading)
+ */
+byte Thermostat::getOversampling() {
+  return oversampling;
+}
+
+/*
+ * Retrieve the control mode (CONTROL_HYSTERESIS or CONTROL_PID)
+ */
+byte Thermostat::getControlMode() {
+  return controlMode;
+}
+
+/*
+ * Retrieve the gain of the PID (permille per degree)
+ */
+int Thermostat::getPidGain() {
+  return tuning.gain;
+}
+
+/*
+ * Retrieve the integral time of the PID (s.)
+ */
+unsigned int Thermostat::getPidIntegralTime() {
+  return tuning.integralTime;
+}
+
+/*
+ * Retrieve the derivative time of the PID (s.)
+ */
+unsigned int Thermostat::getPidDerivativeTime() {
+  return tuning.derivativeTime;
+}
+
+/*
+ * Retrieve the period of the relay window (s.)
+ */
+unsigned int Thermostat::getPidWindow() {
+  return tuning.windowPeriod;
+}
+
+/*
+ * Retrieve the shortest pulse of the relay (s.)
+ */
+unsigned int Thermostat::getPidMinimumPulse() {
+  return tuning.minimumPulse;
+}
+
 /*
  * Retrieve the thermostat's status
  */
@@ -241,6 +397,23 @@ char * Thermostat::getStatus() {
   return status;
 }
 
+/*
+ * Generation counters: change whenever the temperature or the status
+ * change, so the interface can skip recomposing what didn't change, or
+ * when the parameters were saved (possibly from the command channel).
+ */
+byte Thermostat::getTemperatureGeneration() {
+  return temperatureGeneration;
+}
+
+byte Thermostat::getStatusGeneration() {
+  return statusGeneration;
+}
+
+byte Thermostat::getParameterGeneration() {
+  return parameterGeneration;
+}
+
 /*
  * Return the time since the last status change
  */
@@ -251,14 +424,14 @@ unsigned long Thermostat::getTimeSinceStatusChange() {
 /*
  * Change the requested temperature
  */
-void Thermostat::setRequestedTemperature(int _value) {
+void Thermostat::setRequestedTemperature(Centidegrees _value) {
   requestedTemperature = _value;
 }
 
 /*
  * Change hysteresis value
  */
-void Thermostat::setHysteresis(int _value) {
+void Thermostat::setHysteresis(Centidegrees _value) {
   hysteresis = _value;
 }
 
@@ -272,14 +445,14 @@ void Thermostat::setMaxHeatTime(unsigned long _value) {
 /*
  * Change maximum temperature
  */
-void Thermostat::setMaxTemperature(int _value) {
+void Thermostat::setMaxTemperature(Centidegrees _value) {
   maximumTemperature = _value;
 }
 
 /*
  * Change minimum temperature
  */
-void Thermostat::setMinTemperature(int _value) {
+void Thermostat::setMinTemperature(Centidegrees _value) {
   minimumTemperature = _value;
 }
 
@@ -293,78 +466,148 @@ void Thermostat::setGraceTime(unsigned long _value) {
 /*
  * Set the offset temperature
  */
-void Thermostat::setOffsetTemperature(int _value) {
+void Thermostat::setOffsetTemperature(Centidegrees _value) {
   offsetTemperature = _value;
 }
 
 /*
- * Enabled/Disable the serial console
+ * Set the oversampling factor (4^n conversions per reading)
  */
-void Thermostat::setSerialEnabled(bool _value) {
-  serialEnabled = _value;
-  if(serialEnabled) {
-    Serial.begin(9600);
-  } else {
-    Serial.end();
-  }
+void Thermostat::setOversampling(byte _value) {
+  oversampling = _value > MAX_OVERSAMPLING ? MAX_OVERSAMPLING : _value;
 }
 
 /*
- * Retrieve the status of the serial console.
+ * Select the output on the serial console (TELEMETRY_OFF, TELEMETRY_CSV
+ * or TELEMETRY_BINARY)
  */
-bool Thermostat::getSerialEnabled() {
-  return serialEnabled;
+void Thermostat::setSerialMode(byte _value) {
+  serialMode = _value < TELEMETRY_MODES ? _value : TELEMETRY_OFF;
+
+  // Only open or close the port when needed
+  bool active = serialMode != TELEMETRY_OFF;
+  if(active && !telemetry->isActive()) {
+    telemetry->begin(TELEMETRY_BAUD);
+  } else if(!active && telemetry->isActive()) {
+    telemetry->end();
+  }
 }
 
 /*
- * Determine average of the sample set
+ * Select the control mode (CONTROL_HYSTERESIS or CONTROL_PID), the PID
+ * starts over when it's selected.
  */
-long Thermostat::calculateAverage() {
-  long average = 0;
-  for(byte i=0; i<SAMPLE_SET_SIZE; ++i) {
-    average += raw[i];
+void Thermostat::setControlMode(byte _value) {
+  byte mode = _value < CONTROL_MODES ? _value : CONTROL_HYSTERESIS;
+  if(mode != controlMode) {
+    pid.reset();
   }
-  
-  return average / SAMPLE_SET_SIZE;
+  controlMode = mode;
 }
 
 /*
- * Interpolate the actual temperature
+ * Change the gain of the PID (permille per degree)
  */
-void Thermostat::interpolateTemperature(long _value) {
-  // Determine reference frame (when going out of bounds, take the closest)
-  byte i0 = 0;
-  if(_value < calX[0]) {
-    i0 = 0;
-  } else {
-    for(byte i=CALIBRATION_SET_SIZE - 2; i>=0; --i) {
-      if(_value >= calX[i]) {
-        i0 = i;
-        break;
-      }
+void Thermostat::setPidGain(int _value) {
+  tuning.gain = _value;
+}
+
+/*
+ * Change the integral time of the PID (s., 0 turns it off)
+ */
+void Thermostat::setPidIntegralTime(unsigned int _value) {
+  tuning.integralTime = _value;
+}
+
+/*
+ * Change the derivative time of the PID (s., 0 turns it off)
+ */
+void Thermostat::setPidDerivativeTime(unsigned int _value) {
+  tuning.derivativeTime = _value;
+}
+
+/*
+ * Change the period of the relay window (s.), from the next window on
+ */
+void Thermostat::setPidWindow(unsigned int _value) {
+  tuning.windowPeriod = _value < MIN_PID_WINDOW ? MIN_PID_WINDOW : _value;
+}
+
+/*
+ * Change the shortest pulse of the relay (s.)
+ */
+void Thermostat::setPidMinimumPulse(unsigned int _value) {
+  tuning.minimumPulse = _value;
+}
+
+/*
+ * Retrieve the output on the serial console.
+ */
+byte Thermostat::getSerialMode() {
+  return serialMode;
+}
+
+/*
+ * Report on the serial console, if enabled (called every
+ * SERIAL_FREQUENCY ms. by the scheduler). The duty cycle of the MCU (in
+ * permille) is added to the report.
+ */
+void Thermostat::report(unsigned long _millis, unsigned int _dutyCycle) {
+  if(serialMode == TELEMETRY_CSV) {
+    reportCsv(_millis, _dutyCycle);
+  } else if(serialMode == TELEMETRY_BINARY) {
+    reportBinary(_millis, _dutyCycle);
+    if(lastAnticipatorReport == 0 || diffUL(lastAnticipatorReport, _millis) >= ANTICIPATOR_REPORT_PERIOD) {
+      lastAnticipatorReport = _millis;
+      reportAnticipator(_millis);
     }
   }
-
-  // Interpolate.
-  byte i1 = i0 + 1;
-  long xPart = (_value - calX[i0]) * FIXEDPOINT_MLT1 / (calX[i1] - calX[i0]);
-  long tmp = calY[i0] * (FIXEDPOINT_MLT1 - xPart) + calY[i1] * xPart;
-  temperature = tmp / FIXEDPOINT_MLT1;
 }
 
 /*
- * Expose the save functionality (required for Interface).
+ * Expose the save functionality (required for Interface and Commands).
+ * The parameters are committed later, see sample().
  */
 void Thermostat::save() {
-  saveParameters();
+  parametersDirty = true;
+  dirtySince = millis();
+  ++parameterGeneration;
+}
+
+/*
+ * Commit changed parameters (and what the anticipator learned) right away
+ * (e.g. before a reset).
+ */
+void Thermostat::flush() {
+  if(parametersDirty) {
+    saveParameters();
+    parametersDirty = false;
+  }
+  anticipator.flush();
 }
 
 /*
- * Clear out the EEPROM
+ * Number of parameter commits over the lifetime of the EEPROM.
+ */
+unsigned long Thermostat::getParameterCommits() {
+  return journal.getCommits();
+}
+
+/*
+ * Number of EEPROM bytes written for the parameters since the start.
+ */
+unsigned long Thermostat::getEepromBytesWritten() {
+  return journal.getBytesWritten();
+}
+
+/*
+ * Clear out the EEPROM, except for the accounting counters
  */
 void Thermostat::factoryReset() {
   for (int i=0; i<EEPROM.length(); ++i) {
-    EEPROM.update(i, 0);
+    if(i < EEPROM_ACCOUNTING_ADDR || i >= EEPROM_ACCOUNTING_ADDR + EEPROM_ACCOUNTING_SIZE) {
+      EEPROM.update(i, 0);
+    }
   }
 }
 
@@ -372,25 +615,78 @@ void Thermostat::factoryReset() {
  * Save all parameters
  */
 void Thermostat::saveParameters() {
-  byte tag[2] = EEPROM_TAG;
-  byte version = EEPROM_VERSION;
-  
-  EEPROM.put(0, tag);
-  EEPROM.put(2, version);
-  EEPROM.put(3, requestedTemperature);
-  EEPROM.put(5, offsetTemperature);
-  EEPROM.put(7, hysteresis);
-  EEPROM.put(9, maximumHeatTime);
-  EEPROM.put(13, maximumTemperature);
-  EEPROM.put(15, minimumTemperature);
-  EEPROM.put(17, graceTime);
-  EEPROM.put(21, serialEnabled);
+  parameter_record_t record;
+  record.maximumHeatTime = maximumHeatTime;
+  record.graceTime = graceTime;
+  record.requestedTemperature = requestedTemperature.raw();
+  record.offsetTemperature = offsetTemperature.raw();
+  record.hysteresis = hysteresis.raw();
+  record.maximumTemperature = maximumTemperature.raw();
+  record.minimumTemperature = minimumTemperature.raw();
+  record.serialMode = serialMode;
+  record.oversampling = oversampling;
+  record.tuning = tuning;
+  record.controlMode = controlMode;
+  journal.commit(&record);
 }
 
 /*
- * Load all parameters
+ * Load all parameters: the newest record of the journal, the fixed layout
+ * of older versions or the defaults.
  */
 void Thermostat::loadParameters() {
+  parameter_record_t record;
+  if(journal.load(&record)) {
+    maximumHeatTime = record.maximumHeatTime;
+    graceTime = record.graceTime;
+    requestedTemperature = Centidegrees::fromRaw(record.requestedTemperature);
+    offsetTemperature = Centidegrees::fromRaw(record.offsetTemperature);
+    hysteresis = Centidegrees::fromRaw(record.hysteresis);
+    maximumTemperature = Centidegrees::fromRaw(record.maximumTemperature);
+    minimumTemperature = Centidegrees::fromRaw(record.minimumTemperature);
+    serialMode = record.serialMode;
+    oversampling = record.oversampling;
+    tuning = record.tuning;
+    controlMode = record.controlMode;
+    return;
+  }
+
+  if(!loadPreviousParameters() && !loadLegacyParameters()) {
+    defaultParameters();
+  }
+  saveParameters();
+}
+
+/*
+ * Load the parameters from a record of the previous version, the start
+ * of the current one. The control mode and the tuning keep their
+ * defaults. Returns false if there's none.
+ */
+bool Thermostat::loadPreviousParameters() {
+  parameter_record_t record;
+  Journal previous(EEPROM_JOURNAL_ADDR, EEPROM_JOURNAL_SIZE, offsetof(parameter_record_t, tuning),
+                   PREVIOUS_PARAMETER_VERSION);
+  if(!previous.load(&record)) {
+    return false;
+  }
+  maximumHeatTime = record.maximumHeatTime;
+  graceTime = record.graceTime;
+  requestedTemperature = Centidegrees::fromRaw(record.requestedTemperature);
+  offsetTemperature = Centidegrees::fromRaw(record.offsetTemperature);
+  hysteresis = Centidegrees::fromRaw(record.hysteresis);
+  maximumTemperature = Centidegrees::fromRaw(record.maximumTemperature);
+  minimumTemperature = Centidegrees::fromRaw(record.minimumTemperature);
+  serialMode = record.serialMode;
+  oversampling = record.oversampling;
+  return true;
+}
+
+/*
+ * Load the parameters from the fixed layout used before the journal, in
+ * either version (the first one keeps the default oversampling). Returns
+ * false if it isn't there.
+ */
+bool Thermostat::loadLegacyParameters() {
   byte tag[2];
   byte expectedTag[2] = EEPROM_TAG;
   byte version;
@@ -398,61 +694,135 @@ void Thermostat::loadParameters() {
   // Verify tag
   EEPROM.get(0, tag);
   EEPROM.get(2, version);
-  
-  if(memcmp(tag, expectedTag, 2) != 0 || version != EEPROM_VERSION) {
-    requestedTemperature = DEFAULT_REQUESTED_TEMPERATURE;
-    hysteresis = DEFAULT_HYSTERESIS;
-    minimumTemperature = DEFAULT_MIN_TEMPERATURE;
-    maximumTemperature = DEFAULT_MAX_TEMPERATURE;
-    maximumHeatTime = DEFAULT_MAX_HEAT_TIME;
-    offsetTemperature = DEFAULT_OFFSET_TEMPERATURE;
-    graceTime = DEFAULT_GRACE_TIME;
-    serialEnabled = false;
-    
-    saveParameters();
+  if(memcmp(tag, expectedTag, 2) != 0 || (version != EEPROM_VERSION && version != EEPROM_FIRST_VERSION)) {
+    return false;
+  }
+
+  // The layout is that of the AVR (16 bit int, 32 bit long) everywhere
+  int16_t word;
+  uint32_t dword;
+  requestedTemperature = Centidegrees::fromRaw(EEPROM.get(3, word));
+  offsetTemperature = Centidegrees::fromRaw(EEPROM.get(5, word));
+  hysteresis = Centidegrees::fromRaw(EEPROM.get(7, word));
+  maximumHeatTime = EEPROM.get(9, dword);
+  maximumTemperature = Centidegrees::fromRaw(EEPROM.get(13, word));
+  minimumTemperature = Centidegrees::fromRaw(EEPROM.get(15, word));
+  graceTime = EEPROM.get(17, dword);
+  EEPROM.get(21, serialMode);
+  if(version == EEPROM_VERSION) {
+    EEPROM.get(22, oversampling);
+  }
+  return true;
+}
+
+/*
+ * Reset all parameters to their defaults
+ */
+void Thermostat::defaultParameters() {
+  requestedTemperature = Centidegrees::fromRaw(DEFAULT_REQUESTED_TEMPERATURE);
+  hysteresis = Centidegrees::fromRaw(DEFAULT_HYSTERESIS);
+  minimumTemperature = Centidegrees::fromRaw(DEFAULT_MIN_TEMPERATURE);
+  maximumTemperature = Centidegrees::fromRaw(DEFAULT_MAX_TEMPERATURE);
+  maximumHeatTime = DEFAULT_MAX_HEAT_TIME;
+  offsetTemperature = Centidegrees::fromRaw(DEFAULT_OFFSET_TEMPERATURE);
+  graceTime = DEFAULT_GRACE_TIME;
+  oversampling = DEFAULT_OVERSAMPLING;
+  serialMode = TELEMETRY_OFF;
+  controlMode = DEFAULT_CONTROL_MODE;
+  tuning.gain = DEFAULT_PID_GAIN;
+  tuning.integralTime = DEFAULT_PID_INTEGRAL_TIME;
+  tuning.derivativeTime = DEFAULT_PID_DERIVATIVE_TIME;
+  tuning.windowPeriod = DEFAULT_PID_WINDOW;
+  tuning.minimumPulse = DEFAULT_PID_MINIMUM_PULSE;
+}
+
+/*
+ * Print a value in centi-degrees with two decimals
+ */
+void printCentis(Print * _out, int _value) {
+  char field[8];
+  FieldWriter<sizeof(field) - 1> writer(field);
+  writer.fixed<2, 1>(_value);
+  field[writer.getLength()] = '\0';
+  _out->print(field);
+}
+
+/*
+ * Report the state as a CSV line
+ */
+void Thermostat::reportCsv(unsigned long _millis, unsigned int _dutyCycle) {
+  if(!telemetry->reserve(TELEMETRY_CSV_LENGTH)) {
     return;
   }
+  telemetry->print(_millis / 1000);
+  telemetry->print(";");
+  printCentis(telemetry, temperature.raw());
+  telemetry->print(";");
+  printCentis(telemetry, requestedTemperature.raw());
+  telemetry->print(";");
+  printCentis(telemetry, hysteresis.raw());
+  telemetry->print(";");
+  telemetry->print(heating);
+  telemetry->print(";");
+  telemetry->print(enabled);
+  telemetry->print(";");
+  telemetry->print(inGracePeriod);
+  telemetry->print(";");
+  telemetry->print(lastHeatStart / 1000);
+  telemetry->print(";");
+  telemetry->print(lastHeat / 1000);
+  telemetry->print(";");
+  telemetry->print(lastStatusChange / 1000);
+  telemetry->print(";");
+  telemetry->print(alarm);
+  telemetry->print(";");
+  telemetry->println(_dutyCycle);
+}
 
-  EEPROM.get(3, requestedTemperature);
-  EEPROM.get(5, offsetTemperature);
-  EEPROM.get(7, hysteresis);
-  EEPROM.get(9, maximumHeatTime);
-  EEPROM.get(13, maximumTemperature);
-  EEPROM.get(15, minimumTemperature);
-  EEPROM.get(17, graceTime);
-  EEPROM.get(21, serialEnabled);
-}
-
-/*
- * Print status to the serial console
- */
-void Thermostat::updateSerial(unsigned long _millis) {
-  Serial.print(_millis / 1000);
-  Serial.print(";");
-  Serial.print(temperature / 100); 
-  Serial.print("."); 
-  Serial.print(temperature % 100);
-  Serial.print(";");
-  Serial.print(requestedTemperature / 100); 
-  Serial.print("."); 
-  Serial.print(requestedTemperature % 100);
-  Serial.print(";");
-  Serial.print(hysteresis / 100);
-  Serial.print("."); 
-  Serial.print(hysteresis % 100);
-  Serial.print(";");
-  Serial.print(heating);
-  Serial.print(";");
-  Serial.print(enabled);
-  Serial.print(";");
-  Serial.print(inGracePeriod);
-  Serial.print(";");
-  Serial.print(lastHeatStart / 1000);
-  Serial.print(";");
-  Serial.print(lastHeat / 1000);
-  Serial.print(";");
-  Serial.print(lastStatusChange / 1000);
-  Serial.print(";");
-  Serial.println(alarm);  
+/*
+ * Report the state as a binary status frame (see Thermostat.h)
+ */
+void Thermostat::reportBinary(unsigned long _millis, unsigned int _dutyCycle) {
+  byte flags = 0;
+  if(heating) {
+    flags |= TELEMETRY_FLAG_HEATING;
+  }
+  if(enabled) {
+    flags |= TELEMETRY_FLAG_ENABLED;
+  }
+  if(inGracePeriod) {
+    flags |= TELEMETRY_FLAG_GRACE;
+  }
+  if(alarm) {
+    flags |= TELEMETRY_FLAG_ALARM;
+  }
+
+  telemetry->beginFrame(TELEMETRY_FRAME_STATUS);
+  telemetry->put32(_millis);
+  telemetry->put16(temperature.raw());
+  telemetry->put16(requestedTemperature.raw());
+  telemetry->put16(hysteresis.raw());
+  telemetry->put8(flags);
+  telemetry->put32(lastHeatStart);
+  telemetry->put32(lastHeat);
+  telemetry->put32(lastStatusChange);
+  telemetry->put8(alarmCause);
+  telemetry->put16(_dutyCycle);
+  telemetry->put16(telemetry->getDrops());
+  telemetry->endFrame();
 }
 
+/*
+ * Report the estimates of the anticipator as a binary frame (see
+ * Thermostat.h)
+ */
+void Thermostat::reportAnticipator(unsigned long _millis) {
+  telemetry->beginFrame(TELEMETRY_FRAME_ANTICIPATOR);
+  telemetry->put32(_millis);
+  telemetry->put16(anticipator.getSlope());
+  telemetry->put16(anticipator.getRise());
+  telemetry->put16(anticipator.getCycles());
+  telemetry->put16(anticipator.getLastRise());
+  telemetry->put16(anticipator.getAnticipation());
+  telemetry->endFrame();
+}
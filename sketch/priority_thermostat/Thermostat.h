@@ -30,73 +30,176 @@
 
 #include <Arduino.h>
 #include "MagicNumbers.h"
+#include "AnalogSampler.h"
+#include "Filters.h"
+#include "Calibration.h"
+#include "Telemetry.h"
+#include "Journal.h"
+#include "Anticipator.h"
+#include "Pid.h"
+#include "Fixed.h"
 
 /*
- * Implements an on/off thermostat that uses a hystersis loop and 
- * linear interpollation on a calibration set to determine
- * the temperature. We get away with linear interpollation since 
+ * Implements an on/off thermostat that uses a hystersis loop (or a PID
+ * controller, see below) and linear interpollation on a calibration set
+ * to determine the temperature. We get away with linear interpollation since 
  * our temperature curve is quite straight and I can live with a one
- * or two degree miss on my boiler temperature.
+ * or two degree miss on my boiler temperature. The interpolation is done
+ * at compile time, see TemperatureTable.h, unless a calibration set was
+ * captured on the device (see Calibration.h).
  * 
- * Raw number are multiplied by a factor 100 to prevent floating point
- * arithmetic.
+ * Raw numbers are left aligned to 16 bits to prevent floating point
+ * arithmetic. The samples are smoothed by the filter chain selected with
+ * THERMOSTAT_FILTER.
+ *
+ * The relay is opened early by the rise the Anticipator predicts after
+ * the cutoff, at most down to the requested temperature.
+ *
+ * In CONTROL_PID mode the hysteresis loop (and the anticipation) is
+ * replaced by a PID controller that switches the relay in time
+ * proportioned windows (see Pid.h), for loads that respond too slowly
+ * to be held in the hysteresis band. The grace period, the maximum heat
+ * time and the temperature alarms apply to its pulses as they do to the
+ * heat cycles of the loop: a pulse within the grace time of the last one
+ * waits, so the minimum pulse should be at least the grace time.
+ *
+ * The parameters are stored in a wear levelled journal (see Journal.h).
+ * save() only marks them as changed, they're committed once they were
+ * left alone for EEPROM_COMMIT_DELAY ms., so a few quick edits cost a
+ * single commit. flush() commits right away.
+ *
+ * The state is reported on the serial port (see Telemetry.h), either as a
+ * CSV line or as a binary status frame (TELEMETRY_FRAME_STATUS) with the
+ * fields, little endian:
+ *   uint32 time (ms.), int16 temperature (-32768 until the first reading),
+ *   int16 requested temperature,
+ *   int16 hysteresis (centi-degrees), uint8 flags (TELEMETRY_FLAG_*),
+ *   uint32 last heat start, uint32 last heat, uint32 last status change
+ *   (ms.), uint8 alarm cause (ALARM_*), uint16 duty cycle (permille),
+ *   uint16 dropped reports
+ * In binary mode the estimates of the Anticipator follow every
+ * ANTICIPATOR_REPORT_PERIOD ms. as a TELEMETRY_FRAME_ANTICIPATOR frame:
+ *   uint32 time (ms.), int16 slope (centi-degrees per minute),
+ *   int16 rise (centi-degrees), both with ANTICIPATOR_FRACTION_BITS
+ *   fractional bits, uint16 cycles learned, int16 last rise, int16
+ *   anticipation (centi-degrees)
  */
+typedef THERMOSTAT_FILTER ThermostatFilter;
+
+/*
+ * The parameters as stored in the journal (fixed widths, no padding).
+ */
+typedef struct parameter_record {
+  uint32_t maximumHeatTime;
+  uint32_t graceTime;
+  int16_t requestedTemperature;
+  int16_t offsetTemperature;
+  int16_t hysteresis;
+  int16_t maximumTemperature;
+  int16_t minimumTemperature;
+  uint8_t serialMode;
+  uint8_t oversampling;
+  pid_tuning_t tuning;
+  uint8_t controlMode;
+} parameter_record_t;
+
 class Thermostat {
   public:
-    Thermostat(byte _pinThermistor, byte _pinEnables);
+    Thermostat(AnalogSampler *, Telemetry *, byte _pinThermistor, byte _pinEnables);
+    void begin();
     void sample();
     void sample(unsigned long _millis);
+    Centidegrees convert(uint16_t _raw);
 
     // Retrieve values
-    int getRequestedTemperature();
-    int getHysteresis();
+    Centidegrees getRequestedTemperature();
+    Centidegrees getHysteresis();
     unsigned long getMaxHeatTime();
-    int getMaxTemperature();
-    int getMinTemperature();
+    Centidegrees getMaxTemperature();
+    Centidegrees getMinTemperature();
     unsigned long getGraceTime();
-    int getOffsetTemperature();
-    bool getSerialEnabled();
+    Centidegrees getOffsetTemperature();
+    byte getOversampling();
+    byte getSerialMode();
+    byte getControlMode();
+    int getPidGain();
+    unsigned int getPidIntegralTime();
+    unsigned int getPidDerivativeTime();
+    unsigned int getPidWindow();
+    unsigned int getPidMinimumPulse();
     
-    int getTemperature();
+    Centidegrees getTemperature();
+    uint16_t getRawAverage();
+    Calibration * getCalibration();
+    Anticipator * getAnticipator();
+    Pid * getPid();
     bool shouldHeat();
+    bool isWaitingForGrace();
     char * getStatus();
     unsigned long getTimeSinceStatusChange();
     bool inAlarm();
-    bool serialEnabled;
+    byte getAlarmCause();
+
+    // Generation counters, incremented when the value changes
+    byte getTemperatureGeneration();
+    byte getStatusGeneration();
+    byte getParameterGeneration();
 
     // Change values (based on some constants set in the main sketch 
-    void setRequestedTemperature(int);
-    void setHysteresis(int);
+    void setRequestedTemperature(Centidegrees);
+    void setHysteresis(Centidegrees);
     void setMaxHeatTime(unsigned long);
-    void setMaxTemperature(int);
-    void setMinTemperature(int);
+    void setMaxTemperature(Centidegrees);
+    void setMinTemperature(Centidegrees);
     void setGraceTime(unsigned long);
-    void setOffsetTemperature(int);
-    void setSerialEnabled(bool);
+    void setOffsetTemperature(Centidegrees);
+    void setOversampling(byte);
+    void setSerialMode(byte);
+    void setControlMode(byte);
+    void setPidGain(int);
+    void setPidIntegralTime(unsigned int);
+    void setPidDerivativeTime(unsigned int);
+    void setPidWindow(unsigned int);
+    void setPidMinimumPulse(unsigned int);
 
+    void report(unsigned long _millis, unsigned int _dutyCycle);
     void save();
+    void flush();
     void factoryReset();
+    unsigned long getParameterCommits();
+    unsigned long getEepromBytesWritten();
 
   private:
-    const long calX[CALIBRATION_SET_SIZE] = {43500L, 47600L, 51500L, 55300L, 58700L};
-    const long calY[CALIBRATION_SET_SIZE] = {1000L, 3000L, 5000L, 7000L, 9000L};
     const char statusPrompts[4][14] = STATUS_STR;
 
     // the mojo
+    AnalogSampler * sampler;
+    Telemetry * telemetry;
     byte pinThermistor;
+    byte channel;
     byte pinEnable;
-    long raw[SAMPLE_SET_SIZE];
-    byte rawIndex;
+    ThermostatFilter filter;
+    long average;
+    Calibration calibration;
+    Anticipator anticipator;
+    pid_tuning_t tuning;
+    Pid pid;
+    Journal journal;
+    bool parametersDirty;
+    unsigned long dirtySince;
 
     // the values
-    int temperature;          // An integer is just about enough for my setup.
-    int requestedTemperature;
-    int offsetTemperature;
-    int hysteresis;
+    Centidegrees temperature; // invalid until the filter has settled
+    Centidegrees requestedTemperature;
+    Centidegrees offsetTemperature;
+    Centidegrees hysteresis;
     unsigned long maximumHeatTime;
-    int maximumTemperature;
-    int minimumTemperature;
+    Centidegrees maximumTemperature;
+    Centidegrees minimumTemperature;
     unsigned long graceTime;
+    byte oversampling;
+    byte serialMode;
+    byte controlMode;
 
     // the state
     bool heating;
@@ -105,16 +208,23 @@ class Thermostat {
     unsigned long lastHeatStart;
     unsigned long lastHeat;
     unsigned long lastStatusChange;
-    unsigned long lastSerialOutput;
+    unsigned long lastAnticipatorReport;
     char status[14];
     byte statusid; // use this so we don't have to compare strings all the time.
     bool alarm;
+    byte alarmCause;
+    byte temperatureGeneration;
+    byte statusGeneration;
+    byte parameterGeneration;
     
-    long calculateAverage();
-    void interpolateTemperature(long _value);
     void saveParameters();
     void loadParameters();
-    void updateSerial(unsigned long);
+    void defaultParameters();
+    bool loadPreviousParameters();
+    bool loadLegacyParameters();
+    void reportCsv(unsigned long, unsigned int);
+    void reportBinary(unsigned long, unsigned int);
+    void reportAnticipator(unsigned long);
 };
 
 #endif
@@ -0,0 +1,386 @@
+/*
+ * This is free and unencumbered software released into the public domain.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any
+ * means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors
+ * of this software dedicate any and all copyright interest in the
+ * software to the public domain. We make this dedication for the benefit
+ * of the public at large and to the detriment of our heirs and
+ * successors. We intend this dedication to be an overt act of
+ * relinquishment in perpetuity of all present and future rights to this
+ * software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * For more information, please refer to <http://unlicense.org>
+ */
+
+#ifndef _ZONES_H_
+#define _ZONES_H_
+
+#include <Arduino.h>
+#include "MagicNumbers.h"
+#include "Functions.h"
+#include "Fixed.h"
+
+/*
+ * Priority arbitration between N zones that share a single boiler. Every
+ * zone has its own hysteresis loop (or an external demand, for a zone
+ * that's managed by a Thermostat), an enable input, an output (valve or
+ * pump) and alarm guards. The arbiter hands the boiler to the demanding
+ * zone with the highest priority:
+ *  - a zone with a higher priority preempts the owner, but only after the
+ *    owner ran for the minimum run time;
+ *  - once the boiler is released, no zone can take it during the lockout
+ *    time (the grace period, shared by all zones);
+ *  - a zone that runs longer than its maximum heat time, or leaves its
+ *    temperature limits, goes in alarm and is skipped from then on (until
+ *    a reset, like the alarms of the Thermostat). A zone with an external
+ *    demand is guarded by its own controller, the arbiter leaves it be.
+ *
+ * The state is kept as one array per field. Zones are mapped on bits in
+ * priority order (bit 0 is the highest priority), so arbitrate() works
+ * on a few bytes and costs the same for any number of zones. update()
+ * only touches a single zone.
+ */
+template<byte N>
+class Zones {
+  static_assert(N > 0 && N <= 8, "Zones supports 1 to 8 zones");
+
+  public:
+    Zones();
+    void configure(byte _zone, byte _priority, byte _pinEnable, byte _pinOutput);
+    void setRequestedTemperature(byte _zone, Centidegrees _value);
+    void setHysteresis(byte _zone, Centidegrees _value);
+    void setMinTemperature(byte _zone, Centidegrees _value);
+    void setMaxTemperature(byte _zone, Centidegrees _value);
+    void setMaxHeatTime(byte _zone, unsigned long _value);
+    void setMinRunTime(unsigned long _value);
+    void setLockoutTime(unsigned long _value);
+
+    void setDemand(byte _zone, bool _demand);
+    void update(byte _zone, Centidegrees _temperature);
+    void arbitrate(unsigned long _millis);
+
+    byte getOwner();
+    bool shouldHeat();
+    bool inLockout();
+    bool inAlarm(byte _zone);
+    bool isDemanding(byte _zone);
+
+  private:
+    // per zone settings
+    Centidegrees requestedTemperature[N];
+    Centidegrees hysteresis[N];
+    Centidegrees minimumTemperature[N];
+    Centidegrees maximumTemperature[N];
+    unsigned long maximumHeatTime[N];
+    byte priority[N];
+    byte pinEnable[N];
+    byte pinOutput[N];
+
+    // priority order: zone -> bit and bit -> zone
+    byte rank[N];
+    byte zoneAtRank[N];
+
+    // per zone state, one bit per zone (in priority order)
+    byte heating;
+    byte enabled;
+    byte alarms;
+    byte external;
+
+    // the boiler
+    byte owner;
+    bool lockout;
+    unsigned long minimumRunTime;
+    unsigned long lockoutTime;
+    unsigned long ownerSince;
+    unsigned long releasedAt;
+
+    void rankZones();
+    void setOutput(byte _zone, bool _on);
+    static byte lowestBit(byte _bits);
+};
+
+/*
+ * Constructor. All zones start with the same priority (in zone order),
+ * no pins and the default thermostat settings.
+ */
+template<byte N>
+Zones<N>::Zones() {
+  for(byte i=0; i<N; ++i) {
+    requestedTemperature[i] = Centidegrees::fromRaw(DEFAULT_REQUESTED_TEMPERATURE);
+    hysteresis[i] = Centidegrees::fromRaw(DEFAULT_HYSTERESIS);
+    minimumTemperature[i] = Centidegrees::fromRaw(DEFAULT_MIN_TEMPERATURE);
+    maximumTemperature[i] = Centidegrees::fromRaw(DEFAULT_MAX_TEMPERATURE);
+    maximumHeatTime[i] = DEFAULT_MAX_HEAT_TIME;
+    priority[i] = i;
+    pinEnable[i] = ZONE_NO_PIN;
+    pinOutput[i] = ZONE_NO_PIN;
+  }
+  heating = 0;
+  enabled = 0;
+  alarms = 0;
+  external = 0;
+  owner = ZONE_NONE;
+  lockout = false;
+  minimumRunTime = 0;
+  lockoutTime = 0;
+  ownerSince = 0;
+  releasedAt = 0;
+  rankZones();
+}
+
+/*
+ * Set up a zone: its priority (0 is the highest) and pins (ZONE_NO_PIN
+ * if not used). Call from setup(), pins are configured here.
+ */
+template<byte N>
+void Zones<N>::configure(byte _zone, byte _priority, byte _pinEnable, byte _pinOutput) {
+  priority[_zone] = _priority;
+  pinEnable[_zone] = _pinEnable;
+  pinOutput[_zone] = _pinOutput;
+
+  if(_pinEnable != ZONE_NO_PIN) {
+    pinMode(_pinEnable, INPUT);
+  }
+  if(_pinOutput != ZONE_NO_PIN) {
+    pinMode(_pinOutput, OUTPUT);
+    digitalWrite(_pinOutput, LOW);
+  }
+  rankZones();
+}
+
+/*
+ * Zone settings
+ */
+template<byte N>
+void Zones<N>::setRequestedTemperature(byte _zone, Centidegrees _value) {
+  requestedTemperature[_zone] = _value;
+}
+
+template<byte N>
+void Zones<N>::setHysteresis(byte _zone, Centidegrees _value) {
+  hysteresis[_zone] = _value;
+}
+
+template<byte N>
+void Zones<N>::setMinTemperature(byte _zone, Centidegrees _value) {
+  minimumTemperature[_zone] = _value;
+}
+
+template<byte N>
+void Zones<N>::setMaxTemperature(byte _zone, Centidegrees _value) {
+  maximumTemperature[_zone] = _value;
+}
+
+template<byte N>
+void Zones<N>::setMaxHeatTime(byte _zone, unsigned long _value) {
+  maximumHeatTime[_zone] = _value;
+}
+
+/*
+ * Minimum time a zone keeps the boiler before it can be preempted.
+ */
+template<byte N>
+void Zones<N>::setMinRunTime(unsigned long _value) {
+  minimumRunTime = _value;
+}
+
+/*
+ * Time the boiler stays off after being released.
+ */
+template<byte N>
+void Zones<N>::setLockoutTime(unsigned long _value) {
+  lockoutTime = _value;
+}
+
+/*
+ * Demand of a zone that runs its own control loop (e.g. the Thermostat).
+ * Such a zone is always considered enabled, its limits (maximum heat
+ * time, temperatures) are up to the loop.
+ */
+template<byte N>
+void Zones<N>::setDemand(byte _zone, bool _demand) {
+  byte bit = 1 << rank[_zone];
+  enabled |= bit;
+  external |= bit;
+  if(_demand) {
+    heating |= bit;
+  } else {
+    heating &= ~bit;
+  }
+}
+
+/*
+ * Run the hysteresis loop and the temperature guards of a single zone.
+ */
+template<byte N>
+void Zones<N>::update(byte _zone, Centidegrees _temperature) {
+  byte bit = 1 << rank[_zone];
+
+  if(pinEnable[_zone] == ZONE_NO_PIN || digitalRead(pinEnable[_zone]) == HIGH) {
+    enabled |= bit;
+  } else {
+    enabled &= ~bit;
+  }
+
+  if(!_temperature.isValid()) {
+    return;
+  }
+  if(_temperature < minimumTemperature[_zone] || _temperature > maximumTemperature[_zone]) {
+    alarms |= bit;
+  }
+
+  Centidegrees halfRange = hysteresis[_zone] / 2;
+  if(!(heating & bit) && _temperature < requestedTemperature[_zone] - halfRange) {
+    heating |= bit;
+  }
+  if((heating & bit) && _temperature > requestedTemperature[_zone] + halfRange) {
+    heating &= ~bit;
+  }
+}
+
+/*
+ * Decide which zone owns the boiler.
+ */
+template<byte N>
+void Zones<N>::arbitrate(unsigned long _millis) {
+  // Maximum heat time guard on the owner
+  if(owner != ZONE_NONE && !(external & (1 << rank[owner]))
+     && diffUL(ownerSince, _millis) > maximumHeatTime[owner]) {
+    alarms |= 1 << rank[owner];
+  }
+
+  byte demand = heating & enabled & ~alarms;
+  byte winner = lowestBit(demand);
+  winner = (winner == ZONE_NONE) ? ZONE_NONE : zoneAtRank[winner];
+
+  if(owner != ZONE_NONE && !(demand & (1 << rank[owner]))) {
+    // Owner is done (satisfied, disabled or in alarm)
+    setOutput(owner, false);
+    owner = ZONE_NONE;
+    releasedAt = _millis;
+    lockout = lockoutTime > 0;
+  }
+
+  if(lockout && diffUL(releasedAt, _millis) >= lockoutTime) {
+    lockout = false;
+  }
+
+  if(winner == ZONE_NONE || winner == owner || lockout) {
+    return;
+  }
+
+  if(owner == ZONE_NONE) {
+    owner = winner;
+    ownerSince = _millis;
+    setOutput(owner, true);
+  } else if(rank[winner] < rank[owner] && diffUL(ownerSince, _millis) >= minimumRunTime) {
+    // Preemption, the boiler stays on
+    setOutput(owner, false);
+    owner = winner;
+    ownerSince = _millis;
+    setOutput(owner, true);
+  }
+}
+
+/*
+ * The zone that owns the boiler (ZONE_NONE if the boiler is off).
+ */
+template<byte N>
+byte Zones<N>::getOwner() {
+  return owner;
+}
+
+/*
+ * Check if the boiler should be on.
+ */
+template<byte N>
+bool Zones<N>::shouldHeat() {
+  return owner != ZONE_NONE;
+}
+
+/*
+ * Check if the boiler was released recently.
+ */
+template<byte N>
+bool Zones<N>::inLockout() {
+  return lockout;
+}
+
+/*
+ * Check if a zone went in alarm.
+ */
+template<byte N>
+bool Zones<N>::inAlarm(byte _zone) {
+  return alarms & (1 << rank[_zone]);
+}
+
+/*
+ * Check if a zone asks for heat.
+ */
+template<byte N>
+bool Zones<N>::isDemanding(byte _zone) {
+  byte bit = 1 << rank[_zone];
+  return (heating & enabled & ~alarms & bit) != 0;
+}
+
+/*
+ * Map the zones on bits in priority order (ties in zone order). Only done
+ * while configuring, the state bits are cleared.
+ */
+template<byte N>
+void Zones<N>::rankZones() {
+  for(byte i=0; i<N; ++i) {
+    byte position = 0;
+    for(byte j=0; j<N; ++j) {
+      if(priority[j] < priority[i] || (priority[j] == priority[i] && j < i)) {
+        ++position;
+      }
+    }
+    rank[i] = position;
+    zoneAtRank[position] = i;
+  }
+  heating = 0;
+  enabled = 0;
+  alarms = 0;
+  external = 0;
+}
+
+/*
+ * Switch the output of a zone
+ */
+template<byte N>
+void Zones<N>::setOutput(byte _zone, bool _on) {
+  if(pinOutput[_zone] != ZONE_NO_PIN) {
+    digitalWrite(pinOutput[_zone], _on ? HIGH : LOW);
+  }
+}
+
+/*
+ * Index of the lowest set bit (ZONE_NONE if none), in constant time.
+ */
+template<byte N>
+byte Zones<N>::lowestBit(byte _bits) {
+  static const byte nibble[16] = {ZONE_NONE, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0};
+  if(_bits & 0x0F) {
+    return nibble[_bits & 0x0F];
+  }
+  if(_bits & 0xF0) {
+    return 4 + nibble[_bits >> 4];
+  }
+  return ZONE_NONE;
+}
+
+#endif
@@ -37,17 +37,61 @@
  */
 
 #include <LiquidCrystal.h>
+#include "AnalogSampler.h"
 #include "AnalogButtons.h"
 #include "Thermostat.h"
 #include "MagicNumbers.h"
 #include "Interface.h"
+#include "Zones.h"
+#include "TemperatureTable.h"
+#include "Scheduler.h"
+#include "Power.h"
+#include "Profiler.h"
+#include "Telemetry.h"
+#include "Commands.h"
+#include "Accounting.h"
+#include "History.h"
 
 // Objects required for our used features
 LiquidCrystal lcd(LCD_RS_PIN, LCD_ENABLE_PIN, 
                   LCD_D4_PIN, LCD_D5_PIN, LCD_D6_PIN, LCD_D7_PIN);
-AnalogButtons<NUMBER_OF_BUTTONS> buttons(BUTTONS_PIN, ANALOG_TOLERANCE);
-Thermostat thermostat(THERMISTOR_PIN, ENABLE_PIN);
-Interface interface(&lcd, &buttons, &thermostat);
+AnalogSampler sampler;
+Power power;
+Telemetry telemetry(&Serial);
+AnalogButtons<NUMBER_OF_BUTTONS> buttons(&sampler, BUTTONS_PIN, ANALOG_TOLERANCE);
+Thermostat thermostat(&sampler, &telemetry, THERMISTOR_PIN, ENABLE_PIN);
+Accounting accounting(&telemetry);
+History history;
+Interface interface(&lcd, &buttons, &thermostat, &power, &accounting, &history);
+Commands commands(&Serial, &thermostat, &telemetry);
+Zones<ZONE_COUNT> zones;
+
+#if ZONE_COUNT > 1
+// Extra zones
+const byte zoneThermistorPins[ZONE_COUNT - 1] = ZONE_THERMISTOR_PINS;
+const byte zoneEnablePins[ZONE_COUNT - 1] = ZONE_ENABLE_PINS;
+const byte zoneOutputPins[ZONE_COUNT - 1] = ZONE_OUTPUT_PINS;
+byte zoneSlots[ZONE_COUNT - 1];
+ThermostatFilter zoneFilters[ZONE_COUNT - 1];
+long zoneAverages[ZONE_COUNT - 1];
+#endif
+
+// Tasks, each one running at its own rate (order as in TASK_*)
+void runInput(unsigned long);
+void runControl(unsigned long);
+void runRender(unsigned long);
+void runTelemetry(unsigned long);
+void runLcdReset(unsigned long);
+
+task_t tasks[] = {
+  // function    period            deadline
+  {runInput,     INPUT_PERIOD,     INPUT_DEADLINE,     0, 0},
+  {runControl,   CONTROL_PERIOD,   CONTROL_DEADLINE,   0, 0},
+  {runRender,    RENDER_PERIOD,    RENDER_DEADLINE,    0, 0},
+  {runTelemetry, SERIAL_FREQUENCY, TELEMETRY_DEADLINE, 0, 0},
+  {runLcdReset,  LCD_RESET,        LCD_RESET_DEADLINE, 0, 0}
+};
+Scheduler scheduler(tasks, sizeof(tasks) / sizeof(task_t));
 
 void setup() {
   // Set up LCD
@@ -66,27 +110,121 @@ void setup() {
   pinMode(RELAY_PIN, OUTPUT);
   digitalWrite(RELAY_PIN, HIGH);
 
-  // Set up 3.3V reference
+  // Set up zones, the tank (zone 0) is driven by the thermostat
+  zones.configure(0, 0, ZONE_NO_PIN, ZONE_NO_PIN);
+  zones.setMinRunTime(ZONE_MIN_RUN_TIME);
+  zones.setLockoutTime(ZONE_LOCKOUT_TIME);
+#if ZONE_COUNT > 1
+  for(byte i=1; i<ZONE_COUNT; ++i) {
+    zones.configure(i, i, zoneEnablePins[i - 1], zoneOutputPins[i - 1]);
+    zoneSlots[i - 1] = sampler.attach(zoneThermistorPins[i - 1]);
+  }
+#endif
+
+  // Set up 3.3V reference and start sampling the analog pins
   analogReference(EXTERNAL);
+  sampler.begin(EXTERNAL);
 
   // Enable pin
   pinMode(ENABLE_PIN, INPUT);
 
+  // Sleep while idle, wake up right away on the enable pin (the buttons
+  // are decoded in the conversion interrupt, which wakes us up anyway)
+  power.begin();
+  power.watchPin(ENABLE_PIN);
+
   // Add buttons
   buttons.set(BUTTON_DECREASE, 1020);
   buttons.set(BUTTON_INCREASE, 926);
   buttons.set(BUTTON_SET, 690);
   buttons.set(BUTTON_MENU, 506);
+  buttons.setRepeat(BUTTON_INCREASE, true);
+  buttons.setRepeat(BUTTON_DECREASE, true);
+  buttons.begin();
+
+  // Start reporting on the serial console, if enabled
+  thermostat.begin();
+  accounting.begin();
+
+  commands.setDiagnostics(&scheduler, &sampler);
+  scheduler.begin(millis());
+}
+
+void loop() {
+  // React on external events right away
+  if(power.takePinChange()) {
+    scheduler.trigger(TASK_CONTROL);
+  }
+  if(buttons.pending()) {
+    scheduler.trigger(TASK_INPUT);
+  }
+
+  // Feed the UART without ever waiting for it, and handle commands
+  telemetry.drain();
+  commands.poll();
+
+  if(!scheduler.dispatch(millis())) {
+#ifdef __AVR__
+    power.sleep();
+#else
+    // Simulated board (host/sim): skip straight to the next task
+    power.sleep(scheduler.timeUntilNext(millis()));
+#endif
+  }
 }
 
-void loop() {  
-  buttons.sample();
-  thermostat.sample();
-  interface.interact();
-  interface.render();
+/*
+ * Handle the interaction, once for every queued button event.
+ */
+void runInput(unsigned long _millis) {
+  do {
+    PROFILE_START(PROFILE_BUTTONS);
+    buttons.sample(_millis);
+    PROFILE_STOP(PROFILE_BUTTONS);
+
+    PROFILE_START(PROFILE_INTERACT);
+    interface.interact(_millis);
+    PROFILE_STOP(PROFILE_INTERACT);
+  } while(buttons.pending());
+}
+
+/*
+ * Sample the temperature and drive the relay.
+ */
+void runControl(unsigned long _millis) {
+  PROFILE_START(PROFILE_THERMOSTAT);
+  thermostat.sample(_millis);
+  PROFILE_STOP(PROFILE_THERMOSTAT);
+
+  // Hand the boiler to the zone with the highest priority
+  zones.setDemand(0, thermostat.shouldHeat());
+#if ZONE_COUNT > 1
+  // The extra zones pull their samples through a filter chain of their
+  // own, like the thermostat (the samples per pass don't grow with the
+  // zones). There's no temperature until the chain is filled.
+  for(byte i=0; i<ZONE_COUNT - 1; ++i) {
+    uint16_t value;
+    while(sampler.read(zoneSlots[i], value)) {
+      zoneAverages[i] = zoneFilters[i].update(value);
+    }
+    zones.update(i + 1, zoneFilters[i].ready() ? thermostat.convert(zoneAverages[i])
+                                               : Centidegrees::invalid());
+  }
+#endif
+  zones.arbitrate(_millis);
+
+#if PROFILING
+  // Jitter of the relay decision: deviation from the control period
+  static unsigned long lastDecision = 0;
+  unsigned long decision = micros();
+  unsigned long interval = decision - lastDecision;
+  lastDecision = decision;
+  PROFILE_RECORD(PROFILE_JITTER, interval > CONTROL_PERIOD * 1000UL ?
+                 interval - CONTROL_PERIOD * 1000UL : CONTROL_PERIOD * 1000UL - interval);
+#endif
 
   // Activate/deactivate the heater
-  if(thermostat.shouldHeat()) {
+  if(zones.shouldHeat()) {
     digitalWrite(RELAY_PIN, LOW);
     digitalWrite(LED_BUILTIN, HIGH);
   } else {
@@ -94,8 +232,22 @@ void loop() {
     digitalWrite(LED_BUILTIN, LOW);
   }
 
+  // Burner hours, cycles and alarms
+  accounting.update(_millis, zones.shouldHeat(), thermostat.isWaitingForGrace(),
+                    thermostat.getAlarmCause());
+  history.update(_millis, thermostat.getTemperature(), zones.shouldHeat());
+
+  // Zones that went in alarm, shown like the alarms of the thermostat
+  byte zoneAlarms = 0;
+  for(byte i=1; i<ZONE_COUNT; ++i) {
+    if(zones.inAlarm(i)) {
+      zoneAlarms |= 1 << i;
+    }
+  }
+  interface.setZoneAlarms(zoneAlarms);
+
   // Activate/deactivate the LCD backlight
-  if(thermostat.inAlarm() || buttons.recentlyActive()) {
+  if(thermostat.inAlarm() || zoneAlarms != 0 || buttons.recentlyActive()) {
     digitalWrite(LCD_LED_PIN, HIGH);
   } else {
     digitalWrite(LCD_LED_PIN, LOW);
@@ -104,11 +256,43 @@ void loop() {
   // Check if we have to reset our board
   int resetMode = interface.getResetMode();
   if(resetMode != RESET_NO) {
+    accounting.flush();
     if(resetMode == RESET_FACTORY) {
       thermostat.factoryReset();
+    } else {
+      // Don't lose changes that weren't committed yet
+      thermostat.flush();
     }
+#ifdef __AVR__
     asm volatile ("jmp 0");
+#else
+    resetBoard();
+#endif
   }
-  
-  delay(80);
+}
+
+/*
+ * Refresh the LCD.
+ */
+void runRender(unsigned long _millis) {
+  PROFILE_START(PROFILE_RENDER);
+  interface.render(_millis);
+  PROFILE_STOP(PROFILE_RENDER);
+}
+
+/*
+ * Report on the serial console.
+ */
+void runTelemetry(unsigned long _millis) {
+  thermostat.report(_millis, power.getDutyCycle());
+  if(thermostat.getSerialMode() == TELEMETRY_BINARY) {
+    accounting.report(_millis);
+  }
+}
+
+/*
+ * Periodic LCD reset.
+ */
+void runLcdReset(unsigned long _millis) {
+  interface.resetLcd(_millis);
 }